@@ -0,0 +1,1582 @@
+/*******************************************************************************
+* File Name     : can_host_tools.c
+* Version       : 1.0
+* H/W Platform  : PC
+* Description   : PC side tools for the CAN demo node. Builds with any hosted
+*                 C++ compiler, e.g.
+*                     g++ -O2 -pthread -o can_host_tools "CAN Host Tools.cpp"
+*                 Commands:
+*                   accel-decode [id]   Decode the compressed accelerometer
+*                                       stream (can_accel_stream.c) from a
+*                                       frame log on stdin and print X,Y,Z.
+*                   fault-sim [opts]    Simulate the node's status traffic on a
+*                                       faulty bus and report goodput, error
+*                                       states and bus-off recovery time.
+*                   autobaud-sim [opts] Model of the node's bit rate 
+*                                       detection (can_autobaud.c) against
+*                                       simulated buses; detection time.
+*                   multinode [opts]    N instances of a model of the node's
+*                                       transmit traffic on one bus, bit by
+*                                       bit arbitration; per node latency 
+*                                       and bus load as N grows, one thread
+*                                       per N. The node code does not run.
+*                 Frame logs are one frame per line, hex: ID DLC D0 .. D7
+*                 Anything after the data bytes is ignored.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+/* Must match the node, see the top of CAN Project.cpp. */
+#define ACCEL_STREAM_ID         0x5C0
+
+/* Stream format, see can_accel_stream.c. */
+#define ACCEL_KEY_FLAG          0x80
+#define ACCEL_SEQ_MASK          0x7F
+#define ACCEL_MAX_COUNT         15
+
+/* Bus simulation, in bit times. */
+#define SIM_BITRATE             500000
+#define SIM_BITS_PER_MS         (SIM_BITRATE / 1000)
+#define SIM_ERROR_FRAME_BITS    20      /* Flag, superposition, delimiter, IFS. */
+#define SIM_SUSPEND_BITS        8       /* Error passive transmitter. */
+#define SIM_RECOVERY_SEQ        128     /* 11 recessive bits each, to leave bus-off. */
+#define SIM_ERROR_PASSIVE       128
+#define SIM_BUS_OFF             256
+
+/* Bit rate detection, must match can_autobaud.c. */
+#define AB_WINDOW_MS            200
+#define AB_MAX_MS               2000
+#define AB_MIN_FRAMES           2
+#define AB_SWITCH_US            50      /* Reset, halt, listen only, operate. */
+#define AB_IDLE_BITS            11      /* Bus integration before the first frame. */
+#define AB_ERR_BITS_MIN         6       /* Wrong rate: first stuff or form error. */
+#define AB_ERR_BITS_MAX         20
+
+/* Multi-node bus. */
+#define MN_MAX_NODES            128     /* IDs of the node traffic are 128 apart. */
+#define MN_CLOCK_PPM            100     /* Node clock error, up to. */
+#define MN_IFS_BITS             3
+#define MN_CRC15_POLY           0x4599
+
+/*******************************************************************************
+Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t    id;
+    uint8_t     dlc;
+    uint8_t     data[8];
+} can_frame_t;
+
+typedef struct
+{
+    int16_t     prev[3];
+    uint8_t     next_seq;
+    uint8_t     synced;
+    uint32_t    nr_frames;
+    uint32_t    nr_lost;                /* Frames missing by sequence. */
+    uint32_t    nr_samples;
+    uint32_t    nr_bytes;               /* Payload bytes received. */
+} accel_dec_t;
+
+/* Fault scenario. Rates are per frame or per second; 0 disables. */
+typedef struct
+{
+    const char *    name;
+    double          ber;                /* Bit error rate. */
+    double          no_ack;             /* Chance a frame gets no ACK. */
+    uint32_t        stuck_period_ms;    /* Stuck dominant, every period... */
+    uint32_t        stuck_bits;         /* ...for this many bit times. */
+    uint32_t        storm_rate;         /* Error frames/s from another node... */
+    uint32_t        storm_on_ms;        /* ...for this long... */
+    uint32_t        storm_period_ms;    /* ...every period. */
+} sim_fault_t;
+
+typedef struct
+{
+    uint32_t        seconds;
+    uint32_t        period_ms;          /* Node status frame period. */
+    uint8_t         dlc;
+    double          load;               /* Other nodes' share of the bus. */
+    uint32_t        status_delay_ms;    /* Main loop stall per bus state change. */
+    uint32_t        reinit_ms;          /* R_CAN_Create + init_can_app. */
+    uint32_t        seed;
+} sim_cfg_t;
+
+typedef struct
+{
+    uint32_t        nr_offered;
+    uint32_t        nr_delivered;
+    uint32_t        nr_replaced;        /* Overwritten while waiting, latest value. */
+    uint32_t        nr_stalled;         /* Not offered, main loop stalled. */
+    uint32_t        nr_tx_errors;
+    uint32_t        nr_bus_off;
+    uint64_t        passive_bits;
+    uint64_t        bus_off_bits;
+    uint64_t        recovery_bits_sum;  /* Bus-off to next frame delivered. */
+    uint64_t        recovery_bits_max;
+    uint32_t        nr_recovered;
+    uint16_t        tec;
+    uint16_t        rec;
+} sim_result_t;
+
+/* One periodic or random frame of the node application. */
+typedef struct
+{
+    const char *    name;
+    uint16_t        id;                 /* Node n sends id + n. */
+    uint32_t        period_ms;          /* 0: random, rate_s a second. */
+    double          rate_s;
+    uint8_t         dlc;
+    bool            latest;             /* Replaced while waiting, latest_tx_set. */
+    bool            master_only;        /* Node 0 only. */
+} mn_msg_t;
+
+#define MN_NR_MSGS              5
+
+/* State of one node instance. Nothing is shared between instances. */
+typedef struct
+{
+    uint32_t        rng;
+    double          clock;              /* Period scale from the clock error. */
+    double          due[MN_NR_MSGS];    /* Bit times. */
+    double          queued_at[MN_NR_MSGS];
+    bool            pending[MN_NR_MSGS];
+    uint8_t         data[MN_NR_MSGS][8];
+    uint32_t        nr_sent;
+    uint32_t        nr_replaced;
+    uint32_t        nr_overrun;         /* Due again while not sent, kept. */
+    uint32_t        nr_arb_lost;
+    uint32_t *      p_lat;              /* Queued to end of frame, bit times. */
+    uint32_t        nr_lat;
+    uint32_t        lat_size;
+} mn_node_t;
+
+typedef struct
+{
+    uint32_t        bitrate;
+    uint32_t        seconds;
+    uint32_t        seed;
+} mn_cfg_t;
+
+/* One bus with nr_nodes nodes, run on one thread. */
+typedef struct
+{
+    uint32_t        nr_nodes;
+    mn_node_t *     p_nodes;
+    uint64_t        busy_bits;
+    uint32_t        nr_frames;
+    double          run_ms;
+} mn_job_t;
+
+typedef struct
+{
+    uint32_t        runs;
+    uint32_t        window_ms;
+    uint32_t        max_ms;
+    double          ber;
+    uint32_t        seed;
+} ab_cfg_t;
+
+typedef struct
+{
+    uint32_t        nr_found;
+    double          ms_sum;             /* Found runs only. */
+    double          ms_max;
+    uint32_t        tried_sum;
+} ab_result_t;
+
+/*******************************************************************************
+* Local global variables
+*******************************************************************************/
+/* Traffic model of one node, periods and sizes from CAN Project.cpp. The 
+firmware needs the RX63N registers and the vendor driver, so it is not built
+here; each instance replays this table with its own state, clock and random
+payloads. Not modelled: the status multiplexor schedule, tx_limit throttling,
+the latest_tx deadline abort, the accel encoder's variable DLC, and any 
+received traffic. The node's IDs are moved to 128 apart in the same priority
+order, so that every instance has its own. */
+static const mn_msg_t mn_msgs[MN_NR_MSGS] =
+{
+    /* name     id      ms    per s  dlc latest master */
+    {"status",  0x080,  20,   0,     8,  true,  false},    /* DEMO_ID, tx limit 50/s. */
+    {"accel",   0x100,  8,    0,     7,  false, false},    /* ACCEL_STREAM_ID, packed samples. */
+    {"input",   0x180,  0,    5,     2,  false, false},    /* INPUT_EVENT_ID. */
+    {"uds",     0x200,  100,  0,     8,  false, false},    /* UDS_PERIODIC_ID, medium. */
+    {"tsync",   0x280,  1000, 0,     8,  false, true}      /* TSYNC_ID. */
+};
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static int  read_frame(FILE * p_file, can_frame_t * p_frame);
+static int  accel_codec_decode(accel_dec_t * p_dec, const can_frame_t * p_frame,
+                               int16_t (* p_xyz)[3]);
+static int  cmd_accel_decode(int argc, char * argv[]);
+static double   sim_rand(uint32_t * p_state);
+static uint64_t sim_exp_bits(uint32_t * p_state, double per_s);
+static uint32_t sim_frame_bits(uint8_t dlc);
+static void sim_run(const sim_cfg_t * p_cfg, const sim_fault_t * p_fault,
+                    sim_result_t * p_res);
+static int  cmd_fault_sim(int argc, char * argv[]);
+static void ab_run(const ab_cfg_t * p_cfg, uint32_t bus_kbps, double period_ms,
+                   ab_result_t * p_res);
+static int  cmd_autobaud_sim(int argc, char * argv[]);
+static uint32_t mn_frame_bits(uint16_t id, uint8_t dlc, const uint8_t * p_data);
+static void mn_release(const mn_cfg_t * p_cfg, mn_node_t * p_node, uint8_t m, double due);
+static void mn_run(const mn_cfg_t * p_cfg, mn_job_t * p_job);
+static uint32_t mn_percentile(const uint32_t * p_sorted, uint32_t n, uint32_t pct);
+static int  mn_cmp_u32(const void * p_a, const void * p_b);
+static int  cmd_multinode(int argc, char * argv[]);
+static void usage(void);
+
+
+/*******************************************************************************
+* Function name: read_frame
+* Description  : Read the next frame from a log. Skips lines that do not parse.
+* Arguments    : p_file -
+*                    Log.
+*                p_frame -
+*                    Gets the frame.
+* Return value : 1 frame read, 0 end of file.
+*******************************************************************************/
+static int read_frame(FILE * p_file, can_frame_t * p_frame)
+{
+    char            line[256];
+    char *          p;
+    char *          p_end;
+    unsigned long   value;
+    uint8_t         i;
+
+    while (fgets(line, sizeof(line), p_file) != NULL)
+    {
+        p = line;
+        p_frame->id = (uint32_t)strtoul(p, &p_end, 16);
+        if (p_end == p)
+        {
+            continue;
+        }
+        p = p_end;
+        value = strtoul(p, &p_end, 16);
+        if ((p_end == p) || (value > 8))
+        {
+            continue;
+        }
+        p_frame->dlc = (uint8_t)value;
+        p = p_end;
+
+        for (i = 0; i < p_frame->dlc; i++)
+        {
+            p_frame->data[i] = (uint8_t)strtoul(p, &p_end, 16);
+            if (p_end == p)
+            {
+                break;
+            }
+            p = p_end;
+        }
+        if (i == p_frame->dlc)
+        {
+            return 1;
+        }
+    }
+    return 0;
+} /* End of function read_frame(). */
+
+
+/*******************************************************************************
+* Function name: accel_codec_decode
+* Description  : Decode one frame of the accelerometer stream. After a
+*                sequence gap, delta frames are dropped until a keyframe.
+* Arguments    : p_dec -
+*                    Decoder state.
+*                p_frame -
+*                    Stream frame.
+*                p_xyz -
+*                    Gets up to ACCEL_MAX_COUNT samples.
+* Return value : Number of samples, 0 if the frame was dropped.
+*******************************************************************************/
+static int accel_codec_decode(accel_dec_t * p_dec, const can_frame_t * p_frame,
+                              int16_t (* p_xyz)[3])
+{
+    uint8_t     seq;
+    uint8_t     width;
+    uint8_t     count;
+    uint8_t     axis;
+    uint8_t     i;
+    uint32_t    acc = 0;
+    uint8_t     acc_bits = 0;
+    uint8_t     in = 2;
+    uint16_t    zz;
+
+    if (p_frame->dlc < 2)
+    {
+        return 0;
+    }
+
+    p_dec->nr_frames++;
+    p_dec->nr_bytes += p_frame->dlc;
+
+    seq = p_frame->data[0] & ACCEL_SEQ_MASK;
+    if (p_dec->synced && (seq != p_dec->next_seq))
+    {
+        p_dec->nr_lost += (seq - p_dec->next_seq) & ACCEL_SEQ_MASK;
+        p_dec->synced = 0;
+    }
+    p_dec->next_seq = (seq + 1) & ACCEL_SEQ_MASK;
+
+    if (p_frame->data[0] & ACCEL_KEY_FLAG)
+    {
+        if (p_frame->dlc < 7)
+        {
+            return 0;
+        }
+        for (axis = 0; axis < 3; axis++)
+        {
+            p_dec->prev[axis] = (int16_t)((p_frame->data[1 + 2 * axis] << 8) |
+                                          p_frame->data[2 + 2 * axis]);
+            p_xyz[0][axis] = p_dec->prev[axis];
+        }
+        p_dec->synced = 1;
+        p_dec->nr_samples++;
+        return 1;
+    }
+
+    if (!p_dec->synced)
+    {
+        return 0;
+    }
+
+    width = p_frame->data[1] >> 4;
+    count = p_frame->data[1] & 0x0F;
+    if (2 + (3 * width * count + 7) / 8 > p_frame->dlc)
+    {
+        /* Corrupt. Wait for the next keyframe. */
+        p_dec->synced = 0;
+        return 0;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        for (axis = 0; axis < 3; axis++)
+        {
+            while (acc_bits < width)
+            {
+                acc = (acc << 8) | p_frame->data[in++];
+                acc_bits += 8;
+            }
+            acc_bits -= width;
+            zz = (uint16_t)((acc >> acc_bits) & ((1UL << width) - 1));
+
+            /* Undo zigzag; the node's arithmetic wraps at 16 bits. */
+            p_dec->prev[axis] = (int16_t)(p_dec->prev[axis] +
+                                          (int16_t)((zz >> 1) ^ (uint16_t)-(int16_t)(zz & 1)));
+            p_xyz[i][axis] = p_dec->prev[axis];
+        }
+    }
+
+    p_dec->nr_samples += count;
+    return count;
+} /* End of function accel_codec_decode(). */
+
+
+/*******************************************************************************
+* Function name: cmd_accel_decode
+* Description  : accel-decode [id]. Samples go to stdout as CSV, statistics
+*                to stderr.
+* Return value : Exit code.
+*******************************************************************************/
+static int cmd_accel_decode(int argc, char * argv[])
+{
+    accel_dec_t     dec;
+    can_frame_t     frame;
+    int16_t         xyz[ACCEL_MAX_COUNT][3];
+    uint32_t        id = ACCEL_STREAM_ID;
+    int             n;
+    int             i;
+
+    if (argc > 0)
+    {
+        id = (uint32_t)strtoul(argv[0], NULL, 16);
+    }
+
+    memset(&dec, 0, sizeof(dec));
+    printf("x,y,z\n");
+
+    while (read_frame(stdin, &frame))
+    {
+        if (frame.id != id)
+        {
+            continue;
+        }
+        n = accel_codec_decode(&dec, &frame, xyz);
+        for (i = 0; i < n; i++)
+        {
+            printf("%d,%d,%d\n", xyz[i][0], xyz[i][1], xyz[i][2]);
+        }
+    }
+
+    fprintf(stderr, "%lu frames, %lu lost, %lu samples, %.2f samples/frame, "
+            "%.2f:1 against raw 6 bytes/sample\n",
+            (unsigned long)dec.nr_frames, (unsigned long)dec.nr_lost,
+            (unsigned long)dec.nr_samples,
+            dec.nr_frames ? (double)dec.nr_samples / dec.nr_frames : 0.0,
+            dec.nr_bytes ? 6.0 * dec.nr_samples / dec.nr_bytes : 0.0);
+    return 0;
+} /* End of function cmd_accel_decode(). */
+
+
+/* Uniform in [0, 1). xorshift32, so runs repeat for a given seed. */
+static double sim_rand(uint32_t * p_state)
+{
+    uint32_t    x = *p_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *p_state = x;
+    return (x >> 8) / 16777216.0;
+}
+
+
+/* Exponential gap for events at per_s a second, in bit times. */
+static uint64_t sim_exp_bits(uint32_t * p_state, double per_s)
+{
+    return (uint64_t)(-log(1.0 - sim_rand(p_state)) * SIM_BITRATE / per_s) + 1;
+}
+
+
+/* Standard ID data frame with typical stuffing and the interframe space. */
+static uint32_t sim_frame_bits(uint8_t dlc)
+{
+    return 47 + 8 * dlc + (34 + 8 * dlc) / 10 + 3;
+}
+
+
+/*******************************************************************************
+* Function name: sim_run
+* Description  : Run the node's status traffic through one fault scenario.
+*                Frame level: the bus carries either a node frame, a frame of
+*                another node or an error frame at a time. The error counters
+*                follow ISO 11898-1 fault confinement:
+*                  transmit error +8, success -1; receive error +1, success -1
+*                  8 more per 8 dominant bits after an error flag (stuck bus)
+*                  an error passive transmitter's ACK error does not count
+*                  error passive at 128, bus-off at 256, and 128 sequences of
+*                  11 recessive bits to recover.
+*                The application is modelled on handle_can_bus_state: each 
+*                state change stalls the main loop status_delay_ms, and the 
+*                return from bus-off adds reinit_ms. A status frame waiting in
+*                the mailbox is replaced by the next one (latest_tx_set).
+* Arguments    : p_cfg -
+*                    Node and bus.
+*                p_fault -
+*                    Scenario.
+*                p_res -
+*                    Gets the results.
+* Return value : none
+*******************************************************************************/
+static void sim_run(const sim_cfg_t * p_cfg, const sim_fault_t * p_fault,
+                    sim_result_t * p_res)
+{
+    const uint64_t  end = (uint64_t)p_cfg->seconds * SIM_BITRATE;
+    const uint64_t  period = (uint64_t)p_cfg->period_ms * SIM_BITS_PER_MS;
+    const uint32_t  bits = sim_frame_bits(p_cfg->dlc);
+    const uint32_t  other_bits = sim_frame_bits(8);
+    uint32_t        rnd = p_cfg->seed ? p_cfg->seed : 1;
+    uint64_t        t = 0;
+    uint64_t        next_offer = 0;
+    uint64_t        next_other = 0;
+    uint64_t        next_stuck = 0;
+    uint64_t        next_storm = 0;
+    uint64_t        stall_until = 0;
+    uint64_t        suspend_until = 0;
+    uint64_t        bus_off_at = 0;
+    uint64_t        last_t = 0;
+    uint64_t        step;
+    int32_t         tec = 0;
+    int32_t         rec = 0;
+    uint32_t        recovery = 0;
+    int             state = 0;          /* 0 active, 1 passive, 2 bus-off. */
+    int             seen_state = 0;     /* As the main loop last saw it. */
+    bool            pending = false;
+    bool            recovering = false;
+    bool            storm;
+    bool            other_first;
+    double          p_err;
+    double          other_per_s;
+
+    memset(p_res, 0, sizeof(*p_res));
+    other_per_s = p_cfg->load * SIM_BITRATE / other_bits;
+    if (other_per_s > 0)
+    {
+        next_other = sim_exp_bits(&rnd, other_per_s);
+    }
+    if (p_fault->stuck_period_ms)
+    {
+        next_stuck = (uint64_t)p_fault->stuck_period_ms * SIM_BITS_PER_MS;
+    }
+
+    while (t < end)
+    {
+        /* Time in the state held since the last event. */
+        if (1 == state)
+        {
+            p_res->passive_bits += t - last_t;
+        }
+        else if (2 == state)
+        {
+            p_res->bus_off_bits += t - last_t;
+        }
+        last_t = t;
+
+        /* The main loop: notice state changes, offer a frame each period. */
+        if (state != seen_state)
+        {
+            stall_until = t + (uint64_t)p_cfg->status_delay_ms * SIM_BITS_PER_MS;
+            if ((2 == seen_state) && (0 == state))
+            {
+                stall_until += (uint64_t)p_cfg->reinit_ms * SIM_BITS_PER_MS;
+            }
+            seen_state = state;
+        }
+        while (next_offer <= t)
+        {
+            p_res->nr_offered++;
+            if (t < stall_until)
+            {
+                p_res->nr_stalled++;
+            }
+            else if (2 == state)
+            {
+                /* Bus-off: TxSet fails. */
+                p_res->nr_stalled++;
+            }
+            else
+            {
+                if (pending)
+                {
+                    p_res->nr_replaced++;
+                }
+                pending = true;
+            }
+            next_offer += period;
+        }
+
+        /* Stuck dominant. Everyone on the bus sees errors, bus-off nodes 
+        only wait longer to recover. */
+        if (p_fault->stuck_period_ms && (next_stuck <= t))
+        {
+            uint32_t    extra = (p_fault->stuck_bits > 14) ? 8 * ((p_fault->stuck_bits - 14) / 8) : 0;
+
+            if (state != 2)
+            {
+                if (pending && (t >= suspend_until))
+                {
+                    tec += 8 + extra;
+                    p_res->nr_tx_errors++;
+                }
+                else
+                {
+                    rec += 1 + extra;
+                }
+            }
+            t += p_fault->stuck_bits;
+            next_stuck += (uint64_t)p_fault->stuck_period_ms * SIM_BITS_PER_MS;
+            goto update_state;
+        }
+
+        storm = false;
+        if (p_fault->storm_rate && p_fault->storm_period_ms)
+        {
+            storm = ((t / SIM_BITS_PER_MS) % p_fault->storm_period_ms) < p_fault->storm_on_ms;
+        }
+        if (storm && (next_storm <= t))
+        {
+            /* Another node's error frame. It destroys whatever was on the bus. */
+            if (2 == state)
+            {
+                /* No recessive sequence while the storm lasts. */
+            }
+            else if (pending && (t >= suspend_until) && (sim_rand(&rnd) < 0.5))
+            {
+                tec += 8;
+                p_res->nr_tx_errors++;
+            }
+            else
+            {
+                rec += 1;
+            }
+            t += SIM_ERROR_FRAME_BITS;
+            next_storm = t + sim_exp_bits(&rnd, p_fault->storm_rate);
+            goto update_state;
+        }
+
+        if (2 == state)
+        {
+            /* Each frame on the bus, or 11 idle bits, is one recovery 
+            sequence. */
+            if ((other_per_s > 0) && (next_other <= t))
+            {
+                t += other_bits;
+                next_other = t + sim_exp_bits(&rnd, other_per_s);
+            }
+            else
+            {
+                t += 11;
+            }
+            if (++recovery >= SIM_RECOVERY_SEQ)
+            {
+                tec = 0;
+                rec = 0;
+                recovery = 0;
+            }
+            goto update_state;
+        }
+
+        other_first = (other_per_s > 0) && (next_other <= t);
+        if (pending && (t >= suspend_until) && (t >= stall_until) &&
+            !(other_first && (sim_rand(&rnd) < 0.5)))
+        {
+            /* Node transmits. */
+            p_err = 1.0 - pow(1.0 - p_fault->ber, bits);
+            if (sim_rand(&rnd) < p_err)
+            {
+                tec += 8;
+                p_res->nr_tx_errors++;
+                t += bits / 2 + SIM_ERROR_FRAME_BITS;
+            }
+            else if (sim_rand(&rnd) < p_fault->no_ack)
+            {
+                if (state != 1)
+                {
+                    tec += 8;
+                }
+                p_res->nr_tx_errors++;
+                t += bits + SIM_ERROR_FRAME_BITS;
+            }
+            else
+            {
+                t += bits;
+                tec -= (tec > 0);
+                pending = false;
+                p_res->nr_delivered++;
+                if (recovering)
+                {
+                    step = t - bus_off_at;
+                    p_res->recovery_bits_sum += step;
+                    if (step > p_res->recovery_bits_max)
+                    {
+                        p_res->recovery_bits_max = step;
+                    }
+                    p_res->nr_recovered++;
+                    recovering = false;
+                }
+            }
+            if (1 == state)
+            {
+                suspend_until = t + SIM_SUSPEND_BITS;
+            }
+        }
+        else if (other_first)
+        {
+            /* Node receives. */
+            p_err = 1.0 - pow(1.0 - p_fault->ber, other_bits);
+            if (sim_rand(&rnd) < p_err)
+            {
+                rec += 1;
+                t += other_bits / 2 + SIM_ERROR_FRAME_BITS;
+            }
+            else
+            {
+                rec -= (rec > 0);
+                t += other_bits;
+            }
+            next_other = t + sim_exp_bits(&rnd, other_per_s);
+        }
+        else
+        {
+            /* Idle until the next event. */
+            step = next_offer;
+            if ((other_per_s > 0) && (next_other < step))
+            {
+                step = next_other;
+            }
+            if (p_fault->stuck_period_ms && (next_stuck < step))
+            {
+                step = next_stuck;
+            }
+            if (p_fault->storm_rate && p_fault->storm_period_ms)
+            {
+                /* The next error frame, or if it fell due while the storm 
+                was off, the start of the next storm. */
+                uint64_t    storm_at = next_storm;
+
+                if (storm_at <= t)
+                {
+                    storm_at = ((t / SIM_BITS_PER_MS) / p_fault->storm_period_ms + 1) *
+                               p_fault->storm_period_ms * SIM_BITS_PER_MS;
+                }
+                if (storm_at < step)
+                {
+                    step = storm_at;
+                }
+            }
+            if (pending && (suspend_until > t) && (suspend_until < step))
+            {
+                step = suspend_until;
+            }
+            if (pending && (stall_until > t) && (stall_until < step))
+            {
+                step = stall_until;
+            }
+            t = (step > t) ? step : t + 1;
+            continue;
+        }
+
+update_state:
+        if (rec > 255)
+        {
+            rec = 255;  /* REC stops counting; it cannot cause bus-off. */
+        }
+        if (2 == state)
+        {
+            if (0 == tec)
+            {
+                state = 0;
+            }
+        }
+        else if (tec >= SIM_BUS_OFF)
+        {
+            state = 2;
+            bus_off_at = t;
+            recovering = true;
+            pending = false;
+            p_res->nr_bus_off++;
+        }
+        else
+        {
+            state = ((tec >= SIM_ERROR_PASSIVE) || (rec >= SIM_ERROR_PASSIVE)) ? 1 : 0;
+        }
+    }
+
+    p_res->tec = (uint16_t)tec;
+    p_res->rec = (uint16_t)rec;
+} /* End of function sim_run(). */
+
+
+/*******************************************************************************
+* Function name: cmd_fault_sim
+* Description  : fault-sim [-t s] [-p ms] [-l load] [-d ms] [-r ms] [-s seed]
+*                          [-b ber] [-a no_ack] [-k period_ms,bits]
+*                          [-e rate,on_ms,period_ms]
+*                Without fault options the built-in scenarios run in turn; 
+*                with them, one custom scenario runs. One line per scenario.
+* Return value : Exit code.
+*******************************************************************************/
+static int cmd_fault_sim(int argc, char * argv[])
+{
+    static const sim_fault_t    scenarios[] =
+    {
+        /* name             ber     no_ack  stuck          storm */
+        {"clean",           0,      0,      0,    0,       0,    0,   0},
+        {"bit-errors",      1e-4,   0,      0,    0,       0,    0,   0},
+        {"bit-errors-high", 1e-3,   0,      0,    0,       0,    0,   0},
+        {"no-ack-30%",      0,      0.3,    0,    0,       0,    0,   0},
+        {"alone-no-ack",    0,      1.0,    0,    0,       0,    0,   0},
+        {"stuck-dominant",  0,      0,      500,  400,     0,    0,   0},
+        {"error-storm",     0,      0,      0,    0,       8000, 200, 1000}
+    };
+    sim_cfg_t       cfg = {10, 10, 8, 0.3, 175, 5, 1};
+    sim_fault_t     custom = {"custom", 0, 0, 0, 0, 0, 0, 0};
+    bool            use_custom = false;
+    sim_result_t    res;
+    const sim_fault_t * p_fault;
+    size_t          n;
+    size_t          i;
+    int             a;
+
+    for (a = 0; a + 1 < argc; a += 2)
+    {
+        if      (0 == strcmp(argv[a], "-t")) cfg.seconds = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-p")) cfg.period_ms = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-l")) cfg.load = atof(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-d")) cfg.status_delay_ms = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-r")) cfg.reinit_ms = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-s")) cfg.seed = (uint32_t)strtoul(argv[a + 1], NULL, 0);
+        else if (0 == strcmp(argv[a], "-b")) { custom.ber = atof(argv[a + 1]); use_custom = true; }
+        else if (0 == strcmp(argv[a], "-a")) { custom.no_ack = atof(argv[a + 1]); use_custom = true; }
+        else if (0 == strcmp(argv[a], "-k"))
+        {
+            sscanf(argv[a + 1], "%u,%u", &custom.stuck_period_ms, &custom.stuck_bits);
+            use_custom = true;
+        }
+        else if (0 == strcmp(argv[a], "-e"))
+        {
+            sscanf(argv[a + 1], "%u,%u,%u", &custom.storm_rate, &custom.storm_on_ms, 
+                   &custom.storm_period_ms);
+            use_custom = true;
+        }
+        else
+        {
+            fprintf(stderr, "fault-sim: unknown option %s\n", argv[a]);
+            return 2;
+        }
+    }
+    if ((0 == cfg.seconds) || (0 == cfg.period_ms) || (cfg.dlc > 8))
+    {
+        fprintf(stderr, "fault-sim: bad -t or -p\n");
+        return 2;
+    }
+    if (!((custom.ber >= 0) && (custom.ber < 1)))
+    {
+        fprintf(stderr, "fault-sim: -b must be in [0, 1)\n");
+        return 2;
+    }
+
+    p_fault = use_custom ? &custom : scenarios;
+    n = use_custom ? 1 : sizeof(scenarios) / sizeof(scenarios[0]);
+
+    printf("%u s, status every %u ms, other nodes %.0f%% load, %u ms stall per state change\n",
+           cfg.seconds, cfg.period_ms, cfg.load * 100, cfg.status_delay_ms);
+    printf("%-16s %8s %8s %7s %8s %8s %7s %7s %7s %10s %10s\n", "scenario", "offered", 
+           "sent", "goodput", "replaced", "tx_errs", "passive", "bus_off", "off_%", 
+           "recov_ms", "recov_max");
+
+    for (i = 0; i < n; i++)
+    {
+        sim_run(&cfg, &p_fault[i], &res);
+        printf("%-16s %8u %8u %6.1f%% %8u %8u %6.1f%% %7u %6.1f%% %10.1f %10.1f\n", p_fault[i].name,
+               res.nr_offered, res.nr_delivered, 
+               res.nr_offered ? 100.0 * res.nr_delivered / res.nr_offered : 0.0,
+               res.nr_replaced, res.nr_tx_errors,
+               100.0 * res.passive_bits / ((double)cfg.seconds * SIM_BITRATE),
+               res.nr_bus_off,
+               100.0 * res.bus_off_bits / ((double)cfg.seconds * SIM_BITRATE),
+               res.nr_recovered ? (double)res.recovery_bits_sum / res.nr_recovered / SIM_BITS_PER_MS : 0.0,
+               (double)res.recovery_bits_max / SIM_BITS_PER_MS);
+    }
+    return 0;
+} /* End of function cmd_fault_sim(). */
+
+
+/*******************************************************************************
+* Function name: ab_run
+* Description  : Model of autobaud_detect against one bus, p_cfg->runs 
+*                times. A copy of its loop and constants, not the firmware.
+*                Other nodes send 8 byte frames at bus_kbps, exponential 
+*                gaps with a mean of period_ms (0 = quiet bus). For each 
+*                candidate, as on the node:
+*                  the mode switch and bus integration take AB_SWITCH_US 
+*                  and AB_IDLE_BITS; frames already on the bus are missed
+*                  at the right rate, a frame gives AB_MIN_FRAMES frames
+*                  that end in the window; a bit error (ber) in one of 
+*                  them is an error frame and the candidate fails
+*                  at a wrong rate, the first frame gives an error after 
+*                  AB_ERR_BITS_MIN..MAX bits of the slower rate
+*                  no frame in the window: next candidate.
+* Arguments    : p_cfg -
+*                    Runs, window, bound, ber, seed.
+*                bus_kbps -
+*                    Rate of the simulated bus.
+*                period_ms -
+*                    Mean frame period of the other nodes.
+*                p_res -
+*                    Gets the results.
+* Return value : none
+*******************************************************************************/
+static void ab_run(const ab_cfg_t * p_cfg, uint32_t bus_kbps, double period_ms,
+                   ab_result_t * p_res)
+{
+    /* Must match autobaud_tbl. */
+    static const uint32_t   candidates[] = {500, 250, 125, 1000};
+    const size_t    nr_candidates = sizeof(candidates) / sizeof(candidates[0]);
+    const double    frame_us = sim_frame_bits(8) * 1000.0 / bus_kbps;
+    const double    p_corrupt = 1.0 - pow(1.0 - p_cfg->ber, sim_frame_bits(8));
+    uint32_t        rng = p_cfg->seed;
+    double          t_us;               /* Node time since start. */
+    double          frame_start_us;     /* Next frame of the other nodes. */
+    double          cand_us;
+    double          window_us;
+    double          slow_kbps;
+    uint32_t        nr_frames;
+    uint32_t        run;
+    size_t          idx;
+    bool            found;
+
+    memset(p_res, 0, sizeof(*p_res));
+
+    for (run = 0; run < p_cfg->runs; run++)
+    {
+        t_us = 0;
+        idx = 0;
+        found = false;
+        frame_start_us = (period_ms > 0) ? -log(1.0 - sim_rand(&rng)) * period_ms * 1000.0 : 1e30;
+
+        while (t_us < p_cfg->max_ms * 1000.0)
+        {
+            window_us = p_cfg->max_ms * 1000.0 - t_us;
+            if (window_us > p_cfg->window_ms * 1000.0)
+            {
+                window_us = p_cfg->window_ms * 1000.0;
+            }
+            p_res->tried_sum++;
+
+            cand_us = t_us;
+            t_us += AB_SWITCH_US + AB_IDLE_BITS * 1000.0 / candidates[idx];
+            nr_frames = 0;
+
+            for (;;)
+            {
+                /* Frames that began before the node listened are missed. */
+                while (frame_start_us < t_us)
+                {
+                    frame_start_us += frame_us - log(1.0 - sim_rand(&rng)) * period_ms * 1000.0;
+                }
+                if (frame_start_us + frame_us > cand_us + window_us)
+                {
+                    t_us = cand_us + window_us;
+                    break;
+                }
+
+                if (candidates[idx] != bus_kbps)
+                {
+                    slow_kbps = (candidates[idx] < bus_kbps) ? candidates[idx] : bus_kbps;
+                    t_us = frame_start_us + (AB_ERR_BITS_MIN + sim_rand(&rng) * 
+                           (AB_ERR_BITS_MAX - AB_ERR_BITS_MIN)) * 1000.0 / slow_kbps;
+                    break;
+                }
+                if (sim_rand(&rng) < p_corrupt)
+                {
+                    t_us = frame_start_us + sim_rand(&rng) * frame_us;
+                    break;
+                }
+
+                t_us = frame_start_us + frame_us;
+                if (++nr_frames >= AB_MIN_FRAMES)
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (found)
+            {
+                break;
+            }
+            idx = (idx + 1) % nr_candidates;
+        }
+
+        if (found)
+        {
+            p_res->nr_found++;
+            p_res->ms_sum += t_us / 1000.0;
+            if (t_us / 1000.0 > p_res->ms_max)
+            {
+                p_res->ms_max = t_us / 1000.0;
+            }
+        }
+    }
+} /* End of function ab_run(). */
+
+
+/*******************************************************************************
+* Function name: cmd_autobaud_sim
+* Description  : autobaud-sim [-n runs] [-k bus_kbps] [-p frame_period_ms]
+*                             [-w window_ms] [-m max_ms] [-b ber] [-s seed]
+*                Without -k and -p every candidate rate runs against 1, 10,
+*                100 ms and 1 s frame periods and a quiet bus. One line per
+*                bus.
+* Return value : Exit code.
+*******************************************************************************/
+static int cmd_autobaud_sim(int argc, char * argv[])
+{
+    static const uint32_t   rates[] = {125, 250, 500, 1000};
+    static const double     periods[] = {1, 10, 100, 1000, 0};
+    ab_cfg_t        cfg = {1000, AB_WINDOW_MS, AB_MAX_MS, 0, 1};
+    uint32_t        bus_kbps = 0;
+    double          period_ms = -1;
+    ab_result_t     res;
+    size_t          r;
+    size_t          p;
+    int             a;
+
+    for (a = 0; a + 1 < argc; a += 2)
+    {
+        if      (0 == strcmp(argv[a], "-n")) cfg.runs = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-k")) bus_kbps = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-p")) period_ms = atof(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-w")) cfg.window_ms = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-m")) cfg.max_ms = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-b")) cfg.ber = atof(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-s")) cfg.seed = (uint32_t)strtoul(argv[a + 1], NULL, 0);
+        else
+        {
+            fprintf(stderr, "autobaud-sim: unknown option %s\n", argv[a]);
+            return 2;
+        }
+    }
+    if ((0 == cfg.runs) || (0 == cfg.window_ms) || (0 == cfg.seed))
+    {
+        fprintf(stderr, "autobaud-sim: bad -n, -w or -s\n");
+        return 2;
+    }
+
+    printf("%u runs, window %u ms, bound %u ms, ber %g\n", cfg.runs, cfg.window_ms, 
+           cfg.max_ms, cfg.ber);
+    printf("%8s %10s %7s %9s %9s %7s\n", "kbps", "period_ms", "found", "mean_ms", 
+           "max_ms", "tried");
+
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        if (bus_kbps && (bus_kbps != rates[r]))
+        {
+            continue;
+        }
+        for (p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+        {
+            if ((period_ms >= 0) && (period_ms != periods[p]))
+            {
+                continue;
+            }
+            ab_run(&cfg, rates[r], periods[p], &res);
+            printf("%8u %10.0f %6.1f%% %9.1f %9.1f %7.1f\n", rates[r], periods[p],
+                   100.0 * res.nr_found / cfg.runs,
+                   res.nr_found ? res.ms_sum / res.nr_found : 0.0, res.ms_max,
+                   (double)res.tried_sum / cfg.runs);
+        }
+    }
+    return 0;
+} /* End of function cmd_autobaud_sim(). */
+
+
+/* Standard data frame on the wire: stuffed SOF to CRC, then CRC delimiter,
+ACK, ACK delimiter and EOF. */
+static uint32_t mn_frame_bits(uint16_t id, uint8_t dlc, const uint8_t * p_data)
+{
+    uint8_t     bits[19 + 64];
+    uint32_t    n = 0;
+    uint32_t    i;
+    uint32_t    stuffed;
+    uint16_t    crc = 0;
+    uint8_t     run = 0;
+    uint8_t     prev = 2;
+    uint8_t     b;
+
+    bits[n++] = 0;                                  /* SOF */
+    for (i = 0; i < 11; i++)
+    {
+        bits[n++] = (uint8_t)((id >> (10 - i)) & 1);
+    }
+    bits[n++] = 0;                                  /* RTR */
+    bits[n++] = 0;                                  /* IDE */
+    bits[n++] = 0;                                  /* r0 */
+    for (i = 0; i < 4; i++)
+    {
+        bits[n++] = (uint8_t)((dlc >> (3 - i)) & 1);
+    }
+    for (i = 0; i < 8U * dlc; i++)
+    {
+        bits[n++] = (uint8_t)((p_data[i / 8] >> (7 - i % 8)) & 1);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        b = (uint8_t)(bits[i] ^ ((crc >> 14) & 1));
+        crc = (uint16_t)((crc << 1) & 0x7FFF);
+        if (b)
+        {
+            crc ^= MN_CRC15_POLY;
+        }
+    }
+
+    /* A stuff bit after 5 equal bits; it starts the next run. */
+    stuffed = 0;
+    for (i = 0; i < n + 15; i++)
+    {
+        b = (i < n) ? bits[i] : (uint8_t)((crc >> (14 - (i - n))) & 1);
+        if (b == prev)
+        {
+            run++;
+        }
+        else
+        {
+            prev = b;
+            run = 1;
+        }
+        if (5 == run)
+        {
+            stuffed++;
+            prev = (uint8_t)!b;
+            run = 1;
+        }
+    }
+
+    return n + 15 + stuffed + 10;
+}
+
+
+/* Put a frame in its mailbox, as the node's transmit path does. */
+static void mn_release(const mn_cfg_t * p_cfg, mn_node_t * p_node, uint8_t m, double due)
+{
+    const mn_msg_t *    p_msg = &mn_msgs[m];
+    uint8_t             i;
+
+    if (p_node->pending[m] && !p_msg->latest)
+    {
+        p_node->nr_overrun++;
+    }
+    else
+    {
+        if (p_node->pending[m])
+        {
+            p_node->nr_replaced++;
+        }
+        p_node->pending[m] = true;
+        p_node->queued_at[m] = due;
+        for (i = 0; i < p_msg->dlc; i++)
+        {
+            p_node->data[m][i] = (uint8_t)(sim_rand(&p_node->rng) * 256);
+        }
+    }
+
+    if (p_msg->period_ms)
+    {
+        p_node->due[m] += p_msg->period_ms * (p_cfg->bitrate / 1000.0) * p_node->clock;
+    }
+    else
+    {
+        p_node->due[m] += -log(1.0 - sim_rand(&p_node->rng)) * p_cfg->bitrate / p_msg->rate_s;
+    }
+}
+
+
+/*******************************************************************************
+* Function name: mn_run
+* Description  : Run p_job->nr_nodes nodes on one bus for p_cfg->seconds.
+*                Event driven in bit times: when the bus is idle the next 
+*                frame due is the next event; otherwise every node with a 
+*                frame waiting offers its lowest ID, as the RX63N mailboxes
+*                do in ID priority mode, and arbitration runs bit by bit on
+*                the wired-AND bus. The winner holds the bus for its stuffed
+*                length plus the interframe space; frames due meanwhile wait
+*                for the next arbitration. Each node has its own clock error
+*                and phases. No bus errors, see fault-sim for those.
+* Arguments    : p_cfg -
+*                    Bit rate, length, seed.
+*                p_job -
+*                    Number of nodes; gets the nodes and bus totals.
+* Return value : none
+*******************************************************************************/
+static void mn_run(const mn_cfg_t * p_cfg, mn_job_t * p_job)
+{
+    const uint64_t  end = (uint64_t)p_cfg->seconds * p_cfg->bitrate;
+    const auto      t0 = std::chrono::steady_clock::now();
+    uint32_t        cont_node[MN_MAX_NODES];
+    uint8_t         cont_msg[MN_MAX_NODES];
+    uint32_t        nr_cont;
+    uint32_t        rng = p_cfg->seed + p_job->nr_nodes;
+    mn_node_t *     p_node;
+    uint64_t        t = 0;
+    double          next_due;
+    uint32_t        bits;
+    uint32_t        node_nr;
+    uint32_t        c;
+    uint32_t        keep;
+    uint16_t        id;
+    int             best;
+    int             bit;
+    uint8_t         m;
+    bool            dominant;
+
+    p_job->p_nodes = (mn_node_t *)calloc(p_job->nr_nodes, sizeof(mn_node_t));
+    p_job->busy_bits = 0;
+    p_job->nr_frames = 0;
+
+    for (node_nr = 0; node_nr < p_job->nr_nodes; node_nr++)
+    {
+        p_node = &p_job->p_nodes[node_nr];
+        p_node->rng = (rng * 2654435761U) ^ (node_nr * 40503U + 1U);
+        rng = p_node->rng;
+        p_node->clock = 1.0 + (2.0 * sim_rand(&p_node->rng) - 1.0) * MN_CLOCK_PPM * 1e-6;
+        for (m = 0; m < MN_NR_MSGS; m++)
+        {
+            p_node->due[m] = (mn_msgs[m].master_only && (node_nr > 0)) ? 1e300 :
+                             sim_rand(&p_node->rng) * (mn_msgs[m].period_ms ? 
+                                                       mn_msgs[m].period_ms : 1000) * 
+                                                      (p_cfg->bitrate / 1000.0);
+        }
+    }
+
+    while (t < end)
+    {
+        /* Release what is due, find the next event. */
+        next_due = 1e300;
+        nr_cont = 0;
+        for (node_nr = 0; node_nr < p_job->nr_nodes; node_nr++)
+        {
+            p_node = &p_job->p_nodes[node_nr];
+            best = -1;
+            for (m = 0; m < MN_NR_MSGS; m++)
+            {
+                while (p_node->due[m] <= (double)t)
+                {
+                    mn_release(p_cfg, p_node, m, p_node->due[m]);
+                }
+                if (p_node->due[m] < next_due)
+                {
+                    next_due = p_node->due[m];
+                }
+                if (p_node->pending[m] && ((best < 0) || (mn_msgs[m].id < mn_msgs[best].id)))
+                {
+                    best = m;
+                }
+            }
+            if (best >= 0)
+            {
+                cont_node[nr_cont] = node_nr;
+                cont_msg[nr_cont] = (uint8_t)best;
+                nr_cont++;
+            }
+        }
+
+        if (0 == nr_cont)
+        {
+            t = (uint64_t)ceil(next_due);
+            continue;
+        }
+
+        /* Arbitration: a node sending recessive over dominant drops out. */
+        for (bit = 10; (bit >= 0) && (nr_cont > 1); bit--)
+        {
+            dominant = false;
+            for (c = 0; c < nr_cont; c++)
+            {
+                id = (uint16_t)(mn_msgs[cont_msg[c]].id + cont_node[c]);
+                dominant |= (0 == ((id >> bit) & 1));
+            }
+            if (!dominant)
+            {
+                continue;
+            }
+            for (c = 0, keep = 0; c < nr_cont; c++)
+            {
+                id = (uint16_t)(mn_msgs[cont_msg[c]].id + cont_node[c]);
+                if ((id >> bit) & 1)
+                {
+                    p_job->p_nodes[cont_node[c]].nr_arb_lost++;
+                }
+                else
+                {
+                    cont_node[keep] = cont_node[c];
+                    cont_msg[keep] = cont_msg[c];
+                    keep++;
+                }
+            }
+            nr_cont = keep;
+        }
+
+        p_node = &p_job->p_nodes[cont_node[0]];
+        m = cont_msg[0];
+        bits = mn_frame_bits((uint16_t)(mn_msgs[m].id + cont_node[0]), mn_msgs[m].dlc, 
+                             p_node->data[m]);
+
+        if (p_node->nr_lat == p_node->lat_size)
+        {
+            p_node->lat_size = p_node->lat_size ? 2 * p_node->lat_size : 1024;
+            p_node->p_lat = (uint32_t *)realloc(p_node->p_lat, p_node->lat_size * sizeof(uint32_t));
+        }
+        p_node->p_lat[p_node->nr_lat++] = (uint32_t)((double)(t + bits) - p_node->queued_at[m]);
+        p_node->pending[m] = false;
+        p_node->nr_sent++;
+
+        p_job->nr_frames++;
+        p_job->busy_bits += bits + MN_IFS_BITS;
+        t += bits + MN_IFS_BITS;
+    }
+
+    if (t > end)
+    {
+        p_job->busy_bits -= t - end;
+    }
+    for (node_nr = 0; node_nr < p_job->nr_nodes; node_nr++)
+    {
+        p_node = &p_job->p_nodes[node_nr];
+        if (p_node->nr_lat > 1)
+        {
+            qsort(p_node->p_lat, p_node->nr_lat, sizeof(uint32_t), mn_cmp_u32);
+        }
+    }
+    p_job->run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+} /* End of function mn_run(). */
+
+
+static uint32_t mn_percentile(const uint32_t * p_sorted, uint32_t n, uint32_t pct)
+{
+    return n ? p_sorted[(uint64_t)(n - 1) * pct / 100] : 0;
+}
+
+
+static int mn_cmp_u32(const void * p_a, const void * p_b)
+{
+    const uint32_t  a = *(const uint32_t *)p_a;
+    const uint32_t  b = *(const uint32_t *)p_b;
+
+    return (a > b) - (a < b);
+}
+
+
+/*******************************************************************************
+* Function name: cmd_multinode
+* Description  : multinode [-n N,N,..] [-t s] [-r bitrate] [-j threads] 
+*                          [-s seed] [-v N]
+*                One bus per N, run on a pool of threads, as the buses are
+*                independent; a single bus is serial by nature. One line per
+*                N: bus load, latency over all nodes and of the worst node,
+*                frames lost to overrun. -v prints each node of one N.
+* Return value : Exit code.
+*******************************************************************************/
+static int cmd_multinode(int argc, char * argv[])
+{
+    mn_cfg_t                cfg = {500000, 10, 1};
+    uint32_t                counts[32] = {1, 2, 4, 8, 16, 24, 32, 48, 64};
+    uint32_t                nr_jobs = 9;
+    uint32_t                nr_threads = std::thread::hardware_concurrency();
+    uint32_t                verbose_n = 0;
+    std::vector<mn_job_t>   jobs;
+    std::vector<std::thread> pool;
+    std::atomic<uint32_t>   next_job(0);
+    std::vector<uint32_t>   all;
+    std::vector<uint32_t>   order;
+    double                  wall_ms;
+    double                  cpu_ms = 0;
+    double                  us_per_bit;
+    const mn_job_t *        p_job;
+    const mn_node_t *       p_node;
+    uint32_t                worst;
+    uint32_t                nr_overrun;
+    uint32_t                nr_replaced;
+    uint32_t                j;
+    uint32_t                n;
+    char *                  p;
+    int                     a;
+
+    for (a = 0; a + 1 < argc; a += 2)
+    {
+        if (0 == strcmp(argv[a], "-n"))
+        {
+            for (nr_jobs = 0, p = argv[a + 1]; *p && (nr_jobs < 32); nr_jobs++)
+            {
+                counts[nr_jobs] = (uint32_t)strtoul(p, &p, 0);
+                if (',' == *p)
+                {
+                    p++;
+                }
+            }
+        }
+        else if (0 == strcmp(argv[a], "-t")) cfg.seconds = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-r")) cfg.bitrate = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-j")) nr_threads = (uint32_t)atoi(argv[a + 1]);
+        else if (0 == strcmp(argv[a], "-s")) cfg.seed = (uint32_t)strtoul(argv[a + 1], NULL, 0);
+        else if (0 == strcmp(argv[a], "-v")) verbose_n = (uint32_t)atoi(argv[a + 1]);
+        else
+        {
+            fprintf(stderr, "multinode: unknown option %s\n", argv[a]);
+            return 2;
+        }
+    }
+    for (j = 0; j < nr_jobs; j++)
+    {
+        if ((0 == counts[j]) || (counts[j] > MN_MAX_NODES))
+        {
+            fprintf(stderr, "multinode: N must be 1..%u\n", MN_MAX_NODES);
+            return 2;
+        }
+    }
+    if ((0 == cfg.seconds) || (0 == cfg.bitrate) || (0 == cfg.seed))
+    {
+        fprintf(stderr, "multinode: bad -t, -r or -s\n");
+        return 2;
+    }
+    if (0 == nr_threads)
+    {
+        nr_threads = 1;
+    }
+    if (nr_threads > nr_jobs)
+    {
+        nr_threads = nr_jobs;
+    }
+
+    /* Largest bus first, whatever the order of -n, so the pool finishes 
+    together. Results are printed in the order given. */
+    jobs.resize(nr_jobs);
+    order.resize(nr_jobs);
+    for (j = 0; j < nr_jobs; j++)
+    {
+        jobs[j].nr_nodes = counts[j];
+        order[j] = j;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a_job, uint32_t b_job)
+    {
+        return jobs[a_job].nr_nodes > jobs[b_job].nr_nodes;
+    });
+    const auto t0 = std::chrono::steady_clock::now();
+    for (j = 0; j < nr_threads; j++)
+    {
+        pool.emplace_back([&]()
+        {
+            uint32_t    k;
+
+            while ((k = next_job++) < jobs.size())
+            {
+                mn_run(&cfg, &jobs[order[k]]);
+            }
+        });
+    }
+    for (j = 0; j < nr_threads; j++)
+    {
+        pool[j].join();
+    }
+    wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    us_per_bit = 1e6 / cfg.bitrate;
+    printf("%u s at %u bps, node clocks +-%u ppm\n", cfg.seconds, cfg.bitrate, MN_CLOCK_PPM);
+    printf("%5s %8s %6s %9s %9s %9s %11s %9s %9s %7s\n", "nodes", "frames/s", "load", "p50_us", 
+           "p99_us", "max_us", "worst_node", "p99_us", "replaced", "overrun");
+
+    for (j = 0; j < nr_jobs; j++)
+    {
+        p_job = &jobs[j];
+        all.clear();
+        worst = 0;
+        nr_overrun = 0;
+        nr_replaced = 0;
+        for (n = 0; n < p_job->nr_nodes; n++)
+        {
+            p_node = &p_job->p_nodes[n];
+            all.insert(all.end(), p_node->p_lat, p_node->p_lat + p_node->nr_lat);
+            if (mn_percentile(p_node->p_lat, p_node->nr_lat, 99) > 
+                mn_percentile(p_job->p_nodes[worst].p_lat, p_job->p_nodes[worst].nr_lat, 99))
+            {
+                worst = n;
+            }
+            nr_overrun += p_node->nr_overrun;
+            nr_replaced += p_node->nr_replaced;
+        }
+        qsort(all.data(), all.size(), sizeof(uint32_t), mn_cmp_u32);
+        p_node = &p_job->p_nodes[worst];
+
+        printf("%5u %8.0f %5.1f%% %9.0f %9.0f %9.0f %11u %9.0f %9u %7u\n", p_job->nr_nodes,
+               (double)p_job->nr_frames / cfg.seconds,
+               100.0 * p_job->busy_bits / ((double)cfg.seconds * cfg.bitrate),
+               mn_percentile(all.data(), (uint32_t)all.size(), 50) * us_per_bit,
+               mn_percentile(all.data(), (uint32_t)all.size(), 99) * us_per_bit,
+               (all.empty() ? 0 : all.back()) * us_per_bit, worst,
+               mn_percentile(p_node->p_lat, p_node->nr_lat, 99) * us_per_bit,
+               nr_replaced, nr_overrun);
+        cpu_ms += p_job->run_ms;
+    }
+
+    for (j = 0; j < nr_jobs; j++)
+    {
+        p_job = &jobs[j];
+        if (p_job->nr_nodes != verbose_n)
+        {
+            continue;
+        }
+        printf("\n%u nodes\n%5s %7s %9s %9s %9s %9s %8s %8s %7s\n", verbose_n, "node", "sent", 
+               "p50_us", "p90_us", "p99_us", "max_us", "arb_lost", "replaced", "overrun");
+        for (n = 0; n < p_job->nr_nodes; n++)
+        {
+            p_node = &p_job->p_nodes[n];
+            printf("%5u %7u %9.0f %9.0f %9.0f %9.0f %8u %8u %7u\n", n, p_node->nr_sent,
+                   mn_percentile(p_node->p_lat, p_node->nr_lat, 50) * us_per_bit,
+                   mn_percentile(p_node->p_lat, p_node->nr_lat, 90) * us_per_bit,
+                   mn_percentile(p_node->p_lat, p_node->nr_lat, 99) * us_per_bit,
+                   mn_percentile(p_node->p_lat, p_node->nr_lat, 100) * us_per_bit,
+                   p_node->nr_arb_lost, p_node->nr_replaced, p_node->nr_overrun);
+        }
+        break;
+    }
+
+    printf("\n%u buses on %u threads: %.0f ms wall, %.0f ms in runs, %.1fx\n", nr_jobs, 
+           nr_threads, wall_ms, cpu_ms, wall_ms > 0 ? cpu_ms / wall_ms : 0.0);
+
+    for (j = 0; j < nr_jobs; j++)
+    {
+        for (n = 0; n < jobs[j].nr_nodes; n++)
+        {
+            free(jobs[j].p_nodes[n].p_lat);
+        }
+        free(jobs[j].p_nodes);
+    }
+    return 0;
+} /* End of function cmd_multinode(). */
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: can_host_tools <command> [args]\n"
+            "  accel-decode [id]   decode accelerometer stream from stdin\n"
+            "  fault-sim [opts]    node goodput and recovery on a faulty bus\n"
+            "      -t s  -p period_ms  -l load  -d stall_ms  -r reinit_ms  -s seed\n"
+            "      -b ber  -a no_ack  -k period_ms,bits  -e rate,on_ms,period_ms\n"
+            "  autobaud-sim [opts] bit rate detection time on simulated buses\n"
+            "      -n runs  -k bus_kbps  -p frame_period_ms  -w window_ms  -m max_ms\n"
+            "      -b ber  -s seed\n"
+            "  multinode [opts]    per node latency and bus load for N nodes\n"
+            "      -n N,N,..  -t s  -r bitrate  -j threads  -s seed  -v N (per node table)\n");
+}
+
+
+/*******************************************************************************
+* Function name: main
+* Description  : Dispatch to the command.
+*******************************************************************************/
+int main(int argc, char * argv[])
+{
+    if (argc < 2)
+    {
+        usage();
+        return 2;
+    }
+
+    if (0 == strcmp(argv[1], "accel-decode"))
+    {
+        return cmd_accel_decode(argc - 2, &argv[2]);
+    }
+    if (0 == strcmp(argv[1], "fault-sim"))
+    {
+        return cmd_fault_sim(argc - 2, &argv[2]);
+    }
+    if (0 == strcmp(argv[1], "autobaud-sim"))
+    {
+        return cmd_autobaud_sim(argc - 2, &argv[2]);
+    }
+    if (0 == strcmp(argv[1], "multinode"))
+    {
+        return cmd_multinode(argc - 2, &argv[2]);
+    }
+
+    usage();
+    return 2;
+} /* End of function main(). */
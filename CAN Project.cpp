@@ -67,7 +67,9 @@
 *                Besides demonstrating Tx and Rx of Standard CAN frames, the 
 *                demo will also send remote frame responses for remote frame 
 *                requests received by the mailbox at CAN-ID 50h (defined by
-*                REMOTE_TEST_ID in can_api_demo.h).
+*                REMOTE_TEST_ID in can_api_demo.h). Further remote IDs can be
+*                added to the remote responder table, see can_remote_resp.c.
+*                The CAN Rx ISR answers requests directly from that table.
 *                Remote frames demo is only done ininterrupt mode:   
 *                "#define USE_CAN_POLL = 0" set in the CAN API config file. 
 *                Remote requests are not sent by this demo as it is, and so must
@@ -120,19 +122,280 @@ Macro definitions
 #define NR_STARTUP_TEST_FRAMES	10
 #define MAX_CHANNELS 3  /* RX63x */
 
+/* Remote frame responder table. Each entry uses one Rx and one Tx mailbox. */
+#define REMOTE_RESP_MAX_IDS         8
+#define REMOTE_STATUS_ID            0x51    /* Remote request for the status frame. */
+#define CANBOX_REMOTE_STATUS_RX     16
+#define CANBOX_REMOTE_STATUS_TX     17
+
+/* Mailbox search function. MSMR modes and MSSR fields. */
+#define MSMR_RX_SEARCH              0x00
+#define MSMR_TX_SEARCH              0x01
+#define MSSR_SEST                   0x80    /* 1 = no mailbox found. */
+#define MSSR_MBNST                  0x1F    /* Mailbox number found. */
+
+/* Peripheral clock feeding CMT and CAN. */
+#define PCLK_HZ                     48000000UL
+#define CAN_BITRATE                 500000UL    /* Configured; can_timing_bitrate() gives the applied rate. */
+#define CAN_SAMPLE_POINT            875         /* Per mille of the bit, CiA 301. */
+#define CAN_OSC_TOL_PPM             1000        /* Clock tolerance the timing must allow, per node. */
+#define CAN_PROP_DELAY_NS           400         /* Round trip: 2 x (transceiver + cable). */
+
+/* ISO-TP (ISO 15765-2) transport, see can_isotp.c. */
+#define ISOTP_TX_ID                 0x7E8   /* Node to tester. */
+#define ISOTP_RX_ID                 0x7E0   /* Tester to node. */
+#define ISOTP_BLOCK_SIZE            0       /* Our FC: 0 = no further FC. */
+#define ISOTP_ST_MIN                0       /* Our FC: min. CF gap, ms. */
+#define CANBOX_ISOTP_TX             18
+#define CANBOX_ISOTP_FC             19
+#define CANBOX_ISOTP_RX             20
+
+/* Uncomment to carry 11-bit and 29-bit frames on the same channel. Sets the
+controller to mixed ID mode; each mailbox then gets the IDE bit of its message
+type. */
+//#define CAN_MIXED_ID_FRAMES       1
+#define CTLR_IDFM_MIXED             2
+#define CAN_CTLR(ch)                (*((CH_0 == (ch)) ? &CAN0.CTLR : \
+                                       (CH_1 == (ch)) ? &CAN1.CTLR : &CAN2.CTLR))
+
+/* J1939, see can_j1939.c. Rx mailboxes 24 and 28-31 use mask registers MKR6 
+and MKR7, so keep other masked mailboxes out of 24-31. */
+#define J1939_PREFERRED_SA          0x80
+#define J1939_STATUS_PGN            0xFF10  /* Proprietary B, node status. */
+#define CANBOX_J1939_TX             21      /* Single frames from the application. */
+#define CANBOX_J1939_TX_CM          22      /* Address claim, TP.CM. */
+#define CANBOX_J1939_TX_DT          23      /* TP.DT. */
+#define CANBOX_J1939_RX_NM          24      /* PF 0xE8-0xEF: request, claim, TP. */
+#define CANBOX_J1939_RX_SUB_FIRST   28      /* Application subscriptions. */
+#define CANBOX_J1939_RX_SUB_LAST    31
+
+/* Status frame multiplexor, data[7]. Group 0 is the original layout. Nodes
+without the multiplexor send 0x77 there, so any value outside the groups 
+counts as the original layout too. */
+#define STATUS_MUX_LEGACY           0
+#define STATUS_MUX_ACCEL            1
+#define STATUS_MUX_TEMPERATURE      2
+#define STATUS_MUX_ADC              3
+#define STATUS_MUX_ERRORS           4
+#define STATUS_MUX_IS_GROUP(sel)    (((sel) >= STATUS_MUX_ACCEL) && ((sel) <= STATUS_MUX_ERRORS))
+
+/* UDS periodic data identifier responses, see can_uds.c. */
+#define UDS_PERIODIC_ID             0x5E8
+#define CANBOX_UDS_PERIODIC         13
+
+/* Compressed accelerometer stream, see can_accel_stream.c. */
+#define DEMO_ACCEL_STREAM           1
+#define ACCEL_STREAM_ID             0x5C0
+#define CANBOX_ACCEL_STREAM         14
+
+/* Debounced input change events, see inputs.c. */
+#define INPUT_EVENT_ID              0x5D0
+#define CANBOX_INPUT_EVENT          15
+
+/* Time sync, see can_tsync.c. Uncomment on the ONE node that is the time 
+master; the others follow it. */
+//#define TIME_SYNC_MASTER          1
+#define TSYNC_ID                    0x5F0
+#define CANBOX_TSYNC_TX             3
+#define CANBOX_TSYNC_RX             9
+
 /* Pick only ONE demo testmode below by uncommenting the macro definition. */ 
 #define DEMO_NORMAL               1
 //#define DEMO_TEST_1_INT_LOOPBACK    1
 //#define DEMO_TEST_0_EXT_LOOPBACK  1
 //#define DEMO_TEST_LISTEN_ONLY     1
+
+/* Detect the bus bit rate in listen only mode before joining, see 
+can_autobaud.c. Extended frames are taken in a mailbox of their own, in 
+the mask group of CANBOX_RX. */
+//#define DEMO_AUTOBAUD             1
+#define CANBOX_AUTOBAUD_XID         5
+#if (CANBOX_AUTOBAUD_XID / 4) != (CANBOX_RX / 4)
+#error "CANBOX_AUTOBAUD_XID must share the mask register of CANBOX_RX"
+#endif
+
+/* Passive bus analyzer in place of the demo, see can_monitor.c. Use with 
+DEMO_TEST_LISTEN_ONLY so the node never drives the bus; the monitor sets 
+listen only again after its FIFO setup and stops if it does not hold. */
+//#define DEMO_BUS_MONITOR          1
+
+/* Mailbox scan benchmark, see can_bench.c. Needs DEMO_TEST_1_INT_LOOPBACK. */
+//#define DEMO_MBOX_SCAN_BENCH      1
+
+/* Accelerometer codec benchmark, see can_accel_stream.c. */
+//#define DEMO_ACCEL_CODEC_BENCH    1
+
+/* ISR and main loop timing probes, see isr_probe.c. Uncomment to build them 
+in; otherwise the probes compile to nothing. */
+//#define ISR_PROBES                1
+#define PROBE_REPORT_ID             0x5E0
+#define CANBOX_PROBE_REPORT         10
+
+/* Gateway between the CAN channels, see can_gateway.c. Interrupt build only.
+Each channel in the route table uses the same two mailboxes. The Rx mailbox
+gets mask register MKR0 (mailboxes 0-3) to itself; keep other receive 
+mailboxes out of 0-3. */
+//#define DEMO_GATEWAY              1
+#define CANBOX_GW_RX                2
+#define CANBOX_GW_TX                11
+#if ((CANBOX_GW_RX / 4) == (CANBOX_RX / 4)) || ((CANBOX_GW_RX / 4) == (CANBOX_REMOTE_RX / 4)) || \
+    ((CANBOX_GW_RX / 4) == (CANBOX_REMOTE_STATUS_RX / 4)) || ((CANBOX_GW_RX / 4) == (CANBOX_ISOTP_RX / 4)) || \
+    ((CANBOX_GW_RX / 4) == (CANBOX_TSYNC_RX / 4)) || ((CANBOX_GW_RX / 4) >= (CANBOX_J1939_RX_NM / 4))
+#error "CANBOX_GW_RX shares its mask register with another receive mailbox"
+#endif
+
+/* Every mailbox above and those of can_api_demo.h, as a bit each. The sum 
+equals the OR only if no two of them are the same mailbox. */
+#define CANBOX_BIT(mbox)            (1ULL << (mbox))
+#define CANBOX_J1939_RX_SUB_BITS    (CANBOX_BIT(CANBOX_J1939_RX_SUB_LAST + 1) - CANBOX_BIT(CANBOX_J1939_RX_SUB_FIRST))
+#define CANBOX_ALL(op)              (CANBOX_BIT(CANBOX_TX) op CANBOX_BIT(CANBOX_RX) op \
+                                     CANBOX_BIT(CANBOX_REMOTE_RX) op CANBOX_BIT(CANBOX_REMOTE_TX) op \
+                                     CANBOX_BIT(CANBOX_REMOTE_STATUS_RX) op CANBOX_BIT(CANBOX_REMOTE_STATUS_TX) op \
+                                     CANBOX_BIT(CANBOX_ISOTP_TX) op CANBOX_BIT(CANBOX_ISOTP_FC) op \
+                                     CANBOX_BIT(CANBOX_ISOTP_RX) op CANBOX_BIT(CANBOX_J1939_TX) op \
+                                     CANBOX_BIT(CANBOX_J1939_TX_CM) op CANBOX_BIT(CANBOX_J1939_TX_DT) op \
+                                     CANBOX_BIT(CANBOX_J1939_RX_NM) op CANBOX_J1939_RX_SUB_BITS op \
+                                     CANBOX_BIT(CANBOX_UDS_PERIODIC) op CANBOX_BIT(CANBOX_ACCEL_STREAM) op \
+                                     CANBOX_BIT(CANBOX_INPUT_EVENT) op CANBOX_BIT(CANBOX_TSYNC_TX) op \
+                                     CANBOX_BIT(CANBOX_TSYNC_RX) op CANBOX_BIT(CANBOX_PROBE_REPORT) op \
+                                     CANBOX_BIT(CANBOX_GW_RX) op CANBOX_BIT(CANBOX_GW_TX) op \
+                                     CANBOX_BIT(CANBOX_AUTOBAUD_XID))
+#if CANBOX_ALL(+) != CANBOX_ALL(|)
+#error "Two CANBOX_ mailbox numbers are the same"
+#endif
+
+/* Heavy vehicle variant: J1939 on the extended ID path, see can_j1939.c. 
+Needs FRAME_ID_MODE set to extended ID mode, or CAN_MIXED_ID_FRAMES. */
+//#define DEMO_J1939                1
+/******************************************************************************
+Frame ID types. Every message is statically typed as standard (can_std_id) or
+extended (can_ext_id), and the mailbox routine is picked at compile time:
+    can_std_id::tx_set(ch, mbox, &frame, DATA_FRAME);
+Messages that follow the global FRAME_ID_MODE use app_id_t. In mixed ID mode 
+one channel carries both types; the IDE bit of the mailbox is set to match.
+******************************************************************************/
+#define CAN_MB_ID(ch, mbox)     ((CH_0 == (ch)) ? &CAN0.MB[mbox].ID : \
+                                 (CH_1 == (ch)) ? &CAN1.MB[mbox].ID : &CAN2.MB[mbox].ID)
+
+/* Transmit rate limits, see can_tx_limit.c. tx_set counts every frame 
+against the bus load budget of its channel; tx_set_limited also checks the
+budget and the per-ID limit, and does not send if either is used up. */
+#define TX_THROTTLED                0x80    /* tx_set_limited: not sent. */
+bool     tx_limit_ready(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide);
+bool     tx_limit_take(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide);
+void     tx_limit_charge(uint32_t ch_nr, uint8_t dlc, uint8_t ide);
+void     tx_limit_get_status(uint8_t * p_dest);
+
+struct can_std_id
+{
+    enum { IDE = 0, ID_MASK_NONE = 0x7FF, DEMO_ID = 0x001, DEMO_RX_MASK = 0x7FF };
+
+    static uint32_t tx_set(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        tx_limit_charge(ch_nr, p_frame->dlc, IDE);
+        return R_CAN_TxSet(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    static uint32_t tx_set_limited(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        if (!tx_limit_take(ch_nr, p_frame->id, p_frame->dlc, IDE))
+        {
+            return TX_THROTTLED;
+        }
+        return tx_set_taken(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    /* Tokens already taken with tx_limit_take. */
+    static uint32_t tx_set_taken(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        return R_CAN_TxSet(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    static uint32_t rx_set(uint32_t ch_nr, uint32_t mbox_nr, uint32_t id, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        return R_CAN_RxSet(ch_nr, mbox_nr, id, frame_type);
+    }
+
+    static uint32_t tx_set_fifo(uint32_t ch_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        return R_CAN_TxSetFifo(ch_nr, p_frame, frame_type);
+    }
+};
+
+struct can_ext_id
+{
+    /* The demo Rx mask leaves ID bit 1 out: both ID 1 and 3 are received. */
+    enum { IDE = 1, ID_MASK_NONE = 0x1FFFFFFF, DEMO_ID = 0x000A0001, DEMO_RX_MASK = 0x1FFFFFFD };
+
+    static uint32_t tx_set(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        tx_limit_charge(ch_nr, p_frame->dlc, IDE);
+        return R_CAN_TxSetXid(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    static uint32_t tx_set_limited(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        if (!tx_limit_take(ch_nr, p_frame->id, p_frame->dlc, IDE))
+        {
+            return TX_THROTTLED;
+        }
+        return tx_set_taken(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    /* Tokens already taken with tx_limit_take. */
+    static uint32_t tx_set_taken(uint32_t ch_nr, uint32_t mbox_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        return R_CAN_TxSetXid(ch_nr, mbox_nr, p_frame, frame_type);
+    }
+
+    static uint32_t rx_set(uint32_t ch_nr, uint32_t mbox_nr, uint32_t id, uint32_t frame_type)
+    {
+        #if CAN_MIXED_ID_FRAMES
+        CAN_MB_ID(ch_nr, mbox_nr)->BIT.IDE = IDE;
+        #endif
+        return R_CAN_RxSetXid(ch_nr, mbox_nr, id, frame_type);
+    }
+
+    static uint32_t tx_set_fifo(uint32_t ch_nr, const can_frame_t * p_frame, uint32_t frame_type)
+    {
+        return R_CAN_TxSetFifoXid(ch_nr, p_frame, frame_type);
+    }
+};
+
+template <bool STD_ID> struct can_id_select                 { typedef can_std_id type; };
+template <>            struct can_id_select<false>          { typedef can_ext_id type; };
+
+/* Demo, status and remote frames follow the configured frame ID mode. */
+typedef can_id_select<(FRAME_ID_MODE == STD_ID_MODE)>::type app_id_t;
+
+/* Diagnostics (ISO-TP, UDS) always use 11-bit IDs, J1939 always 29-bit. */
+typedef can_std_id  diag_id_t;
+typedef can_ext_id  j1939_id_t;
+
 /******************************************************************************
 Exported global variables (to be accessed by other files)
 ******************************************************************************/
 /* Demo data */
 
-#define engine PORTA.PIDR.BIT.B6
-#define fuel PORTA.PIDR.BIT.B7
-#define traction PORTC.PIDR.BIT.B1
+/* Debounced by inputs_tick, see inputs.c. */
+#define engine      ((g_input_image & INPUT_ENGINE) ? 1 : 0)
+#define fuel        ((g_input_image & INPUT_FUEL) ? 1 : 0)
+#define traction    ((g_input_image & INPUT_TRACTION) ? 1 : 0)
 
 
 can_frame_t		g_tx_dataframe;
@@ -155,6 +418,37 @@ uint32_t			CAN0_tx_remote_sentdata_flag = 0;
 uint32_t			CAN0_rx_newdata_flag = 0;
 uint32_t			CAN0_rx_test_newdata_flag = 0;
 uint32_t			CAN0_rx_g_remote_frame_flag = 0;
+
+/* Receive ring filled by CAN0_RXM0_ISR. Size must be a power of 2. */
+#define CAN_RX_RING_SIZE    16
+typedef struct
+{
+    can_frame_t     frame;
+    uint8_t         mbox;       /* Mailbox the frame came from. */
+    uint8_t         status;     /* R_CAN_RxRead return value. */
+} can_rx_slot_t;
+
+static can_rx_slot_t    can_rx_ring[CAN_RX_RING_SIZE];
+static volatile uint8_t can_rx_head;    /* Written by ISR only. */
+static volatile uint8_t can_rx_tail;    /* Written by can_rx_read only. */
+uint32_t                can_rx_nr_overflow = 0;
+
+/* Bus statistics. Frames handled by the CAN0 ISRs. */
+uint32_t                can_nr_rx_frames = 0;
+uint32_t                can_nr_tx_frames = 0;
+
+/* Receive ring consumers. Each gets a read-only view of the slot, which is 
+released when the last one returns. */
+#define CAN_RX_MAX_CONSUMERS    4
+typedef void (* can_rx_consumer_t)(const can_frame_t * p_frame, uint8_t status);
+
+static can_rx_consumer_t    can_rx_consumers[CAN_RX_MAX_CONSUMERS];
+static uint8_t              can_rx_nr_consumers = 0;
+
+const can_rx_slot_t * can_rx_borrow(void);
+void     can_rx_release(void);
+bool     can_rx_consumer_add(can_rx_consumer_t consumer);
+bool     can_rx_dispatch(void);
 #endif 
 
 enum app_err_enum	app_err_nr;
@@ -164,6 +458,214 @@ void lcd_flash(void);
 void RTC_display(void);
 void accel(char);
 
+/* Remote frame responder table, see can_remote_resp.c. */
+int8_t  remote_resp_register(uint32_t id, uint8_t rx_mbox, uint8_t tx_mbox, const can_frame_t * p_frame);
+void    remote_resp_update(int8_t idx, const uint8_t * p_data, uint8_t dlc);
+uint8_t remote_resp_serve(uint8_t mbox_nr);
+
+/* Diagnostics. */
+void get_can_err_info(uint8_t ch_nr, uint8_t * p_dest);
+void accel_get_xyz(int16_t * p_xyz);
+
+/* Free running benchmark timer, see can_bench.c. */
+void     bench_timer_init(void);
+uint16_t bench_timer_read(void);
+void     can_mbox_scan_benchmark(void);
+
+/* ISO-TP transport, see can_isotp.c. */
+#if (USE_CAN_POLL == 0)
+uint32_t isotp_init(uint8_t block_size, uint8_t st_min);
+uint32_t isotp_send(const uint8_t * p_data, uint16_t len);
+uint8_t  isotp_tx_busy(void);
+uint16_t isotp_receive(uint8_t * p_dest, uint16_t max_len);
+void     isotp_rx_frame(const can_frame_t * p_frame);
+void     isotp_tx_done(uint8_t mbox_nr);
+#endif
+
+/* 1 ms system tick, see sys_tick.c. */
+extern volatile uint32_t g_tick_ms;
+void     sys_tick_init(void);
+uint32_t sys_time_us(void);
+
+/* Boot profile and init sequencer, see boot_seq.c. */
+typedef enum
+{
+    BOOT_TICK_STARTED = 0,
+    BOOT_CAN_CREATED,
+    BOOT_CAN_PORT_SET,
+    BOOT_CAN_OPERATE,
+    BOOT_FIRST_FRAME,
+    BOOT_ACCEL_READY,
+    BOOT_THERMAL_READY,
+    BOOT_ADC_READY,
+    BOOT_BURST_DONE,
+    BOOT_DONE,
+    BOOT_NR_PHASES
+} boot_phase_t;
+
+/* Debounced inputs, see inputs.c. Bits as UDS DID 0xF201. */
+#define INPUT_ENGINE        0x01
+#define INPUT_FUEL          0x02
+#define INPUT_TRACTION      0x04
+extern volatile uint8_t g_input_image;
+void     inputs_init(void);
+void     inputs_tick(void);
+
+/* RTC timebase, see rtc_timebase.c. */
+extern volatile uint8_t g_rtc_text_changed;
+extern char     g_rtc_date_text[13];
+extern char     g_rtc_time_text[13];
+void     rtc_timebase_init(void);
+uint64_t rtc_timestamp_us(void);
+
+/* Time sync over CAN, see can_tsync.c. */
+#if (USE_CAN_POLL == 0)
+uint32_t tsync_init(void);
+void     tsync_tick(void);
+void     tsync_tx_done(uint64_t t_tx_us);
+void     tsync_rx_frame(const can_frame_t * p_frame, uint64_t t_rx_us);
+uint64_t tsync_to_master_us(uint64_t local_us);
+uint64_t tsync_now_us(void);
+void     tsync_get_status(uint8_t * p_dest);
+#endif
+
+/* Shared frame buffers, see can_frame_pool.c. A handle is an index into the
+pool; the frame goes back to the pool when its last reference is released. */
+#define FRAME_POOL_SIZE             16
+#define FRAME_NONE                  0xFF
+typedef uint8_t frame_h_t;
+
+frame_h_t     frame_pool_alloc(void);
+can_frame_t * frame_pool_frame(frame_h_t h);
+void          frame_pool_ref(frame_h_t h);
+void          frame_pool_release(frame_h_t h);
+void          frame_pool_get_status(uint8_t * p_dest);
+uint32_t      int_mask_save(void);
+void          int_mask_restore(uint32_t psw);
+
+/* Latest-value transmit, see can_latest_tx.c. */
+#if (USE_CAN_POLL == 0)
+#define STATUS_DEADLINE_MS          100     /* Status frame older than this is dropped. */
+bool     latest_tx_ready(uint32_t mbox_nr, uint32_t id);
+uint32_t latest_tx_set(uint32_t mbox_nr, const can_frame_t * p_frame, uint16_t deadline_ms);
+uint32_t latest_tx_set_taken(uint32_t mbox_nr, const can_frame_t * p_frame, uint16_t deadline_ms);
+void     latest_tx_tick(void);
+void     latest_tx_get_status(uint8_t * p_dest);
+#endif
+
+/* Bit timing, see can_bit_timing.c. Time quanta: sync 1 + tseg1 + tseg2. */
+typedef struct
+{
+    uint32_t    bitrate;
+    uint16_t    brp;                /* fCAN = PCLK / brp. */
+    uint8_t     tq_per_bit;
+    uint8_t     tseg1;              /* Propagation + phase buffer 1. */
+    uint8_t     tseg2;
+    uint8_t     sjw;
+    uint16_t    sample_point;       /* Per mille. */
+    uint16_t    osc_tol_ppm;        /* Largest clock tolerance it allows. */
+} can_timing_t;
+
+uint32_t can_timing_calc(uint32_t bitrate, uint16_t sample_point, uint16_t osc_tol_ppm,
+                         can_timing_t * p_timing);
+uint32_t can_timing_apply(uint32_t ch_nr, const can_timing_t * p_timing);
+uint32_t can_timing_set(uint32_t ch_nr, uint32_t bitrate);
+uint32_t can_timing_restore(uint32_t ch_nr);
+uint32_t can_timing_bitrate(uint32_t ch_nr);
+void     can_timing_get_status(uint8_t * p_dest);
+
+/* Bit rate detection, see can_autobaud.c. */
+#if DEMO_AUTOBAUD
+uint32_t autobaud_detect(uint32_t ch_nr);
+void     autobaud_get_status(uint8_t * p_dest);
+#endif
+
+/* Bus monitor, see can_monitor.c. */
+#if DEMO_BUS_MONITOR
+void     monitor_run(void);
+#endif
+
+/* Gateway, see can_gateway.c. */
+#if (USE_CAN_POLL == 0) && DEMO_GATEWAY
+uint32_t gateway_init(void);
+void     gateway_rx(uint32_t ch_nr, uint32_t mbox_nr);
+void     gateway_tx_done(uint32_t ch_nr);
+void     gateway_poll(void);
+void     gateway_get_status(uint8_t * p_dest);
+#endif
+
+/* Timing probes, see isr_probe.c. Durations from the bench timer. */
+typedef enum
+{
+    PROBE_CAN_TX_ISR = 0,
+    PROBE_CAN_RX_ISR,
+    PROBE_CAN_ERS_ISR,
+    PROBE_SYS_TICK_ISR,
+    PROBE_CMT_CALLBACK,
+    PROBE_LOOP_STATUS,              /* Main loop: inputs, ADC, status frame. In us. */
+    PROBE_LOOP_APP,                 /* Main loop: received frames, diagnostics. In us. */
+    PROBE_LAT_CAN_RX,               /* Frame received to Rx ISR entry. */
+    PROBE_LAT_SYS_TICK,             /* Compare match to tick ISR entry. */
+    PROBE_NR
+} probe_id_t;
+
+#if ISR_PROBES
+void     probe_enter(probe_id_t id);
+void     probe_exit(probe_id_t id);
+void     probe_value(probe_id_t id, uint16_t ticks);
+void     probe_poll(void);
+#define PROBE_ENTER(id)         probe_enter(id)
+#define PROBE_EXIT(id)          probe_exit(id)
+#define PROBE_VALUE(id, ticks)  probe_value((id), (ticks))
+#else
+#define PROBE_ENTER(id)
+#define PROBE_EXIT(id)
+#define PROBE_VALUE(id, ticks)
+#endif
+
+/* Battery ADC, see adc_scan.c. */
+void     adc_scan_init(void);
+uint16_t adc_scan_read(void);
+bool     battery_low_update(uint8_t level);
+
+void     boot_mark(boot_phase_t phase);
+void     boot_run_step(void);
+void     boot_finish(void);
+uint32_t boot_time_to_first_frame_us(void);
+
+/* J1939, see can_j1939.c. */
+#if DEMO_J1939
+uint32_t j1939_init(void);
+uint32_t j1939_subscribe(uint32_t pgn);
+uint32_t j1939_send(uint32_t pgn, uint8_t priority, uint8_t da, const uint8_t * p_data, uint16_t len);
+uint16_t j1939_receive(uint32_t * p_pgn, uint8_t * p_sa, uint8_t * p_dest, uint16_t max_len);
+void     j1939_rx_frame(const can_frame_t * p_frame);
+void     j1939_tick(void);
+#endif
+
+/* Multiplexed status frame, see can_status_mux.c. */
+const can_frame_t * status_mux_next(const can_frame_t * p_legacy);
+void     status_mux_receive(const can_frame_t * p_frame);
+void     status_mux_note_temperature(int16_t temp);
+
+/* Compressed accelerometer stream, see can_accel_stream.c. */
+void     accel_stream_put(const int16_t * p_xyz);
+void     accel_stream_poll(void);
+void     accel_codec_benchmark(void);
+
+/* Accelerometer calibration record in data flash, see accel_cal_store.c. */
+bool     accel_cal_load(int16_t * p_zero, int16_t * p_selftest, bool * p_selftest_ok);
+void     accel_cal_save(const int16_t * p_zero, const int16_t * p_selftest, bool selftest_ok);
+void     accel_cal_poll(void);
+void     accel_cal_check_poll(void);
+
+/* UDS data identifier server, see can_uds.c. */
+#if (USE_CAN_POLL == 0)
+void     uds_init(void);
+void     uds_poll(void);
+void     uds_tick(void);
+#endif
+
 /******************************************************************************
 Private global variables and functions
 ******************************************************************************/
@@ -193,9 +695,16 @@ uint32_t g_rx_id_default;
 char lcd_out[13],date_d[13],time_d[13],cmp[10];
 
 uint16_t adc_result;
+uint16_t adc_raw;
+
+/* Remote responder table index of the status frame response. */
+static int8_t   remote_status_idx = -1;
 
 /* Functions */
 static uint32_t init_can_app(void);
+#if CAN_MIXED_ID_FRAMES
+static uint32_t can_id_mode_mixed(uint32_t ch_nr);
+#endif
 static void check_can_errors(void);
 static void handle_can_bus_state(uint8_t ch_nr);
 
@@ -203,6 +712,8 @@ static void handle_can_bus_state(uint8_t ch_nr);
 static void can_poll_demo(void);
 #else 
 static void can_int_demo(void);
+static void app_rx_status_mux(const can_frame_t * p_frame, uint8_t status);
+static void app_rx_display(const can_frame_t * p_frame, uint8_t status);
 #endif 
 
 
@@ -218,25 +729,34 @@ void can_api_demo(void)
     uint32_t i;
     uint32_t api_status = R_CAN_OK;
     uint8_t     disp_buf[13] = {0}; /* Temporary storage for display strings. */   
+    static bool timing_done = false;
 
     g_can_channel = CH_0; /* using CAN channel 0 for this demo */
 	int a,b,c,d,e,f;
 	char lcd_out[13],eng,fl,trac,ts;
 
     /* Set default mailbox IDs for the demo*/
-    if (FRAME_ID_MODE == STD_ID_MODE)
-    {
-        g_tx_id_default = 0x001;
-        g_rx_id_default = 0x001;    
-    }
-    else
-    {
-        g_tx_id_default = 0x000A0001;
-        g_rx_id_default = 0x000A0001;    
-    }
+    g_tx_id_default = app_id_t::DEMO_ID;
+    g_rx_id_default = app_id_t::DEMO_ID;    
+
+    #if ISR_PROBES
+    /* Probe time base, before any probed interrupt is enabled. */
+    bench_timer_init();
+    #endif
+
+    #if (USE_CAN_POLL == 0)
+    /* Receivers of the frames the Rx ISR puts in the ring. */
+    can_rx_consumer_add(app_rx_status_mux);
+    can_rx_consumer_add(app_rx_display);
+    #endif
+
+    /* Timers for the CAN protocol layers. */
+    sys_tick_init();
+    boot_mark(BOOT_TICK_STARTED);
 
     /* Init CAN. */
     api_status = R_CAN_Create(g_can_channel);
+    boot_mark(BOOT_CAN_CREATED);
     
     if (api_status != R_CAN_OK)
     {   /* An error at this stage is fatal to demo, so stop here. */
@@ -248,6 +768,32 @@ void can_api_demo(void)
             nop();/* Wait here and leave error displayed. */
         } 
     } 
+
+    /* CAN_BITRATE, or the rate the bus runs at, in place of the rate of the
+    driver config. Found on the first pass; later passes put the same timing
+    back after R_CAN_Create. */
+    if (timing_done)
+    {
+        api_status |= can_timing_restore(g_can_channel);
+    }
+    else
+    {
+        if (R_CAN_OK != can_timing_set(g_can_channel, CAN_BITRATE))
+        {
+            printf("\nNo bit timing for %lu bps, driver config kept", CAN_BITRATE);
+        }
+
+        #if DEMO_AUTOBAUD
+        /* Join at the rate the bus runs at, listening only until it is found. */
+        autobaud_detect(g_can_channel);
+        #endif
+        timing_done = true;
+    }
+
+    #if CAN_MIXED_ID_FRAMES
+    /* Standard and extended frames on the same channel. */
+    api_status |= can_id_mode_mixed(g_can_channel);
+    #endif
     
     /***************************************************************************
     * Pick ONE R_CAN_PortSet call below by uncommenting the matching macro  
@@ -264,9 +810,16 @@ void can_api_demo(void)
     #elif DEMO_TEST_LISTEN_ONLY
     R_CAN_PortSet(g_can_channel, CANPORT_TEST_LISTEN_ONLY);
     #endif
+    boot_mark(BOOT_CAN_PORT_SET);
+
+    #if DEMO_BUS_MONITOR
+    /* Capture and count every frame on the bus. Does not return. */
+    monitor_run();
+    #endif
 
     /* Initialize CAN mailboxes. */
     api_status |= init_can_app();
+    boot_mark(BOOT_CAN_OPERATE);
 
     /* Is all OK after all CAN initialization? */
     if (api_status != R_CAN_OK)
@@ -280,24 +833,21 @@ void can_api_demo(void)
     /*****************************************************************************/
     /* This is how you send multiple messages back to back. Sending 10 messages. */
     /*****************************************************************************/
-    if (FRAME_ID_MODE == STD_ID_MODE )
-    {
-        api_status |= R_CAN_TxSet(g_can_channel, CANBOX_TX, &g_tx_dataframe, DATA_FRAME);   
-    }
-    else
-    {
-        api_status |= R_CAN_TxSetXid(g_can_channel, CANBOX_TX, &g_tx_dataframe, DATA_FRAME);
-    }
+    api_status |= app_id_t::tx_set(g_can_channel, CANBOX_TX, &g_tx_dataframe, DATA_FRAME);   
 
+    /* The rest of the burst goes out while the boot sequencer initializes the
+    sensors, one step per frame. */
     #if (USE_CAN_POLL == 1)
     while (R_CAN_TxCheck(g_can_channel, CANBOX_TX))
     {
         /* Poll loop. A real application should provide for timeout. */
     }
+    boot_mark(BOOT_FIRST_FRAME);
 
     for (i = 0; i < NR_STARTUP_TEST_FRAMES; i++)
     {
         api_status |= R_CAN_Tx(g_can_channel, CANBOX_TX);
+        boot_run_step();
 
         while (R_CAN_TxCheck(g_can_channel, CANBOX_TX))
         {
@@ -312,10 +862,12 @@ void can_api_demo(void)
     }
 
     CAN0_tx_sentdata_flag = 0;
+    boot_mark(BOOT_FIRST_FRAME);
 
     for (i = 0; i < NR_STARTUP_TEST_FRAMES; i++)
     {
         api_status |= R_CAN_Tx(g_can_channel, CANBOX_TX);
+        boot_run_step();
 
         while (0 == CAN0_tx_sentdata_flag)
         {
@@ -325,20 +877,28 @@ void can_api_demo(void)
         CAN0_tx_sentdata_flag = 0; /* Clear the flag for next loop iteration. */
     }
     #endif
+    boot_mark(BOOT_BURST_DONE);
+
+    /* Steps left over, then the boot report. Once only. */
+    boot_finish();
+
+    #if DEMO_MBOX_SCAN_BENCH
+    can_mbox_scan_benchmark();
+    #endif
+
+    #if DEMO_ACCEL_CODEC_BENCH
+    accel_codec_benchmark();
+    #endif
 
     /*	M A I N	L O O P	* * * * * * * * * * * * * * * * * * * * * * * * * */	
 	
 	
-	PORTA.PDR.BIT.B6 = 0;
-	PORTA.PDR.BIT.B7= 0;
-	PORTC.PDR.BIT.B1= 0;
-	
-	engine=1;
-	fuel =1;
-	traction=1;
+	/* Input pins are set up by inputs_init. */
 	
    // while(1)
     //{
+        PROBE_ENTER(PROBE_LOOP_STATUS);
+
         /* User pressing switch(es) */
 		/********************
         read_switches();*/
@@ -381,8 +941,9 @@ void can_api_demo(void)
 		
  
 
-		adc_result = S12ADC_read();
-	    adc_result=adc_result/455;
+		/* Filtered battery level, 16-bit full scale. adc_raw keeps the 12-bit scale. */
+		adc_raw = adc_scan_read() >> 4;
+	    adc_result=adc_raw/455;
 		g_tx_dataframe.data[0] = adc_result;
 		printf("\n adc=%X",g_tx_dataframe.data[0]);
 		g_tx_dataframe.data[1] = eng;
@@ -391,6 +952,14 @@ void can_api_demo(void)
 		g_tx_dataframe.data[4] = temperature;
 		g_tx_dataframe.data[5] = accident;
 		
+		/* Keep the remote status response in step with the status frame. */
+		remote_resp_update(remote_status_idx, g_tx_dataframe.data, 8);
+
+		#if DEMO_J1939
+		/* Same signals as a J1939 broadcast. Refused until the address is claimed. */
+		j1939_send(J1939_STATUS_PGN, 6, 0xFF, g_tx_dataframe.data, 8);
+		#endif
+
 		printf("\nengine transmit %c",g_tx_dataframe.data[1]);
 		printf("\nfuel  transmit%c",g_tx_dataframe.data[2]);
 		printf("\ntract transmit%c",g_tx_dataframe.data[3]); 
@@ -449,31 +1018,29 @@ void can_api_demo(void)
 	        uint8_t	i = 0;
 	    #endif
     
-	    if (FRAME_ID_MODE == STD_ID_MODE )
+	    /* The status ID carries the other signal groups in turn. While it is
+	    throttled, or another frame holds the mailbox, the group is kept for 
+	    the next pass. A status frame still waiting for the bus is replaced 
+	    by the newer one. The tokens are taken before the next group is 
+	    built, so a throttled pass is counted for DID 0xF20A. */
+	    #if (USE_CAN_POLL == 0)
+	    if (latest_tx_ready(CANBOX_TX, g_tx_dataframe.id) &&
+	        tx_limit_take(CH_0, g_tx_dataframe.id, 8, app_id_t::IDE))
 	    {
-	        R_CAN_TxSet(0, CANBOX_TX, &g_tx_dataframe, DATA_FRAME);
-		
+	        latest_tx_set_taken(CANBOX_TX, status_mux_next(&g_tx_dataframe), STATUS_DEADLINE_MS);
 	    }
-	    else
-	    {   /* Extended ID mode. */
-	
-	        R_CAN_TxSetXid(0, CANBOX_TX, &g_tx_dataframe, DATA_FRAME); 
-		
+	    #else
+	    if (tx_limit_take(CH_0, g_tx_dataframe.id, 8, app_id_t::IDE))
+	    {
+	        app_id_t::tx_set_taken(CH_0, CANBOX_TX, status_mux_next(&g_tx_dataframe), DATA_FRAME);
 	    }
+	    #endif
 
 	    #if TEST_FIFO
 	    /* Send three more to fill FIFO. */
 	    for (i == 0; i < 3; i++)
 	    {
-	        if (FRAME_ID_MODE == STD_ID_MODE )
-	        {
-	            R_CAN_TxSetFifo(g_can_channel, &tx_fifo_dataframe, DATA_FRAME);
-		
-			}
-	        else
-	        {
-	            R_CAN_TxSetFifoXid(g_can_channel, &tx_fifo_dataframe, DATA_FRAME);
-	        }
+	        app_id_t::tx_set_fifo(g_can_channel, &tx_fifo_dataframe, DATA_FRAME);
 	    }
     
 	    #ifdef USE_CAN_POLL
@@ -482,7 +1049,7 @@ void can_api_demo(void)
 	    #endif
 	    #endif*/
 	
-
+        PROBE_EXIT(PROBE_LOOP_STATUS);
 		
 
 
@@ -490,11 +1057,13 @@ void can_api_demo(void)
 
         if (can_state[0] != R_CAN_STATUS_BUSOFF)
         {
+            PROBE_ENTER(PROBE_LOOP_APP);
             #if (USE_CAN_POLL == 1)
             can_poll_demo();
             #else
             can_int_demo();
             #endif 
+            PROBE_EXIT(PROBE_LOOP_APP);
         }
         else
             /* Bus Off. */
@@ -506,6 +1075,16 @@ void can_api_demo(void)
     //        lcd_flash();
        }
 
+        #if ISR_PROBES
+        /* Timing report, every few seconds. */
+        probe_poll();
+        #endif
+
+        #if (USE_CAN_POLL == 0) && DEMO_GATEWAY
+        /* Gateway throughput, per second. */
+        gateway_poll();
+        #endif
+
         /* Reset receive/transmit indication. */
        // LED6 = LED_OFF;
        // LED7 = LED_OFF;
@@ -634,142 +1213,28 @@ static void can_int_demo(void)
     if (CAN0_rx_newdata_flag)
     {
         CAN0_rx_newdata_flag = 0;
-        /*  ******
-		LED4 = LED_ON;*/
-
-       // lcd_display(LCD_LINE7, "Rx OK. Read:"); 
-
-        /* Read CAN data. */
-        api_status = R_CAN_RxRead(g_can_channel, CANBOX_RX, &g_rx_dataframe);
-
-        /* Displaying the Recieved CAN Frame on LCD Line2 */
-	   
-	 
-	    sprintf((char *)disp_buf, "%X",  
-            g_rx_dataframe.data[0] 
-           );
-		   
-		   
-		   printf("\ng_rx_dataframe = %X",g_rx_dataframe.data[0]);
-		   
-// while(1)
-//		   {
-			  	printf("\nengine receive %c",g_tx_dataframe.data[1]);
-				printf("\nfuel  receive%c",g_tx_dataframe.data[2]);
-				printf("\ntract receive%c",g_tx_dataframe.data[3]); 
-		
-		
-			  	if(g_rx_dataframe.data[0]==0 || g_rx_dataframe.data[0]<=2)
-			   {
-				   LED4=LED_OFF;
-				   LED6=LED_ON;
-				   lcd_display(LCD_LINE3, "BATTERY LOW");
-			   }
-			   else
-			   {
-	              LED4=LED_ON;
-				  LED6=LED_OFF;
-				  lcd_display(LCD_LINE3, "BATTERY OK");
-				}
-				 
-		  			if (g_rx_dataframe.data[1]=='R')// engine chk
-			{
-					sprintf(lcd_out,"Engine high ");
-    				lcd_display(LCD_LINE4,lcd_out);
-					LED11=LED_ON;
-					LED15=LED_OFF;
-			}
-			else
-			{
-					sprintf(lcd_out,"Engine low ");
-    				lcd_display(LCD_LINE4,lcd_out);
-					LED15=LED_ON;
-					LED11=LED_OFF;
-			}
-			if (g_rx_dataframe.data[2]=='R')// fuel check
-			{
-				sprintf(lcd_out,"Fuel high");
-    			lcd_display(LCD_LINE5,lcd_out);
-				LED10=LED_ON;
-				LED8=LED_OFF;
-			}
-			else
-			{
-				sprintf(lcd_out,"Fuel low");
-    			lcd_display(LCD_LINE5,lcd_out);
-				LED8=LED_ON;
-				LED10=LED_OFF;
-				
-			}
-			if (g_rx_dataframe.data[3]=='R')// traction check 
-			{
-				
-				sprintf(lcd_out,"Tract high");
-    			lcd_display(LCD_LINE6,lcd_out);
-				LED14=LED_ON;
-				LED12=LED_OFF;
-			}
-			else
-			{
-				sprintf(lcd_out,"Tract low");
-    			lcd_display(LCD_LINE6,lcd_out);
-				LED12=LED_ON;
-				LED14=LED_OFF;
-				
-			}
-			 if (g_rx_dataframe.data[4]>(28*28))
-			  {
-				sprintf(lcd_out, "  Accident ");
-				lcd_display(LCD_LINE7, lcd_out);	
-				LED15=LED_ON;
-				LED13=LED_OFF;
-				
-			  }
-			  else
-			{
-				sprintf(lcd_out, "   ");
-				lcd_display(LCD_LINE7, lcd_out);
-				LED13=LED_ON;
-				LED15=LED_OFF;
-			}
-			
-				 if (g_rx_dataframe.data[5]>280)
-			  {
-				sprintf(lcd_out, "High temp");
-				lcd_display(LCD_LINE8, lcd_out);	
-				LED11=LED_ON;
-				LED9=LED_OFF;
-				
-			  }
-			  else
-			{
-				sprintf(lcd_out, "Norm temp");
-				lcd_display(LCD_LINE8, lcd_out);
-				LED9=LED_ON;
-				LED11=LED_OFF;
-			}
-			
-//			   break;						
-		  
-//		   } // End of while 
-		   
-		/*
-        /* Display the formatted string. */                    
-       // lcd_display(LCD_LINE2, disp_buf);
-
-        /* Clear the displayed data after a pause. */         
-       // lcd_flash();
 
-        /* Display error, if any. */
-        if (R_CAN_MSGLOST == api_status)
+        /* The consumers read the frame in place in the receive ring. One 
+        frame per pass; more waiting are handled on the next pass. */
+        if (can_rx_dispatch())
         {
-            //lcd_display(LCD_LINE7, "MSGLOST"); 
-            lcd_flash();
+            CAN0_rx_newdata_flag = 1;
         }
-		/*  ******
-        LED4 = LED_OFF; */
     }
 
+    /* Diagnostic requests arrive by ISO-TP. */
+    uds_poll();
+
+    #if DEMO_ACCEL_STREAM
+    /* Send buffered accelerometer samples, packed. */
+    accel_stream_poll();
+    #endif
+
+    /* Check a stored accelerometer calibration, write a changed one to data 
+    flash. */
+    accel_cal_check_poll();
+    accel_cal_poll();
+
     if (CAN0_rx_test_newdata_flag)
     {
         CAN0_rx_test_newdata_flag = 0;
@@ -779,85 +1244,210 @@ static void can_int_demo(void)
         lcd_flash();
     }
 
-    /* Set up remote reply if remote request came in. */
+    /* The Rx ISR already answered the remote request from the responder table.
+    Prepare the next reply so the demo counter advances with each request. */
     if (1 == CAN0_rx_g_remote_frame_flag)
     {
         CAN0_rx_g_remote_frame_flag = 0;
         g_remote_frame.data[0]++;
-        
-        if (FRAME_ID_MODE == STD_ID_MODE )
-        {
-            R_CAN_TxSet(g_can_channel, CANBOX_REMOTE_TX, &g_remote_frame, DATA_FRAME);   
-        }
-        else
-        {
-            R_CAN_TxSetXid(g_can_channel, CANBOX_REMOTE_TX, &g_remote_frame, DATA_FRAME);             
-        }    
+
+        remote_resp_update(0, g_remote_frame.data, 8);
     }
 	/*  ******
     LED4 = LED_OFF;*/
 
 }/* End function can_int_demo(). */
 
-#endif  /* USE_CAN_POLL == */
+
+/*****************************************************************************
+* Function name:    app_rx_status_mux
+* Description  :    Receive ring consumer. Status frames of the groups after
+*                   group 0, see can_status_mux.c.
+* Arguments    :    p_frame -
+*                       Frame in the ring, valid until return.
+*                   status -
+*                       R_CAN_RxRead result.
+* Return value :    none
+*****************************************************************************/
+static void app_rx_status_mux(const can_frame_t * p_frame, uint8_t status)
+{
+    if ((p_frame->dlc == 8) && STATUS_MUX_IS_GROUP(p_frame->data[7]))
+    {
+        status_mux_receive(p_frame);
+    }
+}/* End function app_rx_status_mux(). */
 
 
 /*****************************************************************************
-* Function name:    init_can_app
-* Description  : 	Initialize CAN demo application
-* Arguments    :    none
-* Return value : 	none
+* Function name:    app_rx_display
+* Description  :    Receive ring consumer. Shows the group 0 status of the 
+*                   other node on the LCD and LEDs.
+* Arguments    :    p_frame -
+*                       Frame in the ring, valid until return.
+*                   status -
+*                       R_CAN_RxRead result.
+* Return value :    none
 *****************************************************************************/
-static uint32_t init_can_app(void)
-{	
-    uint32_t	api_status = R_CAN_OK;
-    uint32_t    i; /* Common loop index variable. */
+static void app_rx_display(const can_frame_t * p_frame, uint8_t status)
+{
+    /* Only group 0, and nodes without the multiplexor, have the layout below. */
+    if ((p_frame->dlc == 8) && STATUS_MUX_IS_GROUP(p_frame->data[7]))
+    {
+        return;
+    }
 
-    can_state[0] = R_CAN_STATUS_ERROR_ACTIVE;
+    printf("\ng_rx_dataframe = %X", p_frame->data[0]);
+    printf("\nengine receive %c", g_tx_dataframe.data[1]);
+    printf("\nfuel  receive%c", g_tx_dataframe.data[2]);
+    printf("\ntract receive%c", g_tx_dataframe.data[3]); 
 
-    for (i = 0; i < MAX_CHANNELS; i++) /* Initialize status for all channels. */
+    if (battery_low_update(p_frame->data[0]))
     {
-        error_bus_status[i] = R_CAN_STATUS_ERROR_ACTIVE;
-        error_bus_status_prev[i] = R_CAN_STATUS_ERROR_ACTIVE;            
+        LED4 = LED_OFF;
+        LED6 = LED_ON;
+        lcd_display(LCD_LINE3, "BATTERY LOW");
+    }
+    else
+    {
+        LED4 = LED_ON;
+        LED6 = LED_OFF;
+        lcd_display(LCD_LINE3, "BATTERY OK");
     }
-    
-    /* Configure mailboxes in Halt mode. */
-    api_status |= R_CAN_Control(g_can_channel, HALT_CANMODE);
 
-    /********	Init demo to recieve data	********/	
-    /* Use API to set one CAN mailbox for demo receive. */
-    /* Standard id. Choose value 0-0x07FF (2047). */
-    if (FRAME_ID_MODE == STD_ID_MODE)
-    { 
-        api_status |= R_CAN_RxSet(g_can_channel, CANBOX_RX, g_rx_id_default, DATA_FRAME);
-        
-        /* Mask for receive box. Write to mask only in Halt mode. */
-        /* 0x7FF = no mask. 0x7FD = mask bit 1, for example; If receive ID is set to 1, both
-           ID 1 and 3 should be received. */
-        R_CAN_RxSetMask( g_can_channel, CANBOX_RX, 0x7FF);           
+    if (p_frame->data[1] == 'R') // engine chk
+    {
+        lcd_display(LCD_LINE4, "Engine high ");
+        LED11 = LED_ON;
+        LED15 = LED_OFF;
     }
     else
     {
-        api_status |= R_CAN_RxSetXid(g_can_channel, CANBOX_RX, g_rx_id_default, DATA_FRAME);
-        
-        /* Mask for receive box. Write to mask only in Halt mode. */
-        /* 0x1FFFFFFF = no mask. 0x1FFFFFFD = mask bit 1, for example; If receive ID is set to 1, both
-           ID 1 and 3 should be received. */
-        R_CAN_RxSetMask( g_can_channel, CANBOX_RX, 0x1FFFFFFD);                  
+        lcd_display(LCD_LINE4, "Engine low ");
+        LED15 = LED_ON;
+        LED11 = LED_OFF;
     }
 
-    /********	Init. demo Tx dataframe RAM structure	********/	
-    /* Standard id. Choose value 0-0x07FF (2047). */
-    g_tx_dataframe.id		=	g_tx_id_default;
-    g_tx_dataframe.dlc		=	8;
-    g_tx_dataframe.data[0]	=	0x00;
-    g_tx_dataframe.data[1]	=	0x11;
-    g_tx_dataframe.data[2]	=	0x22;
-    g_tx_dataframe.data[3]	=	0x33;
-    g_tx_dataframe.data[4]	=	0x44;
+    if (p_frame->data[2] == 'R') // fuel check
+    {
+        lcd_display(LCD_LINE5, "Fuel high");
+        LED10 = LED_ON;
+        LED8 = LED_OFF;
+    }
+    else
+    {
+        lcd_display(LCD_LINE5, "Fuel low");
+        LED8 = LED_ON;
+        LED10 = LED_OFF;
+    }
+
+    if (p_frame->data[3] == 'R') // traction check 
+    {
+        lcd_display(LCD_LINE6, "Tract high");
+        LED14 = LED_ON;
+        LED12 = LED_OFF;
+    }
+    else
+    {
+        lcd_display(LCD_LINE6, "Tract low");
+        LED12 = LED_ON;
+        LED14 = LED_OFF;
+    }
+
+    if (p_frame->data[4] > (28*28))
+    {
+        lcd_display(LCD_LINE7, "  Accident ");
+        LED15 = LED_ON;
+        LED13 = LED_OFF;
+    }
+    else
+    {
+        lcd_display(LCD_LINE7, "   ");
+        LED13 = LED_ON;
+        LED15 = LED_OFF;
+    }
+
+    if (p_frame->data[5] > 280)
+    {
+        lcd_display(LCD_LINE8, "High temp");
+        LED11 = LED_ON;
+        LED9 = LED_OFF;
+    }
+    else
+    {
+        lcd_display(LCD_LINE8, "Norm temp");
+        LED9 = LED_ON;
+        LED11 = LED_OFF;
+    }
+
+    /* Display error, if any. */
+    if (R_CAN_MSGLOST == status)
+    {
+        lcd_flash();
+    }
+}/* End function app_rx_display(). */
+
+#endif  /* USE_CAN_POLL == */
+
+
+/*****************************************************************************
+* Function name:    init_can_app
+* Description  : 	Initialize CAN demo application
+* Arguments    :    none
+* Return value : 	none
+*****************************************************************************/
+static uint32_t init_can_app(void)
+{	
+    uint32_t	api_status = R_CAN_OK;
+    uint32_t    i; /* Common loop index variable. */
+
+    can_state[0] = R_CAN_STATUS_ERROR_ACTIVE;
+
+    for (i = 0; i < MAX_CHANNELS; i++) /* Initialize status for all channels. */
+    {
+        error_bus_status[i] = R_CAN_STATUS_ERROR_ACTIVE;
+        error_bus_status_prev[i] = R_CAN_STATUS_ERROR_ACTIVE;            
+    }
+    
+    /* Configure mailboxes in Halt mode. */
+    api_status |= R_CAN_Control(g_can_channel, HALT_CANMODE);
+
+    /********	Init demo to recieve data	********/	
+    /* Use API to set one CAN mailbox for demo receive. */
+    /* Standard id. Choose value 0-0x07FF (2047). */
+    api_status |= app_id_t::rx_set(g_can_channel, CANBOX_RX, g_rx_id_default, DATA_FRAME);
+        
+    /* Mask for receive box. Write to mask only in Halt mode. */
+    /* ID_MASK_NONE = no mask. Clear bit 1, for example, and if receive ID is set 
+       to 1, both ID 1 and 3 should be received. */
+    R_CAN_RxSetMask( g_can_channel, CANBOX_RX, app_id_t::DEMO_RX_MASK);           
+
+    /********	Init. demo Tx dataframe RAM structure	********/	
+    /* Standard id. Choose value 0-0x07FF (2047). */
+    g_tx_dataframe.id		=	g_tx_id_default;
+    g_tx_dataframe.dlc		=	8;
+    g_tx_dataframe.data[0]	=	0x00;
+    g_tx_dataframe.data[1]	=	0x11;
+    g_tx_dataframe.data[2]	=	0x22;
+    g_tx_dataframe.data[3]	=	0x33;
+    g_tx_dataframe.data[4]	=	0x44;
     g_tx_dataframe.data[5]	=	0x55;
-    g_tx_dataframe.data[6]	=	0x66;
-    g_tx_dataframe.data[7]	=	0x77;
+    g_tx_dataframe.data[6]	=	0x00;                  /* Reserved. */
+    g_tx_dataframe.data[7]	=	STATUS_MUX_LEGACY;     /* Multiplexor. */
+
+    #if DEMO_J1939
+    /* J1939 mailboxes and masks. Address claim starts from the tick. */
+    api_status |= j1939_init();
+    #endif
+
+    #if (USE_CAN_POLL == 0)
+    /* Time sync mailboxes. Sync frames go out from the tick. */
+    api_status |= tsync_init();
+    #endif
+
+    #if (USE_CAN_POLL == 0) && DEMO_GATEWAY
+    /* Gateway mailboxes here, and the other channels in the route table. */
+    api_status |= gateway_init();
+    #endif
 
     /* API to send will be set up in SW1Func() in file switches.c. */
     api_status |= R_CAN_Control(g_can_channel, OPERATE_CANMODE);
@@ -867,22 +1457,30 @@ static uint32_t init_can_app(void)
 
     /* Length is specified by the remote request. */
     /* Stuff with some data.. */
+    g_remote_frame.dlc = 8;
     for (i = 0; i < 8; i++)
     {
         g_remote_frame.data[i] = i;
     }    
     
-    /* Prepare mailbox for Tx. */    	
-    if (FRAME_ID_MODE == STD_ID_MODE)
-    {
-        R_CAN_RxSet(g_can_channel, CANBOX_REMOTE_RX, REMOTE_TEST_ID, REMOTE_FRAME);
-    }
-    else
+    /* Register remote IDs in the responder table. The Rx ISR answers from it. 
+    Entry 0 must be the demo REMOTE_TEST_ID. */
+    if (0 != remote_resp_register(REMOTE_TEST_ID, CANBOX_REMOTE_RX, CANBOX_REMOTE_TX, &g_remote_frame))
     {
-        R_CAN_RxSetXid(g_can_channel, CANBOX_REMOTE_RX, REMOTE_TEST_ID, REMOTE_FRAME);        
+        app_err_nr |= APP_ERR_CAN_INIT;
     }
+
+    remote_status_idx = remote_resp_register(REMOTE_STATUS_ID, CANBOX_REMOTE_STATUS_RX, 
+                                             CANBOX_REMOTE_STATUS_TX, &g_tx_dataframe);
     /***********************************************************************/
 
+    #if (USE_CAN_POLL == 0)
+    /* Segmented transport for payloads larger than one frame, and the 
+    diagnostic server on top of it. */
+    api_status |= isotp_init(ISOTP_BLOCK_SIZE, ISOTP_ST_MIN);
+    uds_init();
+    #endif
+
     /* Set frame buffer id so LCD shows correct receive ID from start. */
     g_rx_dataframe.id = g_rx_id_default;
 
@@ -891,6 +1489,30 @@ static uint32_t init_can_app(void)
 } /* End function init_can_app(). */
 
 
+#if CAN_MIXED_ID_FRAMES
+/*****************************************************************************
+* Function name:    can_id_mode_mixed
+* Description  : 	Standard and extended frames on the same channel. IDFM
+*                   can only be written in CAN reset mode, so call this after
+*                   R_CAN_Create and before the port and the mailboxes are 
+*                   set up.
+* Arguments    :    ch_nr - 
+*                       Channel.
+* Return value : 	CAN API code. The channel is left in halt mode.
+*****************************************************************************/
+static uint32_t can_id_mode_mixed(uint32_t ch_nr)
+{
+    uint32_t    api_status;
+
+    api_status = R_CAN_Control(ch_nr, RESET_CANMODE);
+    CAN_CTLR(ch_nr).BIT.IDFM = CTLR_IDFM_MIXED;
+    api_status |= R_CAN_Control(ch_nr, HALT_CANMODE);
+
+    return api_status;
+} /* End function can_id_mode_mixed(). */
+#endif
+
+
 /*****************************************************************************
 * Function name:    check_can_errors
 * Description  : 	Check for all possible errors, in app and peripheral. Add 
@@ -977,6 +1599,13 @@ static void handle_can_bus_state(uint8_t ch_nr)
                         app_err_nr |= APP_ERR_CAN_PERIPH;
                     }
 
+                    /* Create set the rate and ID mode of the driver config
+                    again. */
+                    can_timing_restore(ch_nr);
+                    #if CAN_MIXED_ID_FRAMES
+                    can_id_mode_mixed(ch_nr);
+                    #endif
+
                     /* Restart CAN demos even if only one channel failed. */
                     init_can_app();
                 }
@@ -1027,15 +1656,9 @@ static void handle_can_bus_state(uint8_t ch_nr)
         send practically simultaneously. Let this be a lesson; sending the same 
         ID from two nodes onto the same bus at the same time is very hazardous
         as the arbitration cannot take place. Only use both lines below if 
-        CAN1 and CAN1 are on different buses. */
-        if (FRAME_ID_MODE == STD_ID_MODE )
-        {
-            R_CAN_TxSet(g_can_channel, CANBOX_TX, &err_tx_dataframe, DATA_FRAME);   
-        }
-        else
-        {
-            R_CAN_TxSetXid(g_can_channel, CANBOX_TX, &err_tx_dataframe, DATA_FRAME);
-        } 
+        CAN1 and CAN1 are on different buses. 
+        A flapping bus state is rate limited, see can_tx_limit.c. */
+        app_id_t::tx_set_limited(g_can_channel, CANBOX_TX, &err_tx_dataframe, DATA_FRAME);   
 
     }
 
@@ -1079,6 +1702,30 @@ uint32_t reset_all_errors(void)
 }/* End function reset_all_errors() */
 
 
+/*******************************************************************************
+* Function name:    get_can_err_info
+* Description  : 	Error counters and bus state of a channel, for diagnostics.
+* Arguments    :    ch_nr -
+*                       Channel number.
+*                   p_dest -
+*                       4 bytes: TEC, REC, bus status, number of times error
+*                       passive or bus off was reached.
+* Return value : 	none
+*******************************************************************************/
+void get_can_err_info(uint8_t ch_nr, uint8_t * p_dest)
+{
+    if (ch_nr >= MAX_CHANNELS)
+    {
+        ch_nr = CH_0;
+    }
+
+    p_dest[0] = CAN0.TECR;
+    p_dest[1] = CAN0.RECR;
+    p_dest[2] = (uint8_t)error_bus_status[ch_nr];
+    p_dest[3] = (uint8_t)nr_times_reached_busoff[ch_nr];
+}/* End function get_can_err_info() */
+
+
 /*******************************************************************************
 * Function name:    delay
 * Description  :    Demo delay
@@ -1131,24 +1778,62 @@ Vectors are set according to the channel.
 #pragma interrupt CAN0_TXM0_ISR(vect=VECT_CAN0_TXM0, enable) 
 void CAN0_TXM0_ISR(void)
 {
-    uint32_t api_status = R_CAN_OK;
+    uint8_t mssr;
+    uint8_t mbox_nr;
+    uint8_t msmr_save;
 
-    api_status = R_CAN_TxCheck(CH_0, CANBOX_TX);
+    PROBE_ENTER(PROBE_CAN_TX_ISR);
 
-    if (R_CAN_OK == api_status)
+    /* The search mode is shared with the Rx ISR, which may nest. */
+    msmr_save = CAN0.MSMR.BYTE;
+    CAN0.MSMR.BYTE = MSMR_TX_SEARCH;
+
+    /* Mailbox search reg. gives the lowest mailbox with SENTDATA set. Clearing 
+    SENTDATA moves the search on, so this costs one pass per sent mailbox 
+    instead of one probe per configured mailbox. */
+    for (mssr = CAN0.MSSR.BYTE; 0 == (mssr & MSSR_SEST); mssr = CAN0.MSSR.BYTE)
     {
-        CAN0_tx_sentdata_flag = 1;
-    }
+        mbox_nr = mssr & MSSR_MBNST;
 
-    api_status = R_CAN_TxCheck(CH_0, CANBOX_REMOTE_TX);
+        /* Clears SENTDATA. */
+        R_CAN_TxCheck(CH_0, mbox_nr);
+        can_nr_tx_frames++;
 
-    if (R_CAN_OK == api_status)
-    {
-        CAN0_tx_remote_sentdata_flag = 1;
+        switch (mbox_nr)
+        {
+            case CANBOX_TX:
+                CAN0_tx_sentdata_flag = 1;
+            break;
+
+            case CANBOX_REMOTE_TX:
+                CAN0_tx_remote_sentdata_flag = 1;
+            break;
+
+            /* ISO-TP feeds its next consecutive frame from here. */
+            case CANBOX_ISOTP_TX:
+            case CANBOX_ISOTP_FC:
+                isotp_tx_done(mbox_nr);
+            break;
+
+            /* Time sync needs the send time of its sync frame. */
+            case CANBOX_TSYNC_TX:
+                tsync_tx_done(rtc_timestamp_us());
+            break;
+
+            #if DEMO_GATEWAY
+            /* Load the next forwarded frame at once. */
+            case CANBOX_GW_TX:
+                gateway_tx_done(CH_0);
+            break;
+            #endif
+
+            default:
+            break;
+        }
     }
 
-    /* Use mailbox search reg. Should be faster than above if a lot of mailboxes to check. 
-    Not verified. */
+    CAN0.MSMR.BYTE = msmr_save;
+    PROBE_EXIT(PROBE_CAN_TX_ISR);
 }/* end CAN0_TXM0_ISR() */
 
 
@@ -1162,41 +1847,210 @@ void CAN0_TXM0_ISR(void)
 #pragma interrupt CAN0_RXM0_ISR(vect=VECT_CAN0_RXM0, enable)
 void CAN0_RXM0_ISR(void)
 {
-    /* Use CAN API. */
-    uint32_t api_status = R_CAN_OK;
-
-    api_status = R_CAN_RxPoll(CH_0, CANBOX_RX);
-
-    if (R_CAN_OK == api_status)
+    uint8_t         mssr;
+    uint8_t         mbox_nr;
+    uint8_t         msmr_save;
+    can_rx_slot_t * p_slot;
+
+    PROBE_ENTER(PROBE_CAN_RX_ISR);
+
+    /* The search mode is shared with the Tx ISR, which may nest. */
+    msmr_save = CAN0.MSMR.BYTE;
+    CAN0.MSMR.BYTE = MSMR_RX_SEARCH;
+
+    #if ISR_PROBES
+    /* Latency: CAN timestamp counter now against the stamp of the first 
+    frame waiting. Both count CAN bit times (TSPS = 0). */
+    mssr = CAN0.MSSR.BYTE;
+    if (0 == (mssr & MSSR_SEST))
     {
-        CAN0_rx_newdata_flag = 1;
+        PROBE_VALUE(PROBE_LAT_CAN_RX, (uint16_t)((uint16_t)(CAN0.TSR - CAN0.MB[mssr & MSSR_MBNST].TS) * 
+                                                  (PCLK_HZ / 8 / can_timing_bitrate(CH_0))));
     }
+    #endif
 
-    api_status = R_CAN_RxPoll(CH_0, CANBOX_REMOTE_RX);
-
-    if (R_CAN_OK == api_status)
+    /* Mailbox search reg. gives the lowest mailbox with NEWDATA set. Every
+    branch below clears NEWDATA, which moves the search on to the next one. */
+    for (mssr = CAN0.MSSR.BYTE; 0 == (mssr & MSSR_SEST); mssr = CAN0.MSSR.BYTE)
     {
-        /* REMOTE_FRAME FRAME REQUEST RECEIVED */
+        mbox_nr = mssr & MSSR_MBNST;
+        can_nr_rx_frames++;
+
+        /* REMOTE_FRAME FRAME REQUEST RECEIVED? Answer right here from the 
+        responder table. */
         /* Do not set BP on the next line to check for Remote frame. By the time you 
         continue, the recsucc flag will already have changed to be a trmsucc flag in 
         the CAN status reg. */
+        if (remote_resp_serve(mbox_nr))
+        {
+            if (CANBOX_REMOTE_RX == mbox_nr)
+            {
+                /* Set flag to inform application. */
+                CAN0_rx_g_remote_frame_flag = 1;
+            }
+            continue;
+        }
+
+        #if DEMO_J1939
+        /* J1939 network management, transport and subscribed PGNs. */
+        if (mbox_nr >= CANBOX_J1939_RX_NM)
+        {
+            can_frame_t j1939_frame;
+
+            R_CAN_RxRead(CH_0, mbox_nr, &j1939_frame);
+            j1939_rx_frame(&j1939_frame);
+            continue;
+        }
+        #endif
+
+        /* Time sync. Take the receive time first. */
+        if (CANBOX_TSYNC_RX == mbox_nr)
+        {
+            can_frame_t tsync_frame;
+            uint64_t    t_rx_us = rtc_timestamp_us();
 
-        /* Reset of the receive/transmit flag in the MCTL register will be done by 
-        set_remote_reply_std_CAN0(). */
+            R_CAN_RxRead(CH_0, mbox_nr, &tsync_frame);
+            tsync_rx_frame(&tsync_frame, t_rx_us);
+            continue;
+        }
 
-        /* Set flag to inform application. */
-        CAN0_rx_g_remote_frame_flag = 1;
+        #if DEMO_GATEWAY
+        /* Routed frames go straight to the Tx queue of their channel. */
+        if (CANBOX_GW_RX == mbox_nr)
+        {
+            gateway_rx(CH_0, mbox_nr);
+            continue;
+        }
+        #endif
 
-        g_remote_frame.dlc = (uint8_t)(CAN0.MB[CANBOX_REMOTE_RX].DLC);		
+        /* ISO-TP frames are handled here so flow control needs no main loop. */
+        if (CANBOX_ISOTP_RX == mbox_nr)
+        {
+            can_frame_t isotp_frame;
 
-        /* Reset NEWDATA flag since we won't be reading the mailbox. */
-        CAN0.MCTL[CANBOX_REMOTE_RX].BIT.RX.NEWDATA = 0;
-    }
+            R_CAN_RxRead(CH_0, mbox_nr, &isotp_frame);
+            isotp_rx_frame(&isotp_frame);
+            continue;
+        }
+
+        /* Data frame. Copy it to the receive ring, this also clears NEWDATA. */
+        p_slot = &can_rx_ring[can_rx_head & (CAN_RX_RING_SIZE - 1)];
 
-    /* Use mailbox search reg. Should be faster if a lot of mailboxes to check. */
+        if ((uint8_t)(can_rx_head - can_rx_tail) < CAN_RX_RING_SIZE)
+        {
+            p_slot->mbox = mbox_nr;
+            p_slot->status = (uint8_t)R_CAN_RxRead(CH_0, mbox_nr, &p_slot->frame);
+            can_rx_head++;
+            CAN0_rx_newdata_flag = 1;
+        }
+        else
+        {
+            /* Ring full. Drop the frame so the search can move on. */
+            CAN0.MCTL[mbox_nr].BIT.RX.NEWDATA = 0;
+            can_rx_nr_overflow++;
+        }
+    }
 
+    CAN0.MSMR.BYTE = msmr_save;
+    PROBE_EXIT(PROBE_CAN_RX_ISR);
 }/* end CAN0_RXM0_ISR() */
 
+
+/*****************************************************************************
+* Function name:    can_rx_borrow
+* Description  :    The oldest frame in the receive ring filled by 
+*                   CAN0_RXM0_ISR, in place. The slot stays counted as full, 
+*                   so the ISR does not reuse it until can_rx_release. This 
+*                   replaces copying the frame out with R_CAN_RxRead.
+* Arguments    :    none
+* Return value :    The slot, or NULL if the ring is empty.
+*****************************************************************************/
+const can_rx_slot_t * can_rx_borrow(void)
+{
+    if (can_rx_head == can_rx_tail)
+    {
+        return NULL;
+    }
+
+    return &can_rx_ring[can_rx_tail & (CAN_RX_RING_SIZE - 1)];
+}/* end can_rx_borrow() */
+
+
+/*****************************************************************************
+* Function name:    can_rx_release
+* Description  :    Give the slot from can_rx_borrow back to the ISR. The 
+*                   borrowed pointer must not be used after this.
+* Arguments    :    none
+* Return value :    none
+*****************************************************************************/
+void can_rx_release(void)
+{
+    if (can_rx_head != can_rx_tail)
+    {
+        can_rx_tail++;
+    }
+}/* end can_rx_release() */
+
+
+/*****************************************************************************
+* Function name:    can_rx_consumer_add
+* Description  :    Register a consumer for the frames of the receive ring.
+*                   Consumers are called in the order added. Adding one that
+*                   is registered already does nothing, so startup code that
+*                   runs again may call this each pass.
+* Arguments    :    consumer -
+*                       Called with each frame. Must not keep the pointer.
+* Return value :    false if the table is full.
+*****************************************************************************/
+bool can_rx_consumer_add(can_rx_consumer_t consumer)
+{
+    uint8_t     i;
+
+    for (i = 0; i < can_rx_nr_consumers; i++)
+    {
+        if (can_rx_consumers[i] == consumer)
+        {
+            return true;
+        }
+    }
+
+    if (can_rx_nr_consumers >= CAN_RX_MAX_CONSUMERS)
+    {
+        return false;
+    }
+
+    can_rx_consumers[can_rx_nr_consumers++] = consumer;
+    return true;
+}/* end can_rx_consumer_add() */
+
+
+/*****************************************************************************
+* Function name:    can_rx_dispatch
+* Description  :    Hand the oldest frame in the receive ring to every 
+*                   consumer, then release it. No copies are made.
+* Arguments    :    none
+* Return value :    true if more frames are waiting.
+*****************************************************************************/
+bool can_rx_dispatch(void)
+{
+    const can_rx_slot_t *   p_slot;
+    uint8_t                 i;
+
+    p_slot = can_rx_borrow();
+    if (NULL == p_slot)
+    {
+        return false;
+    }
+
+    for (i = 0; i < can_rx_nr_consumers; i++)
+    {
+        can_rx_consumers[i](&p_slot->frame, p_slot->status);
+    }
+    can_rx_release();
+
+    return (can_rx_head != can_rx_tail);
+}/* end can_rx_dispatch() */
+
 /*****************************************************************************
 * Function name:    CAN_ERS_ISR
 * Description  :    CAN Group Error interrupt.
@@ -1207,6 +2061,8 @@ void CAN0_RXM0_ISR(void)
 #pragma interrupt	CAN_ERS_ISR(vect=VECT_ICU_GROUPE0, enable)
 void CAN_ERS_ISR(void)
 {
+    PROBE_ENTER(PROBE_CAN_ERS_ISR);
+
     /* Error interrupt can have multiple sources. Check interrupt flags to id source. */
     if (IS(CAN0, ERS0))
     {
@@ -1224,6 +2080,7 @@ void CAN_ERS_ISR(void)
     }
 
     nop();
+    PROBE_EXIT(PROBE_CAN_ERS_ISR);
 }/* end CAN_ERS0_ISR() */
 
 #endif /* USE_CAN_POLL == 0 */
@@ -1239,19 +2096,22 @@ void CAN_ERS_ISR(void)
 *****************************************************************************/
 void RTC_display(void)
 {
- 	volatile uint8_t dummy;
     char date_d[13],time_d[13];
-    size_t size;	
-    time.second = RTC.RSECCNT.BYTE;         /* Read the BCD-code second */
-    time.minute = RTC.RMINCNT.BYTE;         /* Read the BCD-code minute */
-    time.hour = RTC.RHRCNT.BYTE;            /* Read the BCD-coded hour */
-    time.dayweek = RTC.RWKCNT.BYTE;         /* Read the day of the week */
-    time.day = RTC.RDAYCNT.BYTE;            /* Read the BCD-coded day */
-    time.month = RTC.RMONCNT.BYTE;          /* Read the BCD-coded month */
-    time.year = 0x2000 | RTC.RYRCNT.WORD;   /* Read the BCD-coded year */
-/* Sending entire string to hyperterminal*/
-	sprintf(date_d,"D:%x-%0.2x-%0.2x",time.year,time.month,time.day);	
-	sprintf(time_d,"T:%0.2x:%0.2x:%0.2x",time.hour,time.minute,time.second);
+
+    /* The RTC interrupt renders the strings once a second. Only redraw then. */
+    if (0 == g_rtc_text_changed)
+    {
+        return;
+    }
+
+    /* Copy again if a new second came in meanwhile. */
+    do
+    {
+        g_rtc_text_changed = 0;
+        memcpy(date_d, g_rtc_date_text, sizeof(date_d));
+        memcpy(time_d, g_rtc_time_text, sizeof(time_d));
+    } while (g_rtc_text_changed);
+
 	lcd_display(LCD_LINE1,date_d);
 	lcd_display(LCD_LINE2,time_d);
 }
@@ -1290,24 +2150,44 @@ Includes   <System Includes> , "Project Includes"
 /*******************************************************************************
 Macro definitions
 *******************************************************************************/
-#define ACCELEROMETER_DEBUG
-void accel(char);
-/*******************************************************************************
-Local global variables
-*******************************************************************************/
+#define ACCELEROMETER_DEBUG
+void accel(char);
+
+/* Background check of a stored calibration. */
+#define ACCEL_CAL_CHECK_SAMPLES 8       /* Same average as the boot calibration. */
+#define ACCEL_CAL_TOLERANCE     3       /* Zero drift to accept, LSB. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
 static volatile int16_t g_accel_x_zero;
 static volatile int16_t g_accel_y_zero;
 static volatile int16_t g_accel_z_zero;
 static volatile int16_t g_accel_x;
-static volatile int16_t g_accel_y;
-static volatile int16_t g_accel_z;
+static volatile int16_t g_accel_y;
+static volatile int16_t g_accel_z;
+
+/* Self-test result and the normalized self-test readings. */
+bool                    g_accel_selftest_ok;
+static int16_t          accel_selftest_xyz[3];
+
+/* Calibration check. accelerometer_demo_update collects the samples, 
+accel_cal_check_poll judges them. left 0 and not ready: idle. */
+static volatile uint8_t accel_cal_check_left;
+static volatile bool    accel_cal_check_ready;
+static volatile bool    accel_selftest_busy;    /* Main loop owns the sensor. */
+static int32_t          accel_cal_check_sum[3];
+static int16_t          accel_cal_check_min[3];
+static int16_t          accel_cal_check_max[3];
 
 
 /*******************************************************************************
 * Local Function Prototypes
 *******************************************************************************/
-static int16_t  accel_axis_read(uint8_t);
+static int16_t  accel_axis_read(uint8_t);
 static bool   accel_selftest( void );
+static void     accel_cal_check_sample(void);
+static void     accel_cal_save_current(void);
 static riic_ret_t accelerometer_write (uint8_t riic_channel,
                                 uint8_t slave_addr,
                                 uint8_t register_number, 
@@ -1412,9 +2292,17 @@ static riic_ret_t accelerometer_read (uint8_t riic_channel,
 *******************************************************************************/
 riic_ret_t accelerometer_init(void)
 {
-    bool            err = true;    /* Declare error flag */
+    bool            err = true;    /* Declare error flag */
     uint8_t         target_data; 
-    riic_ret_t      ret;
+    riic_ret_t      ret = RIIC_OK;
+    int16_t         zero[3];
+    static bool     init_done = false;
+
+    /* Already done by the boot sequencer? */
+    if (init_done)
+    {
+        return RIIC_OK;
+    }
 
     /* Read the DEVID register to verify the presence of the accelerometer device. */    
     ret |= accelerometer_read(RIIC_CHANNEL, ADXL345_ADDR, ADXL345_ID_REG, &target_data, 1);
@@ -1436,24 +2324,40 @@ riic_ret_t accelerometer_init(void)
     target_data = 8; /* Measure bit. */
     ret |= accelerometer_write(RIIC_CHANNEL, ADXL345_ADDR, ADXL345_POWER_CTL_REG, &target_data, 1);                                   
 
-    /* Get baseline readings to calibrate accelerometer. */
-    g_accel_x_zero = 0;
-    g_accel_y_zero = 0;
-    g_accel_z_zero = 0;
-
-    for (uint8_t i = 0; i < 8; i++)
+    /* Stored calibration? Then skip the averaging and the self-test, and have
+    accel_cal_check_poll check it in the background. */
+    if (accel_cal_load(zero, accel_selftest_xyz, &g_accel_selftest_ok))
     {
-        g_accel_x_zero += accel_axis_read(0x32);
-        g_accel_y_zero += accel_axis_read(0x34);
-        g_accel_z_zero += accel_axis_read(0x36);            
+        g_accel_x_zero = zero[0];
+        g_accel_y_zero = zero[1];
+        g_accel_z_zero = zero[2];
+        accel_cal_check_left = ACCEL_CAL_CHECK_SAMPLES;
     }
+    else
+    {
+        /* Get baseline readings to calibrate accelerometer. */
+        g_accel_x_zero = 0;
+        g_accel_y_zero = 0;
+        g_accel_z_zero = 0;
+
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            g_accel_x_zero += accel_axis_read(0x32);
+            g_accel_y_zero += accel_axis_read(0x34);
+            g_accel_z_zero += accel_axis_read(0x36);            
+        }
 
-    /* Determine the average reading. */
-    g_accel_x_zero = g_accel_x_zero / 8;
-    g_accel_y_zero = g_accel_y_zero / 8;
-    g_accel_z_zero = g_accel_z_zero / 8;
-    /* Run self test to see if the accelerometer is working. */
-    err &= accel_selftest();
+        /* Determine the average reading. */
+        g_accel_x_zero = g_accel_x_zero / 8;
+        g_accel_y_zero = g_accel_y_zero / 8;
+        g_accel_z_zero = g_accel_z_zero / 8;
+        /* Run self test to see if the accelerometer is working. */
+        err &= accel_selftest();
+        g_accel_selftest_ok = err;
+
+        /* Written from the main loop. */
+        accel_cal_save_current();
+    }
 
     /* Activate accelerometer X, Y Z to detect activity. */
     target_data = 0x70;    
@@ -1461,8 +2365,9 @@ riic_ret_t accelerometer_init(void)
 
     //LED4 = LED5 = LED6 = LED7 = LED8 = LED9 = LED10 = LED11 = LED12 = LED13 = LED14 = LED15 = LED_OFF;
 
-    return ret;
-} /* End of function accelerometer_init(). */
+    init_done = (RIIC_OK == ret);
+    return ret;
+} /* End of function accelerometer_init(). */
 
 
 /******************************************************************************
@@ -1485,12 +2390,32 @@ void accelerometer_demo_update(void)
 
     int16_t adjusted_x;
     int16_t adjusted_y;
-  
-    int16_t slope = 0;
-
-    g_accel_x = accel_axis_read(ADXL345_DATAX0_REG);
-    g_accel_y = accel_axis_read(ADXL345_DATAY0_REG);
-    g_accel_z = accel_axis_read(ADXL345_DATAZ0_REG);        
+    int16_t xyz[3];
+  
+    int16_t slope = 0;
+
+    /* Self-test running from the main loop: the sensor is in self-test mode
+    and the I2C bus is in use. Skip this period. */
+    if (accel_selftest_busy)
+    {
+        return;
+    }
+
+    g_accel_x = accel_axis_read(ADXL345_DATAX0_REG);
+    g_accel_y = accel_axis_read(ADXL345_DATAY0_REG);
+    g_accel_z = accel_axis_read(ADXL345_DATAZ0_REG);        
+
+    /* Stored calibration not yet confirmed? */
+    if (accel_cal_check_left != 0)
+    {
+        accel_cal_check_sample();
+    }
+
+    #if DEMO_ACCEL_STREAM
+    /* Every sample goes to the CAN stream, see can_accel_stream.c. */
+    accel_get_xyz(xyz);
+    accel_stream_put(xyz);
+    #endif
 
     adjusted_x = g_accel_x - g_accel_x_zero;
     adjusted_y = g_accel_y - g_accel_y_zero;
@@ -1554,12 +2479,14 @@ void accelerometer_demo_update(void)
 *                       false - 
 *                           fail
 *******************************************************************************/
-static bool  accel_selftest( void )
+static bool  accel_selftest( void )
 {
     uint8_t     target_data;
-    riic_ret_t  ret;           
-    bool        err = true;
- 
+    riic_ret_t  ret = RIIC_OK;
+    bool        err = true;
+    int32_t     sum[3] = {0, 0, 0};
+    int16_t     st[3];
+ 
     /* Set up the accelerometer data format register. */    
     target_data = 0x83;  /* Set the data format range bits to +/- 16g, and selftest mode bit. */
     ret |= accelerometer_write(RIIC_CHANNEL, ADXL345_ADDR, ADXL345_DATA_FORMAT_REG, &target_data, 1);
@@ -1570,31 +2497,28 @@ static bool  accel_selftest( void )
         ; /* Spin loop delay. */
     }
 
-    g_accel_x = 0;
-    g_accel_y = 0;
-    g_accel_z = 0;
-
-    /* Take an average of 8 readings per axis to serve as basis for range check. */
-    for (uint16_t i = 0; i < 8; i++)
-    {
-        g_accel_x += accel_axis_read(ADXL345_DATAX0_REG);
-        g_accel_y += accel_axis_read(ADXL345_DATAY0_REG);
-        g_accel_z += accel_axis_read(ADXL345_DATAZ0_REG);        
-    }
-    /* Divide the 8 readings by 8 to obtain the average value. */
-    g_accel_x = g_accel_x / 8;
-    g_accel_y = g_accel_y / 8;
-    g_accel_z = g_accel_z / 8;
-
-    /* Normalize the self test values. */
-    g_accel_x = SCALE_X(g_accel_x) - g_accel_x_zero;
-    g_accel_y = SCALE_Y(g_accel_y) - g_accel_y_zero;
-    g_accel_z = SCALE_Z(g_accel_z) - g_accel_z_zero;
-
-    /* Range check self-test values. */
-    err &= ((g_accel_x >   6) && (g_accel_x < 67))  ? true : false;
-    err &= ((g_accel_y > -67) && (g_accel_y < -6))  ? true : false;
-    err &= ((g_accel_z >  10) && (g_accel_z < 110)) ? true : false;
+    /* Take an average of 8 readings per axis to serve as basis for range check. 
+    Locals only: g_accel_x/y/z are the live readings. */
+    for (uint16_t i = 0; i < 8; i++)
+    {
+        sum[0] += accel_axis_read(ADXL345_DATAX0_REG);
+        sum[1] += accel_axis_read(ADXL345_DATAY0_REG);
+        sum[2] += accel_axis_read(ADXL345_DATAZ0_REG);        
+    }
+
+    /* Divide the 8 readings by 8 and normalize the self test values. */
+    st[0] = (int16_t)(SCALE_X((int16_t)(sum[0] / 8)) - g_accel_x_zero);
+    st[1] = (int16_t)(SCALE_Y((int16_t)(sum[1] / 8)) - g_accel_y_zero);
+    st[2] = (int16_t)(SCALE_Z((int16_t)(sum[2] / 8)) - g_accel_z_zero);
+
+    accel_selftest_xyz[0] = st[0];
+    accel_selftest_xyz[1] = st[1];
+    accel_selftest_xyz[2] = st[2];
+
+    /* Range check self-test values. */
+    err &= ((st[0] >   6) && (st[0] < 67))  ? true : false;
+    err &= ((st[1] > -67) && (st[1] < -6))  ? true : false;
+    err &= ((st[2] >  10) && (st[2] < 110)) ? true : false;
 
     /* Turn off self test mode. */                          
     target_data = 0x03;  /* Set the data format range bits to +/- 16g, and clear selftest mode bit. */
@@ -1606,18 +2530,143 @@ static bool  accel_selftest( void )
     }                             
     return err;                                 
 } /* End of function accel_selftest(). */
-
-
-/******************************************************************************
-* Function name: accel_axis_read
-* Description  : This function reads the accelerometer's X, Y or Z axis. 
-* Argument     : uint8_t    axis -
-*                   Which axis register to be read.
-* Return value : short value of axis
-*******************************************************************************/
-static int16_t  accel_axis_read (uint8_t axis)
-{
-    int16_t    axis_val;    /* 16-bit storage for the x, y, or z axis data. */
+
+
+/*******************************************************************************
+* Function name: accel_cal_check_sample
+* Description  : Collect the next ACCEL_CAL_CHECK_SAMPLES readings for the 
+*                check of a calibration loaded from data flash, then hand 
+*                them to accel_cal_check_poll. Called from 
+*                accelerometer_demo_update, in the CMT callback, with a 
+*                fresh reading.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void accel_cal_check_sample(void)
+{
+    int16_t     sample[3];
+    uint8_t     axis;
+
+    sample[0] = g_accel_x;
+    sample[1] = g_accel_y;
+    sample[2] = g_accel_z;
+
+    for (axis = 0; axis < 3; axis++)
+    {
+        if (ACCEL_CAL_CHECK_SAMPLES == accel_cal_check_left)
+        {
+            accel_cal_check_sum[axis] = 0;
+            accel_cal_check_min[axis] = sample[axis];
+            accel_cal_check_max[axis] = sample[axis];
+        }
+        accel_cal_check_sum[axis] += sample[axis];
+        if (sample[axis] < accel_cal_check_min[axis])
+        {
+            accel_cal_check_min[axis] = sample[axis];
+        }
+        if (sample[axis] > accel_cal_check_max[axis])
+        {
+            accel_cal_check_max[axis] = sample[axis];
+        }
+    }
+
+    if (0 == --accel_cal_check_left)
+    {
+        accel_cal_check_ready = true;
+    }
+} /* End of function accel_cal_check_sample(). */
+
+
+/*******************************************************************************
+* Function name: accel_cal_check_poll
+* Description  : Background check of a calibration loaded from data flash. 
+*                Averages the samples from accel_cal_check_sample like the 
+*                boot calibration did, and takes the new zero if it moved by 
+*                more than ACCEL_CAL_TOLERANCE. A window in which the board 
+*                moved is discarded and started again. Then runs the deferred
+*                self-test, with the CMT callback kept off the sensor. A 
+*                changed result is saved to data flash. Called from the main
+*                loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void accel_cal_check_poll(void)
+{
+    int16_t     zero[3];
+    int16_t     mean;
+    bool        changed = false;
+    bool        selftest_ok;
+    uint8_t     axis;
+
+    /* The callback does not touch the window while ready is set. */
+    if (!accel_cal_check_ready)
+    {
+        return;
+    }
+    accel_cal_check_ready = false;
+
+    zero[0] = g_accel_x_zero;
+    zero[1] = g_accel_y_zero;
+    zero[2] = g_accel_z_zero;
+
+    for (axis = 0; axis < 3; axis++)
+    {
+        /* Not at rest. Try again. */
+        if (accel_cal_check_max[axis] - accel_cal_check_min[axis] > 2 * ACCEL_CAL_TOLERANCE)
+        {
+            accel_cal_check_left = ACCEL_CAL_CHECK_SAMPLES;
+            return;
+        }
+
+        mean = (int16_t)(accel_cal_check_sum[axis] / ACCEL_CAL_CHECK_SAMPLES);
+        if ((mean - zero[axis] > ACCEL_CAL_TOLERANCE) || (zero[axis] - mean > ACCEL_CAL_TOLERANCE))
+        {
+            zero[axis] = mean;
+            changed = true;
+        }
+    }
+
+    g_accel_x_zero = zero[0];
+    g_accel_y_zero = zero[1];
+    g_accel_z_zero = zero[2];
+
+    accel_selftest_busy = true;
+    selftest_ok = accel_selftest();
+    accel_selftest_busy = false;
+    if (selftest_ok != g_accel_selftest_ok)
+    {
+        g_accel_selftest_ok = selftest_ok;
+        changed = true;
+    }
+
+    if (changed)
+    {
+        accel_cal_save_current();
+    }
+} /* End of function accel_cal_check_poll(). */
+
+
+static void accel_cal_save_current(void)
+{
+    int16_t zero[3];
+
+    zero[0] = g_accel_x_zero;
+    zero[1] = g_accel_y_zero;
+    zero[2] = g_accel_z_zero;
+    accel_cal_save(zero, accel_selftest_xyz, g_accel_selftest_ok);
+}
+
+
+/******************************************************************************
+* Function name: accel_axis_read
+* Description  : This function reads the accelerometer's X, Y or Z axis. 
+* Argument     : uint8_t    axis -
+*                   Which axis register to be read.
+* Return value : short value of axis
+*******************************************************************************/
+static int16_t  accel_axis_read (uint8_t axis)
+{
+    int16_t    axis_val;    /* 16-bit storage for the x, y, or z axis data. */
     uint8_t    accel_reg;   /* Storage for the accelerometer register parameter. */
     uint8_t    accel_data[2];
     riic_ret_t ret;         /* Result code from the RIIC API functions. */
@@ -1637,6 +2686,22 @@ static int16_t  accel_axis_read (uint8_t axis)
 
     return axis_val;
 } /* End of function accel_axis_read(). */
+
+
+/******************************************************************************
+* Function name: accel_get_xyz
+* Description  : Latest calibrated X, Y and Z readings, as updated by 
+*                accelerometer_demo_update.
+* Argument     : int16_t *  p_xyz -
+*                   Room for 3 values.
+* Return value : none
+*******************************************************************************/
+void accel_get_xyz(int16_t * p_xyz)
+{
+    p_xyz[0] = g_accel_x - g_accel_x_zero;
+    p_xyz[1] = g_accel_y - g_accel_y_zero;
+    p_xyz[2] = g_accel_z - g_accel_z_zero;
+} /* End of function accel_get_xyz(). */
 
 
 
@@ -1685,6 +2750,13 @@ riic_ret_t thermal_sensor_init(void)
     uint8_t     target_data;
     uint8_t     addr_and_register[2]; /* Storage for the slave address and target register. */
     riic_ret_t  ret = RIIC_OK;
+    static bool init_done = false;
+
+    /* Already done by the boot sequencer? */
+    if (init_done)
+    {
+        return RIIC_OK;
+    }
 
     /* To write to a specific register in the thermal sensor, first transmit its 
        I2C slave address together with the register number. */
@@ -1706,8 +2778,9 @@ riic_ret_t thermal_sensor_init(void)
         ret |= R_RIIC_MasterTransmit(CHANNEL_0, &target_data, 1);   
     }
     
-    return ret;                  
-} /* End of function thermal_sensor_init()  */
+    init_done = (RIIC_OK == ret);
+    return ret;                  
+} /* End of function thermal_sensor_init()  */
 
 
 /*******************************************************************************
@@ -1783,9 +2856,8 @@ int16_t thermal_sensor_read(void)
 * Argument     : none
 * Return value : none
 *******************************************************************************/
-void temperature_display(void)
-{
-	int temperature;
+void temperature_display(void)
+{
 	uint8_t	i;
     
 	/* The output display string buffer. */
@@ -1793,6 +2865,7 @@ void temperature_display(void)
 
     /* Read the temperature */
 	temperature = thermal_sensor_read();
+	status_mux_note_temperature((int16_t)temperature);
 	//printf("temp= %d", temperature);
  	/*if(temperature>280)
 	{
@@ -1821,11 +2894,13 @@ void temperature_display(void)
 
 void static cmt_callback(void)
 {
+    PROBE_ENTER(PROBE_CMT_CALLBACK);
     accelerometer_demo_update();
     if (g_thermal_sensor_good) /* Only run thermal sensor demo if it is present. */
     {
         temperature_display();
     }
+    PROBE_EXIT(PROBE_CMT_CALLBACK);
 }
 
 
@@ -1835,3 +2910,6799 @@ void static cmt_callback(void)
 
 
 
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_remote_resp.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Remote frame responder table. Each remote request CAN-ID is
+*                 bound to a pre-packed response which the CAN Rx ISR sends
+*                 directly, without waiting for the main loop. Both mailboxes
+*                 are on g_can_channel.
+*                 Responses are double buffered. The application writes the
+*                 inactive buffer and then flips the active index with a single
+*                 byte store, so the ISR never sees a half updated frame.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define NR_CAN_MAILBOXES        32
+#define REMOTE_RESP_NONE        (-1)
+
+#define RESP_REG(ch, reg)       (*((CH_0 == (ch)) ? &CAN0.reg : \
+                                   (CH_1 == (ch)) ? &CAN1.reg : &CAN2.reg))
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef struct
+{
+    uint32_t            id;         /* Remote request CAN-ID. */
+    uint8_t             rx_mbox;    /* Mailbox set to receive the request. */
+    uint8_t             tx_mbox;    /* Mailbox used to send the response. */
+    volatile uint8_t    active;     /* Index of the buffer the ISR answers from. */
+    can_frame_t         frame[2];   /* Double buffered response frames. */
+    volatile uint32_t   nr_served;  /* Number of requests answered. */
+} remote_resp_t;
+
+static remote_resp_t    remote_resp_tbl[REMOTE_RESP_MAX_IDS];
+static uint8_t          remote_resp_nr;
+
+/* Rx mailbox number to table index + 1 lookup, used by the ISR. 
+0 = mailbox not in the table. */
+static uint8_t          remote_resp_by_mbox[NR_CAN_MAILBOXES];
+
+
+/*******************************************************************************
+* Function name: remote_resp_register
+* Description  : Bind a remote request CAN-ID to a response. Sets the Rx mailbox
+*                to receive remote frames for the ID. Registering an ID again 
+*                only refreshes its mailboxes and response data.
+* Arguments    : id -
+*                   Remote request CAN-ID.
+*                rx_mbox, tx_mbox -
+*                   Mailboxes for the request and the response.
+*                p_frame -
+*                   Initial response data. The id field is ignored.
+* Return value : Table index, or REMOTE_RESP_NONE if the table is full or a
+*                mailbox is out of range.
+*******************************************************************************/
+int8_t remote_resp_register(uint32_t id, uint8_t rx_mbox, uint8_t tx_mbox, const can_frame_t * p_frame)
+{
+    remote_resp_t * p_entry;
+    int8_t          idx;
+
+    if ((rx_mbox >= NR_CAN_MAILBOXES) || (tx_mbox >= NR_CAN_MAILBOXES))
+    {
+        return REMOTE_RESP_NONE;
+    }
+
+    /* Already registered? */
+    for (idx = 0; idx < remote_resp_nr; idx++)
+    {
+        if (remote_resp_tbl[idx].id == id)
+        {
+            break;
+        }
+    }
+
+    p_entry = &remote_resp_tbl[idx];
+
+    if (idx < remote_resp_nr)
+    {
+        /* Unhook the entry from the ISR while it is being set up. */
+        remote_resp_by_mbox[p_entry->rx_mbox] = 0;
+    }
+    else if (remote_resp_nr < REMOTE_RESP_MAX_IDS)
+    {
+        remote_resp_nr++;
+    }
+    else
+    {
+        return REMOTE_RESP_NONE;
+    }
+
+    p_entry->id = id;
+    p_entry->rx_mbox = rx_mbox;
+    p_entry->tx_mbox = tx_mbox;
+    p_entry->active = 0;
+    p_entry->frame[0] = *p_frame;
+    p_entry->frame[0].id = id;
+    p_entry->frame[1] = p_entry->frame[0];
+
+    remote_resp_by_mbox[rx_mbox] = (uint8_t)(idx + 1);
+
+    app_id_t::rx_set(g_can_channel, rx_mbox, id, REMOTE_FRAME);
+
+    return idx;
+} /* End of function remote_resp_register(). */
+
+
+/*******************************************************************************
+* Function name: remote_resp_update
+* Description  : Replace the response data for a table entry. Writes the buffer
+*                the ISR is not using, then makes it active. Call from the main
+*                loop only.
+* Arguments    : idx -
+*                   Table index returned by remote_resp_register.
+*                p_data -
+*                   New response data.
+*                dlc -
+*                   Number of data bytes, 0-8.
+* Return value : none
+*******************************************************************************/
+void remote_resp_update(int8_t idx, const uint8_t * p_data, uint8_t dlc)
+{
+    remote_resp_t * p_entry;
+    uint8_t         next;
+
+    if ((idx < 0) || (idx >= remote_resp_nr) || (dlc > 8))
+    {
+        return;
+    }
+
+    p_entry = &remote_resp_tbl[idx];
+    next = p_entry->active ^ 1;
+
+    memcpy(p_entry->frame[next].data, p_data, dlc);
+    p_entry->frame[next].dlc = dlc;
+
+    /* Single byte store. From here on the ISR answers with the new data. */
+    p_entry->active = next;
+} /* End of function remote_resp_update(). */
+
+
+/*******************************************************************************
+* Function name: remote_resp_serve
+* Description  : Answer a remote request received in a mailbox. Called from the
+*                CAN Rx ISR. The response length is taken from the request.
+*                R_CAN_TxSet is safe here: it only writes the registers of 
+*                tx_mbox, which nothing outside this table uses, and its wait
+*                for the mailbox to go idle is bounded by the driver's 
+*                software timer. tx_set charges the bus load budget with 
+*                interrupts masked.
+* Arguments    : mbox_nr -
+*                   Mailbox which received a remote frame.
+* Return value : 1 if the mailbox belongs to the responder table, else 0.
+*******************************************************************************/
+uint8_t remote_resp_serve(uint8_t mbox_nr)
+{
+    remote_resp_t * p_entry;
+    can_frame_t     response;
+    uint8_t         idx;
+
+    idx = remote_resp_by_mbox[mbox_nr & (NR_CAN_MAILBOXES - 1)];
+
+    if (0 == idx)
+    {
+        return 0;
+    }
+
+    p_entry = &remote_resp_tbl[idx - 1];
+    response = p_entry->frame[p_entry->active];
+
+    /* Length is specified by the remote request. */
+    response.dlc = (uint8_t)RESP_REG(g_can_channel, MB[mbox_nr].DLC);
+    if (response.dlc > 8)
+    {
+        response.dlc = 8;
+    }
+
+    /* Reset NEWDATA flag since we won't be reading the mailbox. */
+    RESP_REG(g_can_channel, MCTL[mbox_nr]).BIT.RX.NEWDATA = 0;
+
+    app_id_t::tx_set(g_can_channel, p_entry->tx_mbox, &response, DATA_FRAME);   
+
+    p_entry->nr_served++;
+
+    return 1;
+} /* End of function remote_resp_serve(). */
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_bench.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Free running benchmark timer and the CAN mailbox scan 
+*                 benchmark. The timer is CMT1 counting PCLK/8, no interrupt.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define BENCH_TIMER_CKS_PCLK_8  0x0000  /* CMCR.CKS: PCLK/8. */
+#define BENCH_TIMER_CMCR_RSVD   0x0080  /* CMCR bit 7 must be written as 1. */
+#define BENCH_SCAN_REPEAT       64      /* Scans per measurement. */
+#define BENCH_SCAN_ID           0x5A5
+
+
+/*******************************************************************************
+* Function name: bench_timer_init
+* Description  : Start CMT1 as a free running 16-bit counter. CMCOR is set to
+*                its maximum so the compare match clear acts as a wrap.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void bench_timer_init(void)
+{
+    /* Protection off, release CMT1 from module stop, protection on. */
+    SYSTEM.PRCR.WORD = 0xA502;
+    MSTP(CMT1) = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    CMT.CMSTR0.BIT.STR1 = 0;
+    CMT1.CMCR.WORD = BENCH_TIMER_CMCR_RSVD | BENCH_TIMER_CKS_PCLK_8;
+    CMT1.CMCOR = 0xFFFF;
+    CMT1.CMCNT = 0;
+    CMT.CMSTR0.BIT.STR1 = 1;
+} /* End of function bench_timer_init(). */
+
+
+/*******************************************************************************
+* Function name: bench_timer_read
+* Description  : Current benchmark timer count. Take differences as uint16_t 
+*                to handle one wrap.
+* Argument     : none
+* Return value : Count in PCLK/8 ticks.
+*******************************************************************************/
+uint16_t bench_timer_read(void)
+{
+    return CMT1.CMCNT;
+} /* End of function bench_timer_read(). */
+
+
+#if DEMO_MBOX_SCAN_BENCH
+/*******************************************************************************
+* Function name: can_mbox_scan_benchmark
+* Description  : Compare the cost of finding a ready mailbox by probing each
+*                configured mailbox against the mailbox search function, with
+*                8, 16 and 32 active mailboxes. One frame is looped back into 
+*                the highest active mailbox, the worst case for probing. Scans 
+*                are non destructive so the same frame is found every time.
+*                Results go to the debug port.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void can_mbox_scan_benchmark(void)
+{
+    static const uint8_t    nr_active[] = {8, 16, 32};
+    can_frame_t             bench_frame;
+    uint16_t                t_start;
+    uint16_t                t_probe;
+    uint16_t                t_search;
+    uint8_t                 bench_mbox;
+    volatile uint8_t        found = 0;
+    uint8_t                 n;
+    uint8_t                 mbox_nr;
+    uint16_t                rep;
+
+    bench_timer_init();
+
+    /* Keep the Rx ISR from draining the bench mailbox. */
+    IEN(CAN0, RXM0) = 0;
+
+    bench_frame.id = BENCH_SCAN_ID;
+    bench_frame.dlc = 0;
+
+    for (n = 0; n < sizeof(nr_active); n++)
+    {
+        bench_mbox = nr_active[n] - 1;
+        if (CANBOX_TX == bench_mbox)
+        {
+            bench_mbox--;
+        }
+
+        R_CAN_Control(CH_0, HALT_CANMODE);
+        app_id_t::rx_set(CH_0, bench_mbox, BENCH_SCAN_ID, DATA_FRAME);
+        R_CAN_RxSetMask(CH_0, bench_mbox, app_id_t::ID_MASK_NONE);
+        R_CAN_Control(CH_0, OPERATE_CANMODE);
+
+        app_id_t::tx_set(CH_0, CANBOX_TX, &bench_frame, DATA_FRAME);
+        while (0 == CAN0.MCTL[bench_mbox].BIT.RX.NEWDATA)
+        {
+            /* Poll loop. Internal loopback, the frame comes back at once. */
+        }
+
+        /* Probe each active mailbox, as the ISRs used to do. */
+        t_start = bench_timer_read();
+        for (rep = 0; rep < BENCH_SCAN_REPEAT; rep++)
+        {
+            for (mbox_nr = 0; mbox_nr < nr_active[n]; mbox_nr++)
+            {
+                if (CAN0.MCTL[mbox_nr].BIT.RX.NEWDATA)
+                {
+                    found = mbox_nr;
+                }
+            }
+        }
+        t_probe = (uint16_t)(bench_timer_read() - t_start);
+
+        /* Mailbox search function. */
+        CAN0.MSMR.BYTE = MSMR_RX_SEARCH;
+        t_start = bench_timer_read();
+        for (rep = 0; rep < BENCH_SCAN_REPEAT; rep++)
+        {
+            mbox_nr = CAN0.MSSR.BYTE;
+            if (0 == (mbox_nr & MSSR_SEST))
+            {
+                found = mbox_nr & MSSR_MBNST;
+            }
+        }
+        t_search = (uint16_t)(bench_timer_read() - t_start);
+
+        printf("\nmbox scan %2u active: probe %5u search %5u ticks/%u scans",
+               nr_active[n], t_probe, t_search, BENCH_SCAN_REPEAT);
+
+        /* Release the bench mailbox. */
+        R_CAN_RxRead(CH_0, bench_mbox, &bench_frame);
+    }
+
+    IEN(CAN0, RXM0) = 1;
+
+    /* Put the demo mailboxes back. */
+    init_can_app();
+} /* End of function can_mbox_scan_benchmark(). */
+#endif /* DEMO_MBOX_SCAN_BENCH */
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_isotp.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : ISO-TP (ISO 15765-2) segmented transport on CAN0, normal 
+*                 11-bit addressing. Single, first, consecutive and flow control
+*                 frames, block size and STmin in both directions.
+*                 Everything after the first frame runs in interrupt context:
+*                 the Tx ISR loads the next consecutive frame when the previous
+*                 one has been sent, CMT2 times STmin and the flow control wait,
+*                 and the Rx ISR handles incoming flow control and segments.
+*                 Needs CAN interrupts (USE_CAN_POLL == 0).
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if (USE_CAN_POLL == 0)
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define ISOTP_MAX_LEN           4095    /* 12-bit first frame length. */
+#define ISOTP_RX_BUF_SIZE       256
+#define ISOTP_PAD_BYTE          0xCC
+
+/* Protocol control information, high nibble of byte 0. */
+#define ISOTP_PCI_SF            0x00
+#define ISOTP_PCI_FF            0x10
+#define ISOTP_PCI_CF            0x20
+#define ISOTP_PCI_FC            0x30
+
+/* Flow status. */
+#define ISOTP_FS_CTS            0x00
+#define ISOTP_FS_WAIT           0x01
+#define ISOTP_FS_OVFLW          0x02
+
+#define ISOTP_N_BS_MS           1000    /* Max. wait for flow control. */
+
+/* CMT2 counts PCLK/128. One timer period is at most ISOTP_TIMER_MAX_MS. */
+#define ISOTP_TIMER_CMCR        0x00C2  /* Bit 7 reserved 1, CMIE, CKS = PCLK/128. */
+#define ISOTP_TIMER_HZ          (PCLK_HZ / 128)
+#define ISOTP_TIMER_MAX_MS      100
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef enum
+{
+    ISOTP_TX_IDLE,
+    ISOTP_TX_WAIT_FC,       /* Waiting for flow control from the receiver. */
+    ISOTP_TX_SEND_CF,       /* Consecutive frame is in the mailbox. */
+    ISOTP_TX_WAIT_ST_MIN    /* Waiting out the receiver's STmin. */
+} isotp_tx_state_t;
+
+typedef struct
+{
+    volatile isotp_tx_state_t   state;
+    const uint8_t *             p_data;         /* Caller's buffer, not copied. */
+    uint16_t                    len;
+    uint16_t                    offset;         /* Next byte to send. */
+    uint8_t                     sn;             /* Next sequence number. */
+    uint8_t                     block_size;     /* From the receiver's FC. */
+    uint8_t                     block_left;
+    uint16_t                    st_min_ticks;   /* From the receiver's FC. */
+    int16_t                     wait_ms_left;
+    uint32_t                    nr_done;
+    uint32_t                    nr_aborted;
+} isotp_tx_t;
+
+typedef struct
+{
+    uint8_t                     buf[ISOTP_RX_BUF_SIZE];
+    uint16_t                    len;
+    uint16_t                    offset;
+    uint8_t                     sn;
+    uint8_t                     block_left;
+    uint8_t                     active;         /* Segmented reception ongoing. */
+    volatile uint8_t            done;           /* Message waiting for isotp_receive. */
+    uint32_t                    nr_errors;
+} isotp_rx_t;
+
+static isotp_tx_t   isotp_tx;
+static isotp_rx_t   isotp_rx;
+
+/* Flow control parameters we send as receiver. */
+static uint8_t      isotp_block_size;
+static uint8_t      isotp_st_min;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void     isotp_put(uint8_t mbox_nr, can_frame_t * p_frame);
+static void     isotp_send_cf(void);
+static void     isotp_send_fc(uint8_t flow_status);
+static void     isotp_rx_fc(const can_frame_t * p_frame);
+static uint16_t isotp_st_min_ticks(uint8_t st_min);
+static void     isotp_timer_start(uint16_t ticks);
+static void     isotp_timer_stop(void);
+
+
+/*******************************************************************************
+* Function name: isotp_init
+* Description  : Set up the ISO-TP receive mailbox and the CMT2 timer, and 
+*                reset both directions. The startup code calls it each pass;
+*                only the first call resets, so a transfer that spans a pass
+*                goes on, and later calls just set the mailbox up again.
+* Arguments    : block_size -
+*                   Block size sent in our flow control frames. 0 = the sender
+*                   needs no further flow control.
+*                st_min -
+*                   STmin sent in our flow control frames, ISO 15765-2 coding.
+* Return value : CAN API code
+*******************************************************************************/
+uint32_t isotp_init(uint8_t block_size, uint8_t st_min)
+{
+    uint32_t    api_status = R_CAN_OK;
+    static bool init_done = false;
+
+    if (init_done)
+    {
+        return diag_id_t::rx_set(CH_0, CANBOX_ISOTP_RX, ISOTP_RX_ID, DATA_FRAME);
+    }
+    init_done = true;
+
+    isotp_timer_stop();
+
+    memset(&isotp_tx, 0, sizeof(isotp_tx));
+    memset(&isotp_rx, 0, sizeof(isotp_rx));
+    isotp_block_size = block_size;
+    isotp_st_min = st_min;
+
+    /* Protection off, release CMT2 from module stop, protection on. */
+    SYSTEM.PRCR.WORD = 0xA502;
+    MSTP(CMT2) = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    CMT2.CMCR.WORD = ISOTP_TIMER_CMCR;
+    IPR(CMT2, CMI2) = CAN0_INT_LVL; /* Same level as CAN, so they never nest. */
+    IEN(CMT2, CMI2) = 1;
+
+    api_status |= diag_id_t::rx_set(CH_0, CANBOX_ISOTP_RX, ISOTP_RX_ID, DATA_FRAME);
+
+    return api_status;
+} /* End of function isotp_init(). */
+
+
+/*******************************************************************************
+* Function name: isotp_send
+* Description  : Start sending a message. Up to 7 bytes go in a single frame, 
+*                longer messages are segmented. The data is not copied; the 
+*                buffer must stay unchanged until isotp_tx_busy returns 0.
+* Arguments    : p_data -
+*                   Message to send.
+*                len -
+*                   Message length, 1 to ISOTP_MAX_LEN.
+* Return value : R_CAN_OK, or R_CAN_NOT_OK if busy or the length is invalid.
+*******************************************************************************/
+uint32_t isotp_send(const uint8_t * p_data, uint16_t len)
+{
+    can_frame_t frame;
+
+    if ((ISOTP_TX_IDLE != isotp_tx.state) || (0 == len) || (len > ISOTP_MAX_LEN))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    frame.id = ISOTP_TX_ID;
+    frame.dlc = 8;
+    memset(frame.data, ISOTP_PAD_BYTE, 8);
+
+    if (len <= 7)
+    {
+        frame.data[0] = ISOTP_PCI_SF | (uint8_t)len;
+        memcpy(&frame.data[1], p_data, len);
+        isotp_put(CANBOX_ISOTP_TX, &frame);
+        isotp_tx.nr_done++;
+        return R_CAN_OK;
+    }
+
+    isotp_tx.p_data = p_data;
+    isotp_tx.len = len;
+    isotp_tx.offset = 6;
+    isotp_tx.sn = 1;
+    isotp_tx.wait_ms_left = ISOTP_N_BS_MS;
+
+    /* Set state before sending; the flow control reply is handled by the ISR. */
+    isotp_tx.state = ISOTP_TX_WAIT_FC;
+    isotp_timer_start(ISOTP_TIMER_HZ / 1000 * ISOTP_TIMER_MAX_MS);
+
+    frame.data[0] = ISOTP_PCI_FF | (uint8_t)(len >> 8);
+    frame.data[1] = (uint8_t)len;
+    memcpy(&frame.data[2], p_data, 6);
+    isotp_put(CANBOX_ISOTP_TX, &frame);
+
+    return R_CAN_OK;
+} /* End of function isotp_send(). */
+
+
+/*******************************************************************************
+* Function name: isotp_tx_busy
+* Description  : Check whether a segmented transmission is still in progress.
+* Argument     : none
+* Return value : 1 if busy, else 0.
+*******************************************************************************/
+uint8_t isotp_tx_busy(void)
+{
+    return (ISOTP_TX_IDLE != isotp_tx.state) ? 1 : 0;
+} /* End of function isotp_tx_busy(). */
+
+
+/*******************************************************************************
+* Function name: isotp_receive
+* Description  : Fetch a completely received message, if any.
+* Arguments    : p_dest -
+*                   Where to copy the message.
+*                max_len -
+*                   Size of p_dest. Longer messages are truncated.
+* Return value : Message length, 0 if no message is waiting.
+*******************************************************************************/
+uint16_t isotp_receive(uint8_t * p_dest, uint16_t max_len)
+{
+    uint16_t len;
+
+    if (0 == isotp_rx.done)
+    {
+        return 0;
+    }
+
+    len = isotp_rx.len;
+    memcpy(p_dest, isotp_rx.buf, (len < max_len) ? len : max_len);
+
+    /* Release the buffer for the next message. */
+    isotp_rx.done = 0;
+
+    return len;
+} /* End of function isotp_receive(). */
+
+
+/*******************************************************************************
+* Function name: isotp_rx_frame
+* Description  : Handle a frame received on ISOTP_RX_ID. Called from the CAN0
+*                Rx ISR.
+* Argument     : p_frame -
+*                   Received frame.
+* Return value : none
+*******************************************************************************/
+void isotp_rx_frame(const can_frame_t * p_frame)
+{
+    uint16_t len;
+
+    switch (p_frame->data[0] & 0xF0)
+    {
+        case ISOTP_PCI_SF:
+            len = p_frame->data[0] & 0x0F;
+            if ((0 == len) || (len >= p_frame->dlc) || isotp_rx.done)
+            {
+                isotp_rx.nr_errors++;
+                break;
+            }
+            memcpy(isotp_rx.buf, &p_frame->data[1], len);
+            isotp_rx.len = len;
+            isotp_rx.active = 0;
+            isotp_rx.done = 1;
+        break;
+
+        case ISOTP_PCI_FF:
+            len = ((uint16_t)(p_frame->data[0] & 0x0F) << 8) | p_frame->data[1];
+            if ((len > ISOTP_RX_BUF_SIZE) || isotp_rx.done || (p_frame->dlc < 8))
+            {
+                isotp_rx.active = 0;
+                isotp_rx.nr_errors++;
+                isotp_send_fc(ISOTP_FS_OVFLW);
+                break;
+            }
+            memcpy(isotp_rx.buf, &p_frame->data[2], 6);
+            isotp_rx.len = len;
+            isotp_rx.offset = 6;
+            isotp_rx.sn = 1;
+            isotp_rx.block_left = isotp_block_size;
+            isotp_rx.active = 1;
+            isotp_send_fc(ISOTP_FS_CTS);
+        break;
+
+        case ISOTP_PCI_CF:
+            if (0 == isotp_rx.active)
+            {
+                break;
+            }
+            if ((p_frame->data[0] & 0x0F) != isotp_rx.sn)
+            {
+                /* Lost a segment. Drop the message. */
+                isotp_rx.active = 0;
+                isotp_rx.nr_errors++;
+                break;
+            }
+            len = isotp_rx.len - isotp_rx.offset;
+            if (len > 7)
+            {
+                len = 7;
+            }
+            memcpy(&isotp_rx.buf[isotp_rx.offset], &p_frame->data[1], len);
+            isotp_rx.offset += len;
+            isotp_rx.sn = (isotp_rx.sn + 1) & 0x0F;
+
+            if (isotp_rx.offset >= isotp_rx.len)
+            {
+                isotp_rx.active = 0;
+                isotp_rx.done = 1;
+            }
+            else if (isotp_block_size && (0 == --isotp_rx.block_left))
+            {
+                isotp_rx.block_left = isotp_block_size;
+                isotp_send_fc(ISOTP_FS_CTS);
+            }
+        break;
+
+        case ISOTP_PCI_FC:
+            isotp_rx_fc(p_frame);
+        break;
+
+        default:
+        break;
+    }
+} /* End of function isotp_rx_frame(). */
+
+
+/*******************************************************************************
+* Function name: isotp_tx_done
+* Description  : An ISO-TP mailbox finished sending. Called from the CAN0 Tx 
+*                ISR. Loads the next consecutive frame, or waits for STmin or 
+*                flow control as the receiver asked.
+* Argument     : mbox_nr -
+*                   Mailbox that sent.
+* Return value : none
+*******************************************************************************/
+void isotp_tx_done(uint8_t mbox_nr)
+{
+    if ((CANBOX_ISOTP_TX != mbox_nr) || (ISOTP_TX_SEND_CF != isotp_tx.state))
+    {
+        return;
+    }
+
+    if (isotp_tx.offset >= isotp_tx.len)
+    {
+        isotp_tx.state = ISOTP_TX_IDLE;
+        isotp_tx.nr_done++;
+    }
+    else if (isotp_tx.block_size && (0 == --isotp_tx.block_left))
+    {
+        isotp_tx.wait_ms_left = ISOTP_N_BS_MS;
+        isotp_tx.state = ISOTP_TX_WAIT_FC;
+        isotp_timer_start(ISOTP_TIMER_HZ / 1000 * ISOTP_TIMER_MAX_MS);
+    }
+    else if (isotp_tx.st_min_ticks)
+    {
+        isotp_tx.state = ISOTP_TX_WAIT_ST_MIN;
+        isotp_timer_start(isotp_tx.st_min_ticks);
+    }
+    else
+    {
+        isotp_send_cf();
+    }
+} /* End of function isotp_tx_done(). */
+
+
+/*******************************************************************************
+* Function name: isotp_rx_fc
+* Description  : Handle a flow control frame from the receiver of our message.
+* Argument     : p_frame -
+*                   Received flow control frame.
+* Return value : none
+*******************************************************************************/
+static void isotp_rx_fc(const can_frame_t * p_frame)
+{
+    if (ISOTP_TX_WAIT_FC != isotp_tx.state)
+    {
+        return;
+    }
+
+    switch (p_frame->data[0] & 0x0F)
+    {
+        case ISOTP_FS_CTS:
+            isotp_timer_stop();
+            isotp_tx.block_size = p_frame->data[1];
+            isotp_tx.block_left = p_frame->data[1];
+            isotp_tx.st_min_ticks = isotp_st_min_ticks(p_frame->data[2]);
+            isotp_tx.state = ISOTP_TX_SEND_CF;
+            isotp_send_cf();
+        break;
+
+        case ISOTP_FS_WAIT:
+            /* Receiver needs more time. Restart the wait. */
+            isotp_tx.wait_ms_left = ISOTP_N_BS_MS;
+        break;
+
+        case ISOTP_FS_OVFLW:
+        default:
+            isotp_timer_stop();
+            isotp_tx.state = ISOTP_TX_IDLE;
+            isotp_tx.nr_aborted++;
+        break;
+    }
+} /* End of function isotp_rx_fc(). */
+
+
+/*******************************************************************************
+* Function name: isotp_send_cf
+* Description  : Load the next consecutive frame into the Tx mailbox.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void isotp_send_cf(void)
+{
+    can_frame_t frame;
+    uint16_t    len;
+
+    len = isotp_tx.len - isotp_tx.offset;
+    if (len > 7)
+    {
+        len = 7;
+    }
+
+    frame.id = ISOTP_TX_ID;
+    frame.dlc = 8;
+    memset(frame.data, ISOTP_PAD_BYTE, 8);
+    frame.data[0] = ISOTP_PCI_CF | isotp_tx.sn;
+    memcpy(&frame.data[1], &isotp_tx.p_data[isotp_tx.offset], len);
+
+    isotp_tx.offset += len;
+    isotp_tx.sn = (isotp_tx.sn + 1) & 0x0F;
+    isotp_tx.state = ISOTP_TX_SEND_CF;
+
+    isotp_put(CANBOX_ISOTP_TX, &frame);
+} /* End of function isotp_send_cf(). */
+
+
+/*******************************************************************************
+* Function name: isotp_send_fc
+* Description  : Send a flow control frame with our block size and STmin.
+* Argument     : flow_status -
+*                   ISOTP_FS_CTS, ISOTP_FS_WAIT or ISOTP_FS_OVFLW.
+* Return value : none
+*******************************************************************************/
+static void isotp_send_fc(uint8_t flow_status)
+{
+    can_frame_t frame;
+
+    frame.id = ISOTP_TX_ID;
+    frame.dlc = 8;
+    memset(frame.data, ISOTP_PAD_BYTE, 8);
+    frame.data[0] = ISOTP_PCI_FC | flow_status;
+    frame.data[1] = isotp_block_size;
+    frame.data[2] = isotp_st_min;
+
+    isotp_put(CANBOX_ISOTP_FC, &frame);
+} /* End of function isotp_send_fc(). */
+
+
+/*******************************************************************************
+* Function name: isotp_put
+* Description  : Load a frame into a Tx mailbox and request transmission.
+* Arguments    : mbox_nr -
+*                   Tx mailbox.
+*                p_frame -
+*                   Frame to send.
+* Return value : none
+*******************************************************************************/
+static void isotp_put(uint8_t mbox_nr, can_frame_t * p_frame)
+{
+    diag_id_t::tx_set(CH_0, mbox_nr, p_frame, DATA_FRAME);   
+} /* End of function isotp_put(). */
+
+
+/*******************************************************************************
+* Function name: isotp_st_min_ticks
+* Description  : Convert an ISO 15765-2 STmin value to CMT2 ticks.
+* Argument     : st_min -
+*                   0x00-0x7F: milliseconds. 0xF1-0xF9: 100-900 us.
+*                   Reserved values are treated as 0x7F.
+* Return value : Timer ticks, 0 for no gap.
+*******************************************************************************/
+static uint16_t isotp_st_min_ticks(uint8_t st_min)
+{
+    if ((st_min >= 0xF1) && (st_min <= 0xF9))
+    {
+        return (uint16_t)((st_min - 0xF0) * (ISOTP_TIMER_HZ / 10000));
+    }
+
+    if (st_min > 0x7F)
+    {
+        st_min = 0x7F;
+    }
+
+    return (uint16_t)(st_min * (ISOTP_TIMER_HZ / 1000));
+} /* End of function isotp_st_min_ticks(). */
+
+
+/*******************************************************************************
+* Function name: isotp_timer_start
+* Description  : Start CMT2 for one period. The compare match interrupt fires
+*                once, isotp_timer_isr stops the timer.
+* Argument     : ticks -
+*                   Period in PCLK/128 ticks.
+* Return value : none
+*******************************************************************************/
+static void isotp_timer_start(uint16_t ticks)
+{
+    CMT.CMSTR1.BIT.STR0 = 0;
+    CMT2.CMCNT = 0;
+    CMT2.CMCOR = (ticks > 1) ? (ticks - 1) : 1;
+    CMT.CMSTR1.BIT.STR0 = 1;
+} /* End of function isotp_timer_start(). */
+
+
+/*******************************************************************************
+* Function name: isotp_timer_stop
+* Description  : Stop CMT2.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void isotp_timer_stop(void)
+{
+    CMT.CMSTR1.BIT.STR0 = 0;
+} /* End of function isotp_timer_stop(). */
+
+
+/*****************************************************************************
+* Function name:    isotp_timer_isr
+* Description  :    CMT2 compare match. STmin elapsed, or another slice of the
+*                   flow control wait.
+* Arguments    :    N/A
+* Return value :    N/A
+*****************************************************************************/
+#pragma interrupt isotp_timer_isr(vect=VECT_CMT2_CMI2, enable)
+void isotp_timer_isr(void)
+{
+    isotp_timer_stop();
+
+    switch (isotp_tx.state)
+    {
+        case ISOTP_TX_WAIT_ST_MIN:
+            isotp_send_cf();
+        break;
+
+        case ISOTP_TX_WAIT_FC:
+            isotp_tx.wait_ms_left -= ISOTP_TIMER_MAX_MS;
+            if (isotp_tx.wait_ms_left > 0)
+            {
+                isotp_timer_start(ISOTP_TIMER_HZ / 1000 * ISOTP_TIMER_MAX_MS);
+            }
+            else
+            {
+                /* N_Bs timeout. */
+                isotp_tx.state = ISOTP_TX_IDLE;
+                isotp_tx.nr_aborted++;
+            }
+        break;
+
+        default:
+        break;
+    }
+} /* end isotp_timer_isr() */
+
+#endif /* USE_CAN_POLL == 0 */
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : sys_tick.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : 1 ms system tick on CMT3. Runs the timers of the CAN protocol
+*                 layers. The tick runs at the CAN interrupt level, so tick 
+*                 work and the CAN ISRs never preempt each other.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define SYS_TICK_HZ             1000
+#define SYS_TICK_CMCR           0x00C0  /* Bit 7 reserved 1, CMIE, CKS = PCLK/8. */
+
+/*******************************************************************************
+Exported global variables
+*******************************************************************************/
+/* Milliseconds since sys_tick_init. */
+volatile uint32_t g_tick_ms = 0;
+
+
+/*******************************************************************************
+* Function name: sys_tick_init
+* Description  : Start the 1 ms tick. Does nothing if it is already running.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void sys_tick_init(void)
+{
+    if (CMT.CMSTR1.BIT.STR1)
+    {
+        return;
+    }
+
+    /* Protection off, release CMT3 from module stop, protection on. */
+    SYSTEM.PRCR.WORD = 0xA502;
+    MSTP(CMT3) = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    CMT3.CMCR.WORD = SYS_TICK_CMCR;
+    CMT3.CMCOR = (uint16_t)((PCLK_HZ / 8 / SYS_TICK_HZ) - 1);
+    CMT3.CMCNT = 0;
+
+    IPR(CMT3, CMI3) = CAN0_INT_LVL;
+    IEN(CMT3, CMI3) = 1;
+
+    CMT.CMSTR1.BIT.STR1 = 1;
+} /* End of function sys_tick_init(). */
+
+
+/*******************************************************************************
+* Function name: sys_time_us
+* Description  : Microseconds since sys_tick_init, from the tick count and the
+*                CMT3 counter. Wraps after 71 minutes. Also right in ISRs 
+*                that hold off the tick, for up to 1 ms.
+* Argument     : none
+* Return value : Time in us.
+*******************************************************************************/
+uint32_t sys_time_us(void)
+{
+    uint32_t    ms;
+    uint16_t    cnt;
+    uint8_t     pending;
+
+    /* Read again if the tick moved in between. */
+    do
+    {
+        ms = g_tick_ms;
+        cnt = CMT3.CMCNT;
+        pending = IR(CMT3, CMI3);
+        if (pending)
+        {
+            /* The counter has wrapped. Read it after the wrap. */
+            cnt = CMT3.CMCNT;
+        }
+    } while (ms != g_tick_ms);
+
+    /* Called from an ISR at the tick level, the tick may be due but not yet 
+    counted. */
+    if (pending)
+    {
+        ms++;
+    }
+
+    return (ms * 1000) + (cnt / (PCLK_HZ / 8 / 1000000UL));
+} /* End of function sys_time_us(). */
+
+
+/*****************************************************************************
+* Function name:    sys_tick_isr
+* Description  :    CMT3 compare match, every 1 ms.
+* Arguments    :    N/A
+* Return value :    N/A
+*****************************************************************************/
+#pragma interrupt sys_tick_isr(vect=VECT_CMT3_CMI3, enable)
+void sys_tick_isr(void)
+{
+    /* CMT3 counts up from the compare match, so it is the entry latency. */
+    PROBE_VALUE(PROBE_LAT_SYS_TICK, CMT3.CMCNT);
+    PROBE_ENTER(PROBE_SYS_TICK_ISR);
+
+    g_tick_ms++;
+
+    #if DEMO_J1939
+    j1939_tick();
+    #endif
+
+    #if (USE_CAN_POLL == 0)
+    uds_tick();
+    tsync_tick();
+    latest_tx_tick();
+    #endif
+
+    inputs_tick();
+    PROBE_EXIT(PROBE_SYS_TICK_ISR);
+} /* end sys_tick_isr() */
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_j1939.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : SAE J1939 data link layer on the CAN0 extended ID path.
+*                 - PGN, priority and source/destination address encoding.
+*                 - Address claim with NAME arbitration (J1939-81).
+*                 - BAM and CMDT (RTS/CTS) multi-packet transport, both 
+*                   directions, up to 1785 bytes (J1939-21).
+*                 Filtering is done by the mailbox masks. Mailbox 
+*                 CANBOX_J1939_RX_NM admits only PF 0xE8-0xEF (request, 
+*                 address claim and transport). The subscription mailboxes 
+*                 admit one PGN each, and for PDU1 PGNs only our address.
+*                 Received frames are handled in the CAN0 Rx ISR. Timing 
+*                 (claim wait, BAM gap, T1-T4) runs from the 1 ms tick, and all
+*                 transport frames are sent from there too.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if DEMO_J1939
+#if (FRAME_ID_MODE == STD_ID_MODE) && !CAN_MIXED_ID_FRAMES
+#error "J1939 needs extended ID mode, or CAN_MIXED_ID_FRAMES"
+#endif
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+/* 29-bit identifier fields. */
+#define J1939_ID_PRIO_SHIFT     26
+#define J1939_ID_PGN_SHIFT      8
+#define J1939_PDU2_PF_MIN       240     /* PF below this: PDU1, PS is the DA. */
+
+/* Mailbox masks, priority and source address are don't care. */
+#define J1939_MASK_NM           0x03F80000  /* DP, EDP, PF bits 7-3. */
+#define J1939_MASK_PGN          0x03FFFF00  /* DP, EDP, PF, PS. */
+
+/* Addresses. */
+#define J1939_SA_NULL           0xFE
+#define J1939_SA_GLOBAL         0xFF
+#define J1939_SA_DYN_FIRST      0x80    /* Self-configurable address range. */
+#define J1939_SA_DYN_LAST       0xF7
+
+/* PGNs. */
+#define J1939_PGN_REQUEST       0xEA00
+#define J1939_PGN_ADDR_CLAIM    0xEE00
+#define J1939_PGN_TP_CM         0xEC00
+#define J1939_PGN_TP_DT         0xEB00
+
+/* TP.CM control bytes. */
+#define J1939_TP_RTS            16
+#define J1939_TP_CTS            17
+#define J1939_TP_EOM_ACK        19
+#define J1939_TP_BAM            32
+#define J1939_TP_ABORT          255
+#define J1939_TP_ABORT_BUSY     1       /* Already in a session. */
+#define J1939_TP_ABORT_TIMEOUT  3
+#define J1939_TP_ABORT_BAD_SEQ  7       /* CTS asks for a packet we do not have. */
+
+#define J1939_TP_MAX_LEN        1785    /* 255 packets of 7 bytes. */
+#define J1939_PRIO_CONTROL      6
+#define J1939_PRIO_TP           7
+
+/* Timing, ms. */
+#define J1939_CLAIM_WAIT_MS     250
+#define J1939_BAM_GAP_MS        50
+#define J1939_T1_MS             750
+#define J1939_T2_MS             1250
+#define J1939_T3_MS             1250
+#define J1939_T4_MS             1050
+
+/* Our NAME, byte 0 first on the bus. Arbitrary address capable, 
+industry group 0, identity number 1. Lower NAME wins address contention. */
+static const uint8_t j1939_name[8] = {0x01, 0x00, 0xE0, 0xFF, 0x00, 0x81, 0x00, 0x80};
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef enum
+{
+    J1939_AC_START,         /* Claim to be sent on the next tick. */
+    J1939_AC_CLAIMING,      /* Claim sent, waiting for contention. */
+    J1939_AC_CLAIMED,
+    J1939_AC_CANNOT_CLAIM
+} j1939_ac_state_t;
+
+typedef enum
+{
+    J1939_TP_IDLE,
+    J1939_TP_TX_START,      /* BAM or RTS to be sent on the next tick. */
+    J1939_TP_TX_BAM,
+    J1939_TP_TX_WAIT_CTS,
+    J1939_TP_TX_CMDT,       /* Sending the packets granted by a CTS. */
+    J1939_TP_TX_WAIT_EOM,
+    J1939_TP_RX_BAM,
+    J1939_TP_RX_CMDT
+} j1939_tp_state_t;
+
+/* Transmit session. */
+typedef struct
+{
+    volatile j1939_tp_state_t   state;
+    const uint8_t *             p_data;     /* Caller's buffer, not copied. */
+    uint16_t                    len;
+    uint32_t                    pgn;
+    uint8_t                     da;
+    uint8_t                     nr_packets;
+    uint8_t                     next_seq;
+    uint8_t                     cts_left;
+    uint16_t                    timer_ms;
+    uint32_t                    nr_done;
+    uint32_t                    nr_aborted;
+} j1939_tp_tx_t;
+
+/* Receive session, and the message handed to j1939_receive. */
+typedef struct
+{
+    j1939_tp_state_t            state;
+    uint32_t                    pgn;
+    uint8_t                     sa;
+    uint16_t                    len;
+    uint8_t                     nr_packets;
+    uint8_t                     next_seq;
+    uint8_t                     cts_max;    /* Sender's max. packets per CTS. */
+    uint8_t                     cts_end;    /* Last packet of the current CTS. */
+    uint16_t                    timer_ms;
+    volatile uint8_t            done;
+    uint8_t                     buf[J1939_TP_MAX_LEN];
+    uint32_t                    nr_dropped;
+} j1939_tp_rx_t;
+
+static uint8_t                  j1939_sa = J1939_PREFERRED_SA;
+static volatile j1939_ac_state_t j1939_ac_state;
+static uint16_t                 j1939_ac_timer_ms;
+static volatile uint8_t         j1939_ac_send;      /* Claim requested by ISR. */
+static j1939_tp_tx_t            j1939_tx;
+static j1939_tp_rx_t            j1939_rx;
+static uint8_t                  j1939_nr_subs;
+static uint32_t                 j1939_sub_pgn[CANBOX_J1939_RX_SUB_LAST - CANBOX_J1939_RX_SUB_FIRST + 1];
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint32_t j1939_id(uint8_t priority, uint32_t pgn, uint8_t da, uint8_t sa);
+static void     j1939_put(uint8_t mbox_nr, uint8_t priority, uint32_t pgn, uint8_t da, 
+                          const uint8_t * p_data, uint8_t dlc);
+static void     j1939_send_claim(void);
+static void     j1939_send_tp_cm(uint8_t da, uint8_t ctrl, uint8_t b1, uint8_t b2, 
+                                 uint8_t b3, uint8_t b4, uint32_t pgn);
+static void     j1939_send_tp_dt(void);
+static void     j1939_rx_addr_claim(uint8_t sa, const uint8_t * p_name);
+static void     j1939_rx_tp_cm(uint8_t sa, uint8_t da, const uint8_t * p_data);
+static void     j1939_rx_tp_dt(uint8_t sa, const uint8_t * p_data);
+static void     j1939_rx_complete(void);
+
+
+/*******************************************************************************
+* Function name: j1939_id
+* Description  : Build a 29-bit J1939 identifier.
+* Arguments    : priority -
+*                   0 (highest) to 7.
+*                pgn -
+*                   Parameter group number, 18 bits.
+*                da -
+*                   Destination address, used for PDU1 PGNs only.
+*                sa -
+*                   Source address.
+* Return value : CAN identifier.
+*******************************************************************************/
+static uint32_t j1939_id(uint8_t priority, uint32_t pgn, uint8_t da, uint8_t sa)
+{
+    pgn &= 0x3FFFF;
+
+    if (((pgn >> 8) & 0xFF) < J1939_PDU2_PF_MIN)
+    {
+        pgn = (pgn & 0x3FF00) | da;
+    }
+
+    return ((uint32_t)(priority & 0x07) << J1939_ID_PRIO_SHIFT) | (pgn << J1939_ID_PGN_SHIFT) | sa;
+} /* End of function j1939_id(). */
+
+
+/*******************************************************************************
+* Function name: j1939_init
+* Description  : Set up the J1939 receive mailboxes and masks. The first call
+*                also starts address claim; later ones, from the startup code
+*                that runs each pass, only put the mailboxes back, with the 
+*                subscriptions, and leave the claim and any session running.
+*                Call in Halt mode.
+* Argument     : none
+* Return value : CAN API code
+*******************************************************************************/
+uint32_t j1939_init(void)
+{
+    uint32_t    api_status = R_CAN_OK;
+    uint8_t     i;
+    static bool init_done = false;
+
+    if (!init_done)
+    {
+        memset(&j1939_tx, 0, sizeof(j1939_tx));
+        j1939_rx.state = J1939_TP_IDLE;
+        j1939_rx.done = 0;
+        j1939_nr_subs = 0;
+        j1939_ac_send = 0;
+        j1939_ac_state = J1939_AC_START;
+        init_done = true;
+    }
+
+    /* Request, address claim and transport, any destination. The DA is
+    checked in software since it can be ours or global. */
+    api_status |= j1939_id_t::rx_set(CH_0, CANBOX_J1939_RX_NM, 
+                                 j1939_id(0, J1939_PGN_REQUEST, 0, 0), DATA_FRAME);
+    R_CAN_RxSetMask(CH_0, CANBOX_J1939_RX_NM, J1939_MASK_NM);
+
+    for (i = 0; i < j1939_nr_subs; i++)
+    {
+        api_status |= j1939_id_t::rx_set(CH_0, CANBOX_J1939_RX_SUB_FIRST + i, 
+                                     j1939_id(0, j1939_sub_pgn[i], j1939_sa, 0), DATA_FRAME);
+        R_CAN_RxSetMask(CH_0, CANBOX_J1939_RX_SUB_FIRST + i, J1939_MASK_PGN);
+    }
+
+    return api_status;
+} /* End of function j1939_init(). */
+
+
+/*******************************************************************************
+* Function name: j1939_subscribe
+* Description  : Receive a PGN in its own mailbox. PDU1 PGNs are filtered on our
+*                current address, so subscribe after the address is settled.
+*                Call in Halt mode.
+* Argument     : pgn -
+*                   Parameter group number.
+* Return value : CAN API code, R_CAN_SW_BAD_MBX if all mailboxes are in use.
+*******************************************************************************/
+uint32_t j1939_subscribe(uint32_t pgn)
+{
+    uint8_t  mbox_nr;
+    uint32_t api_status;
+
+    mbox_nr = CANBOX_J1939_RX_SUB_FIRST + j1939_nr_subs;
+    if (mbox_nr > CANBOX_J1939_RX_SUB_LAST)
+    {
+        return R_CAN_SW_BAD_MBX;
+    }
+
+    api_status = j1939_id_t::rx_set(CH_0, mbox_nr, j1939_id(0, pgn, j1939_sa, 0), DATA_FRAME);
+    R_CAN_RxSetMask(CH_0, mbox_nr, J1939_MASK_PGN);
+    j1939_sub_pgn[j1939_nr_subs++] = pgn;
+
+    return api_status;
+} /* End of function j1939_subscribe(). */
+
+
+/*******************************************************************************
+* Function name: j1939_send
+* Description  : Send a parameter group. Up to 8 bytes go in one frame. Longer
+*                ones use BAM if da is global, else CMDT. Transport data is not
+*                copied; keep the buffer unchanged until the session ends.
+* Arguments    : pgn -
+*                   Parameter group number.
+*                priority -
+*                   0 (highest) to 7.
+*                da -
+*                   Destination address, J1939_SA_GLOBAL to broadcast.
+*                p_data -
+*                   Data.
+*                len -
+*                   Data length, up to J1939_TP_MAX_LEN.
+* Return value : R_CAN_OK, R_CAN_NOT_OK if no address is claimed, the transport
+*                is busy or the length is invalid.
+*******************************************************************************/
+uint32_t j1939_send(uint32_t pgn, uint8_t priority, uint8_t da, const uint8_t * p_data, uint16_t len)
+{
+    if ((J1939_AC_CLAIMED != j1939_ac_state) || (0 == len) || (len > J1939_TP_MAX_LEN))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    if (len <= 8)
+    {
+        j1939_put(CANBOX_J1939_TX, priority, pgn, da, p_data, (uint8_t)len);
+        return R_CAN_OK;
+    }
+
+    if (J1939_TP_IDLE != j1939_tx.state)
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    j1939_tx.p_data = p_data;
+    j1939_tx.len = len;
+    j1939_tx.pgn = pgn;
+    j1939_tx.da = da;
+    j1939_tx.nr_packets = (uint8_t)((len + 6) / 7);
+    j1939_tx.next_seq = 1;
+
+    /* The tick sends the BAM or RTS. */
+    j1939_tx.state = J1939_TP_TX_START;
+
+    return R_CAN_OK;
+} /* End of function j1939_send(). */
+
+
+/*******************************************************************************
+* Function name: j1939_receive
+* Description  : Fetch a received parameter group, single frame or transport.
+* Arguments    : p_pgn, p_sa -
+*                   PGN and source address of the message.
+*                p_dest -
+*                   Where to copy the data.
+*                max_len -
+*                   Size of p_dest. Longer messages are truncated.
+* Return value : Data length, 0 if no message is waiting.
+*******************************************************************************/
+uint16_t j1939_receive(uint32_t * p_pgn, uint8_t * p_sa, uint8_t * p_dest, uint16_t max_len)
+{
+    uint16_t len;
+
+    if (0 == j1939_rx.done)
+    {
+        return 0;
+    }
+
+    *p_pgn = j1939_rx.pgn;
+    *p_sa = j1939_rx.sa;
+    len = j1939_rx.len;
+    memcpy(p_dest, j1939_rx.buf, (len < max_len) ? len : max_len);
+
+    /* Release the buffer for the next message. */
+    j1939_rx.done = 0;
+
+    return len;
+} /* End of function j1939_receive(). */
+
+
+/*******************************************************************************
+* Function name: j1939_rx_frame
+* Description  : Handle a frame from a J1939 mailbox. Called from the CAN0 Rx 
+*                ISR.
+* Argument     : p_frame -
+*                   Received frame.
+* Return value : none
+*******************************************************************************/
+void j1939_rx_frame(const can_frame_t * p_frame)
+{
+    uint32_t pgn;
+    uint8_t  sa;
+    uint8_t  da = J1939_SA_GLOBAL;
+
+    pgn = (p_frame->id >> J1939_ID_PGN_SHIFT) & 0x3FFFF;
+    sa = (uint8_t)p_frame->id;
+
+    if (((pgn >> 8) & 0xFF) < J1939_PDU2_PF_MIN)
+    {
+        da = (uint8_t)pgn;
+        pgn &= 0x3FF00;
+
+        if ((da != j1939_sa) && (da != J1939_SA_GLOBAL))
+        {
+            return;     /* For someone else. */
+        }
+    }
+
+    switch (pgn)
+    {
+        case J1939_PGN_ADDR_CLAIM:
+            j1939_rx_addr_claim(sa, p_frame->data);
+        break;
+
+        case J1939_PGN_REQUEST:
+            if ((p_frame->dlc >= 3) && (0 == p_frame->data[2]) &&
+                (J1939_PGN_ADDR_CLAIM == (((uint32_t)p_frame->data[1] << 8) | p_frame->data[0])))
+            {
+                j1939_ac_send = 1;
+            }
+        break;
+
+        case J1939_PGN_TP_CM:
+            j1939_rx_tp_cm(sa, da, p_frame->data);
+        break;
+
+        case J1939_PGN_TP_DT:
+            j1939_rx_tp_dt(sa, p_frame->data);
+        break;
+
+        default:
+            /* Subscribed PGN in a single frame. */
+            if (j1939_rx.done || (J1939_TP_IDLE != j1939_rx.state))
+            {
+                j1939_rx.nr_dropped++;
+                break;
+            }
+            j1939_rx.pgn = pgn;
+            j1939_rx.sa = sa;
+            j1939_rx.len = p_frame->dlc;
+            memcpy(j1939_rx.buf, p_frame->data, p_frame->dlc);
+            j1939_rx.done = 1;
+        break;
+    }
+} /* End of function j1939_rx_frame(). */
+
+
+/*******************************************************************************
+* Function name: j1939_tick
+* Description  : J1939 timing. Called from the 1 ms tick ISR.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void j1939_tick(void)
+{
+    /* Address claim. */
+    if (J1939_AC_START == j1939_ac_state)
+    {
+        j1939_ac_state = J1939_AC_CLAIMING;
+        j1939_ac_timer_ms = J1939_CLAIM_WAIT_MS;
+        j1939_ac_send = 1;
+    }
+    else if ((J1939_AC_CLAIMING == j1939_ac_state) && (0 == --j1939_ac_timer_ms))
+    {
+        j1939_ac_state = J1939_AC_CLAIMED;
+    }
+
+    if (j1939_ac_send)
+    {
+        j1939_ac_send = 0;
+        j1939_send_claim();
+    }
+
+    /* Transmit session. */
+    switch (j1939_tx.state)
+    {
+        case J1939_TP_TX_START:
+            if (J1939_SA_GLOBAL == j1939_tx.da)
+            {
+                j1939_send_tp_cm(J1939_SA_GLOBAL, J1939_TP_BAM, (uint8_t)j1939_tx.len, 
+                                 (uint8_t)(j1939_tx.len >> 8), j1939_tx.nr_packets, 0xFF, 
+                                 j1939_tx.pgn);
+                j1939_tx.timer_ms = J1939_BAM_GAP_MS;
+                j1939_tx.state = J1939_TP_TX_BAM;
+            }
+            else
+            {
+                j1939_send_tp_cm(j1939_tx.da, J1939_TP_RTS, (uint8_t)j1939_tx.len, 
+                                 (uint8_t)(j1939_tx.len >> 8), j1939_tx.nr_packets, 0xFF, 
+                                 j1939_tx.pgn);
+                j1939_tx.timer_ms = J1939_T3_MS;
+                j1939_tx.state = J1939_TP_TX_WAIT_CTS;
+            }
+        break;
+
+        case J1939_TP_TX_BAM:
+            if (0 == --j1939_tx.timer_ms)
+            {
+                j1939_send_tp_dt();
+                j1939_tx.timer_ms = J1939_BAM_GAP_MS;
+
+                if (j1939_tx.next_seq > j1939_tx.nr_packets)
+                {
+                    j1939_tx.state = J1939_TP_IDLE;
+                    j1939_tx.nr_done++;
+                }
+            }
+        break;
+
+        case J1939_TP_TX_CMDT:
+            /* One packet per tick. */
+            j1939_send_tp_dt();
+
+            if ((0 == --j1939_tx.cts_left) || (j1939_tx.next_seq > j1939_tx.nr_packets))
+            {
+                j1939_tx.timer_ms = J1939_T3_MS;
+                j1939_tx.state = (j1939_tx.next_seq > j1939_tx.nr_packets) ? 
+                                 J1939_TP_TX_WAIT_EOM : J1939_TP_TX_WAIT_CTS;
+            }
+        break;
+
+        case J1939_TP_TX_WAIT_CTS:
+        case J1939_TP_TX_WAIT_EOM:
+            if (0 == --j1939_tx.timer_ms)
+            {
+                j1939_send_tp_cm(j1939_tx.da, J1939_TP_ABORT, J1939_TP_ABORT_TIMEOUT, 
+                                 0xFF, 0xFF, 0xFF, j1939_tx.pgn);
+                j1939_tx.state = J1939_TP_IDLE;
+                j1939_tx.nr_aborted++;
+            }
+        break;
+
+        default:
+        break;
+    }
+
+    /* Receive session. */
+    if ((J1939_TP_IDLE != j1939_rx.state) && (0 == --j1939_rx.timer_ms))
+    {
+        if (J1939_TP_RX_CMDT == j1939_rx.state)
+        {
+            j1939_send_tp_cm(j1939_rx.sa, J1939_TP_ABORT, J1939_TP_ABORT_TIMEOUT, 
+                             0xFF, 0xFF, 0xFF, j1939_rx.pgn);
+        }
+        j1939_rx.state = J1939_TP_IDLE;
+        j1939_rx.nr_dropped++;
+    }
+} /* End of function j1939_tick(). */
+
+
+/*******************************************************************************
+* Function name: j1939_rx_addr_claim
+* Description  : Another node claimed an address. If it is ours, the lower NAME
+*                keeps it. On losing, move to the next free dynamic address, 
+*                or give up with Cannot Claim.
+* Arguments    : sa -
+*                   Address claimed.
+*                p_name -
+*                   NAME of the claimant.
+* Return value : none
+*******************************************************************************/
+static void j1939_rx_addr_claim(uint8_t sa, const uint8_t * p_name)
+{
+    int8_t i;
+
+    if ((sa != j1939_sa) || (J1939_AC_CANNOT_CLAIM == j1939_ac_state))
+    {
+        return;
+    }
+
+    /* Compare NAMEs, most significant byte last on the bus. */
+    for (i = 7; i >= 0; i--)
+    {
+        if (j1939_name[i] != p_name[i])
+        {
+            break;
+        }
+    }
+
+    if ((i >= 0) && (j1939_name[i] < p_name[i]))
+    {
+        /* We win. Defend the address. */
+        j1939_ac_send = 1;
+        return;
+    }
+
+    /* We lose. Arbitrary address capable (NAME bit 63): try the next one. */
+    if ((j1939_name[7] & 0x80) && (j1939_sa < J1939_SA_DYN_LAST))
+    {
+        j1939_sa = (j1939_sa < J1939_SA_DYN_FIRST) ? J1939_SA_DYN_FIRST : (j1939_sa + 1);
+        j1939_ac_state = J1939_AC_START;
+    }
+    else
+    {
+        j1939_sa = J1939_SA_NULL;
+        j1939_ac_state = J1939_AC_CANNOT_CLAIM;
+        j1939_ac_send = 1;
+    }
+} /* End of function j1939_rx_addr_claim(). */
+
+
+/*******************************************************************************
+* Function name: j1939_rx_tp_cm
+* Description  : Handle a transport connection management frame.
+* Arguments    : sa, da -
+*                   Source and destination address.
+*                p_data -
+*                   Frame data.
+* Return value : none
+*******************************************************************************/
+static void j1939_rx_tp_cm(uint8_t sa, uint8_t da, const uint8_t * p_data)
+{
+    uint32_t pgn;
+    uint16_t len;
+
+    pgn = ((uint32_t)p_data[7] << 16) | ((uint32_t)p_data[6] << 8) | p_data[5];
+    len = ((uint16_t)p_data[2] << 8) | p_data[1];
+
+    switch (p_data[0])
+    {
+        case J1939_TP_BAM:
+        case J1939_TP_RTS:
+            if ((J1939_TP_IDLE != j1939_rx.state) || j1939_rx.done || 
+                (len > J1939_TP_MAX_LEN) || (p_data[3] != (uint8_t)((len + 6) / 7)))
+            {
+                if (J1939_TP_RTS == p_data[0])
+                {
+                    j1939_send_tp_cm(sa, J1939_TP_ABORT, J1939_TP_ABORT_BUSY, 
+                                     0xFF, 0xFF, 0xFF, pgn);
+                }
+                j1939_rx.nr_dropped++;
+                break;
+            }
+
+            j1939_rx.pgn = pgn;
+            j1939_rx.sa = sa;
+            j1939_rx.len = len;
+            j1939_rx.nr_packets = p_data[3];
+            j1939_rx.next_seq = 1;
+            j1939_rx.timer_ms = J1939_T1_MS;
+
+            if (J1939_TP_BAM == p_data[0])
+            {
+                if (J1939_SA_GLOBAL == da)
+                {
+                    j1939_rx.state = J1939_TP_RX_BAM;
+                }
+            }
+            else
+            {
+                /* Grant as many packets as the sender takes per CTS. */
+                j1939_rx.cts_max = p_data[4];
+                j1939_rx.cts_end = (j1939_rx.cts_max < j1939_rx.nr_packets) ? 
+                                   j1939_rx.cts_max : j1939_rx.nr_packets;
+                j1939_rx.timer_ms = J1939_T2_MS;
+                j1939_rx.state = J1939_TP_RX_CMDT;
+                j1939_send_tp_cm(sa, J1939_TP_CTS, j1939_rx.cts_end, 1, 0xFF, 0xFF, pgn);
+            }
+        break;
+
+        case J1939_TP_CTS:
+            if ((J1939_TP_TX_WAIT_CTS != j1939_tx.state) || (sa != j1939_tx.da))
+            {
+                break;
+            }
+            if (0 == p_data[1])
+            {
+                /* Receiver asks us to hold the connection open. */
+                j1939_tx.timer_ms = J1939_T4_MS;
+                break;
+            }
+            if ((0 == p_data[2]) || (p_data[2] > j1939_tx.nr_packets))
+            {
+                j1939_send_tp_cm(sa, J1939_TP_ABORT, J1939_TP_ABORT_BAD_SEQ, 
+                                 0xFF, 0xFF, 0xFF, j1939_tx.pgn);
+                j1939_tx.state = J1939_TP_IDLE;
+                j1939_tx.nr_aborted++;
+                break;
+            }
+
+            /* No more packets than are left from the one asked for. */
+            j1939_tx.next_seq = p_data[2];
+            j1939_tx.cts_left = p_data[1];
+            if (j1939_tx.cts_left > (j1939_tx.nr_packets - j1939_tx.next_seq + 1))
+            {
+                j1939_tx.cts_left = j1939_tx.nr_packets - j1939_tx.next_seq + 1;
+            }
+            j1939_tx.state = J1939_TP_TX_CMDT;
+        break;
+
+        case J1939_TP_EOM_ACK:
+            if ((J1939_TP_TX_WAIT_EOM == j1939_tx.state) && (sa == j1939_tx.da))
+            {
+                j1939_tx.state = J1939_TP_IDLE;
+                j1939_tx.nr_done++;
+            }
+        break;
+
+        case J1939_TP_ABORT:
+            if ((J1939_TP_IDLE != j1939_tx.state) && (sa == j1939_tx.da))
+            {
+                j1939_tx.state = J1939_TP_IDLE;
+                j1939_tx.nr_aborted++;
+            }
+            if ((J1939_TP_IDLE != j1939_rx.state) && (sa == j1939_rx.sa))
+            {
+                j1939_rx.state = J1939_TP_IDLE;
+                j1939_rx.nr_dropped++;
+            }
+        break;
+
+        default:
+        break;
+    }
+} /* End of function j1939_rx_tp_cm(). */
+
+
+/*******************************************************************************
+* Function name: j1939_rx_tp_dt
+* Description  : Handle a transport data frame of the current receive session.
+* Arguments    : sa -
+*                   Source address.
+*                p_data -
+*                   Frame data, sequence number first.
+* Return value : none
+*******************************************************************************/
+static void j1939_rx_tp_dt(uint8_t sa, const uint8_t * p_data)
+{
+    uint16_t offset;
+    uint16_t len;
+
+    if ((J1939_TP_IDLE == j1939_rx.state) || (sa != j1939_rx.sa))
+    {
+        return;
+    }
+
+    if (p_data[0] != j1939_rx.next_seq)
+    {
+        if (J1939_TP_RX_CMDT == j1939_rx.state)
+        {
+            j1939_send_tp_cm(sa, J1939_TP_ABORT, J1939_TP_ABORT_TIMEOUT, 0xFF, 0xFF, 0xFF, 
+                             j1939_rx.pgn);
+        }
+        j1939_rx.state = J1939_TP_IDLE;
+        j1939_rx.nr_dropped++;
+        return;
+    }
+
+    offset = (uint16_t)(j1939_rx.next_seq - 1) * 7;
+    len = j1939_rx.len - offset;
+    if (len > 7)
+    {
+        len = 7;
+    }
+    memcpy(&j1939_rx.buf[offset], &p_data[1], len);
+    j1939_rx.timer_ms = J1939_T1_MS;
+
+    if (j1939_rx.next_seq >= j1939_rx.nr_packets)
+    {
+        j1939_rx_complete();
+        return;
+    }
+
+    if ((J1939_TP_RX_CMDT == j1939_rx.state) && (j1939_rx.next_seq == j1939_rx.cts_end))
+    {
+        /* Grant the next window. */
+        j1939_rx.cts_end += j1939_rx.cts_max;
+        if (j1939_rx.cts_end > j1939_rx.nr_packets)
+        {
+            j1939_rx.cts_end = j1939_rx.nr_packets;
+        }
+        j1939_send_tp_cm(sa, J1939_TP_CTS, j1939_rx.cts_end - j1939_rx.next_seq, 
+                         j1939_rx.next_seq + 1, 0xFF, 0xFF, j1939_rx.pgn);
+        j1939_rx.timer_ms = J1939_T2_MS;
+    }
+
+    j1939_rx.next_seq++;
+} /* End of function j1939_rx_tp_dt(). */
+
+
+/*******************************************************************************
+* Function name: j1939_rx_complete
+* Description  : Last packet received. Acknowledge CMDT and hand over the 
+*                message.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void j1939_rx_complete(void)
+{
+    if (J1939_TP_RX_CMDT == j1939_rx.state)
+    {
+        j1939_send_tp_cm(j1939_rx.sa, J1939_TP_EOM_ACK, (uint8_t)j1939_rx.len, 
+                         (uint8_t)(j1939_rx.len >> 8), j1939_rx.nr_packets, 0xFF, 
+                         j1939_rx.pgn);
+    }
+
+    j1939_rx.state = J1939_TP_IDLE;
+    j1939_rx.done = 1;
+} /* End of function j1939_rx_complete(). */
+
+
+/*******************************************************************************
+* Function name: j1939_send_claim
+* Description  : Send Address Claimed, or Cannot Claim from the null address.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void j1939_send_claim(void)
+{
+    j1939_put(CANBOX_J1939_TX_CM, J1939_PRIO_CONTROL, J1939_PGN_ADDR_CLAIM, 
+              J1939_SA_GLOBAL, j1939_name, 8);
+} /* End of function j1939_send_claim(). */
+
+
+/*******************************************************************************
+* Function name: j1939_send_tp_cm
+* Description  : Send a TP.CM frame.
+* Arguments    : da -
+*                   Destination address.
+*                ctrl -
+*                   Control byte.
+*                b1-b4 -
+*                   Control specific bytes 1-4.
+*                pgn -
+*                   PGN of the packeted message.
+* Return value : none
+*******************************************************************************/
+static void j1939_send_tp_cm(uint8_t da, uint8_t ctrl, uint8_t b1, uint8_t b2, 
+                             uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+    uint8_t data[8];
+
+    data[0] = ctrl;
+    data[1] = b1;
+    data[2] = b2;
+    data[3] = b3;
+    data[4] = b4;
+    data[5] = (uint8_t)pgn;
+    data[6] = (uint8_t)(pgn >> 8);
+    data[7] = (uint8_t)(pgn >> 16);
+
+    j1939_put(CANBOX_J1939_TX_CM, J1939_PRIO_TP, J1939_PGN_TP_CM, da, data, 8);
+} /* End of function j1939_send_tp_cm(). */
+
+
+/*******************************************************************************
+* Function name: j1939_send_tp_dt
+* Description  : Send the next TP.DT packet of the transmit session. Unused 
+*                bytes of the last packet are 0xFF.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void j1939_send_tp_dt(void)
+{
+    uint8_t  data[8];
+    uint16_t offset;
+    uint16_t len;
+
+    offset = (uint16_t)(j1939_tx.next_seq - 1) * 7;
+    len = j1939_tx.len - offset;
+    if (len > 7)
+    {
+        len = 7;
+    }
+
+    memset(data, 0xFF, 8);
+    data[0] = j1939_tx.next_seq;
+    memcpy(&data[1], &j1939_tx.p_data[offset], len);
+
+    j1939_put(CANBOX_J1939_TX_DT, J1939_PRIO_TP, J1939_PGN_TP_DT, j1939_tx.da, data, 8);
+    j1939_tx.next_seq++;
+} /* End of function j1939_send_tp_dt(). */
+
+
+/*******************************************************************************
+* Function name: j1939_put
+* Description  : Load a J1939 frame into a Tx mailbox and request transmission.
+* Arguments    : mbox_nr -
+*                   Tx mailbox.
+*                priority, pgn, da -
+*                   Identifier fields. The source address is ours.
+*                p_data, dlc -
+*                   Frame data.
+* Return value : none
+*******************************************************************************/
+static void j1939_put(uint8_t mbox_nr, uint8_t priority, uint32_t pgn, uint8_t da, 
+                      const uint8_t * p_data, uint8_t dlc)
+{
+    can_frame_t frame;
+
+    frame.id = j1939_id(priority, pgn, da, j1939_sa);
+    frame.dlc = dlc;
+    memcpy(frame.data, p_data, dlc);
+
+    j1939_id_t::tx_set(CH_0, mbox_nr, &frame, DATA_FRAME);
+} /* End of function j1939_put(). */
+
+#endif /* DEMO_J1939 */
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_uds.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Diagnostic data identifier server on top of ISO-TP.
+*                 0x22 ReadDataByIdentifier: one or more DIDs per request.
+*                 0x2A ReadDataByPeriodicIdentifier: the node sends the 
+*                 requested periodic DIDs (0xF2xx) by itself at slow, medium or
+*                 fast rate as single frames on UDS_PERIODIC_ID, so a tester 
+*                 gets telemetry without polling round trips.
+*                 Requests are served from the main loop. The periodic 
+*                 scheduler runs from the 1 ms tick.
+*                 Multi-byte values are big endian.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if (USE_CAN_POLL == 0)
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+/* Service IDs. */
+#define UDS_SID_READ_DID            0x22
+#define UDS_SID_READ_PERIODIC       0x2A
+#define UDS_POSITIVE_RESPONSE       0x40
+#define UDS_NEGATIVE_RESPONSE       0x7F
+
+/* Negative response codes. */
+#define UDS_NRC_SERVICE_NOT_SUPP    0x11
+#define UDS_NRC_BAD_LENGTH          0x13
+#define UDS_NRC_OUT_OF_RANGE        0x31
+
+/* 0x2A transmission modes and their periods. */
+#define UDS_RATE_SLOW               0x01
+#define UDS_RATE_MEDIUM             0x02
+#define UDS_RATE_FAST               0x03
+#define UDS_RATE_STOP               0x04
+#define UDS_PERIOD_SLOW_MS          1000
+#define UDS_PERIOD_MEDIUM_MS        100
+#define UDS_PERIOD_FAST_MS          10
+
+/* Data identifiers. The low byte is the periodic DID. */
+#define UDS_DID_PERIODIC_BASE       0xF200
+#define UDS_DID_ADC                 0xF200  /* Raw 12-bit ADC, level 0-9. */
+#define UDS_DID_INPUTS              0xF201  /* Bit 0 engine, 1 fuel, 2 traction. */
+#define UDS_DID_TEMPERATURE         0xF202  /* 0.1 degC, signed. */
+#define UDS_DID_ACCEL               0xF203  /* X, Y, Z, signed. */
+#define UDS_DID_CAN_ERRORS          0xF204  /* TEC, REC, bus status, error count. */
+#define UDS_DID_BUS_STATS           0xF205  /* Rx, Tx frames, Rx overruns, mod 2^16. */
+#define UDS_DID_BOOT_TIME           0xF206  /* Time to first frame, us. */
+#define UDS_DID_TIME_SYNC           0xF207  /* Synced, last error us, drift ppm. */
+#define UDS_DID_FRAME_POOL          0xF208  /* Size, in use, high water, exhausted. */
+#define UDS_DID_GATEWAY             0xF209  /* Frames/s, peak, drops, latency us. */
+#define UDS_DID_TX_LIMIT            0xF20A  /* Throttled per ID, by bus load, CAN0 load %. */
+#define UDS_DID_LATEST_TX           0xF20B  /* Frames replaced, stale frames aborted. */
+#define UDS_DID_AUTOBAUD            0xF20C  /* kbps, detection ms, candidates tried. */
+#define UDS_DID_BIT_TIMING          0xF20D  /* Bit rate, BRP, Tq, TSEG1/2, SJW, sample point, tolerance. */
+
+#define UDS_MAX_PERIODIC            8
+#define UDS_BUF_SIZE                128
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef struct
+{
+    uint16_t    did;
+    uint8_t     len;
+    void        (*read)(uint8_t * p_dest);
+} uds_did_t;
+
+typedef struct
+{
+    uint8_t     did_tbl_idx;
+    uint16_t    period_ms;
+    uint16_t    left_ms;
+} uds_periodic_t;
+
+static void uds_read_adc(uint8_t * p_dest);
+static void uds_read_inputs(uint8_t * p_dest);
+static void uds_read_temperature(uint8_t * p_dest);
+static void uds_read_accel(uint8_t * p_dest);
+static void uds_read_can_errors(uint8_t * p_dest);
+static void uds_read_bus_stats(uint8_t * p_dest);
+static void uds_read_boot_time(uint8_t * p_dest);
+
+static const uds_did_t uds_did_tbl[] =
+{
+    {UDS_DID_ADC,           3, uds_read_adc},
+    {UDS_DID_INPUTS,        1, uds_read_inputs},
+    {UDS_DID_TEMPERATURE,   2, uds_read_temperature},
+    {UDS_DID_ACCEL,         6, uds_read_accel},
+    {UDS_DID_CAN_ERRORS,    4, uds_read_can_errors},
+    {UDS_DID_BUS_STATS,     6, uds_read_bus_stats},
+    {UDS_DID_BOOT_TIME,     4, uds_read_boot_time},
+    {UDS_DID_TIME_SYNC,     5, tsync_get_status},
+    {UDS_DID_FRAME_POOL,    5, frame_pool_get_status},
+    #if (USE_CAN_POLL == 0) && DEMO_GATEWAY
+    {UDS_DID_GATEWAY,       10, gateway_get_status},
+    #endif
+    {UDS_DID_TX_LIMIT,      5, tx_limit_get_status},
+    {UDS_DID_LATEST_TX,     4, latest_tx_get_status},
+    {UDS_DID_BIT_TIMING,   14, can_timing_get_status},
+    #if DEMO_AUTOBAUD
+    {UDS_DID_AUTOBAUD,      5, autobaud_get_status},
+    #endif
+};
+#define UDS_NR_DIDS     ((uint8_t)(sizeof(uds_did_tbl) / sizeof(uds_did_tbl[0])))
+
+/* Periodic schedule. Written by uds_poll with the tick masked, read by the tick. */
+static uds_periodic_t   uds_periodic[UDS_MAX_PERIODIC];
+static uint8_t          uds_nr_periodic;
+static uint32_t         uds_periodic_pending;   /* Bit per schedule entry. */
+static uint8_t          uds_periodic_next;      /* Round robin start. */
+
+/* ISO-TP does not copy, so the response lives here until sent. */
+static uint8_t          uds_req[UDS_BUF_SIZE];
+static uint8_t          uds_resp[UDS_BUF_SIZE];
+
+/* Data sources in other files. */
+extern int              temperature;
+extern uint16_t         adc_raw;
+extern uint16_t         adc_result;
+extern uint32_t         can_rx_nr_overflow;
+extern uint32_t         can_nr_rx_frames;
+extern uint32_t         can_nr_tx_frames;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static int8_t   uds_find_did(uint16_t did);
+static uint16_t uds_read_did(const uint8_t * p_req, uint16_t len);
+static uint16_t uds_read_periodic(const uint8_t * p_req, uint16_t len);
+static uint16_t uds_negative(uint8_t sid, uint8_t nrc);
+
+
+/*******************************************************************************
+* Function name: uds_init
+* Description  : Stop all periodic transmissions. Done on the first call 
+*                only; the startup code calls it each pass, and identifiers
+*                scheduled by service 0x2A keep going.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void uds_init(void)
+{
+    static bool init_done = false;
+
+    if (init_done)
+    {
+        return;
+    }
+    init_done = true;
+
+    IEN(CMT3, CMI3) = 0;
+    uds_nr_periodic = 0;
+    uds_periodic_pending = 0;
+    IEN(CMT3, CMI3) = 1;
+} /* End of function uds_init(). */
+
+
+/*******************************************************************************
+* Function name: uds_poll
+* Description  : Serve a diagnostic request if one came in by ISO-TP. Called
+*                from the main loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void uds_poll(void)
+{
+    uint16_t len;
+
+    /* Previous response still going out? Leave the request waiting. */
+    if (isotp_tx_busy())
+    {
+        return;
+    }
+
+    len = isotp_receive(uds_req, sizeof(uds_req));
+    if (0 == len)
+    {
+        return;
+    }
+
+    /* Truncated by isotp_receive; the handlers read up to len. */
+    if (len > UDS_BUF_SIZE)
+    {
+        isotp_send(uds_resp, uds_negative(uds_req[0], UDS_NRC_BAD_LENGTH));
+        return;
+    }
+
+    switch (uds_req[0])
+    {
+        case UDS_SID_READ_DID:
+            len = uds_read_did(uds_req, len);
+        break;
+
+        case UDS_SID_READ_PERIODIC:
+            len = uds_read_periodic(uds_req, len);
+        break;
+
+        default:
+            len = uds_negative(uds_req[0], UDS_NRC_SERVICE_NOT_SUPP);
+        break;
+    }
+
+    isotp_send(uds_resp, len);
+} /* End of function uds_poll(). */
+
+
+/*******************************************************************************
+* Function name: uds_tick
+* Description  : Periodic DID scheduler. Called from the 1 ms tick ISR. Sends
+*                at most one due DID per tick, round robin, as a single frame: 
+*                periodic DID low byte, then the data.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void uds_tick(void)
+{
+    const uds_did_t *   p_did;
+    can_frame_t         frame;
+    uint8_t             i;
+    uint8_t             idx;
+
+    for (i = 0; i < uds_nr_periodic; i++)
+    {
+        if (0 == --uds_periodic[i].left_ms)
+        {
+            uds_periodic[i].left_ms = uds_periodic[i].period_ms;
+            uds_periodic_pending |= (1UL << i);
+        }
+    }
+
+    if (0 == uds_periodic_pending)
+    {
+        return;
+    }
+
+    for (i = 0; i < uds_nr_periodic; i++)
+    {
+        idx = (uint8_t)((uds_periodic_next + i) % uds_nr_periodic);
+
+        if (uds_periodic_pending & (1UL << idx))
+        {
+            uds_periodic_pending &= ~(1UL << idx);
+            uds_periodic_next = idx + 1;
+
+            p_did = &uds_did_tbl[uds_periodic[idx].did_tbl_idx];
+            frame.id = UDS_PERIODIC_ID;
+            frame.dlc = p_did->len + 1;
+            frame.data[0] = (uint8_t)p_did->did;
+            p_did->read(&frame.data[1]);
+
+            diag_id_t::tx_set(CH_0, CANBOX_UDS_PERIODIC, &frame, DATA_FRAME);
+            break;
+        }
+    }
+} /* End of function uds_tick(). */
+
+
+/*******************************************************************************
+* Function name: uds_read_did
+* Description  : 0x22 ReadDataByIdentifier. Request: SID, DID, [DID ...].
+*                Response: SID + 0x40, DID, data, [DID, data ...].
+* Arguments    : p_req, len -
+*                   Request.
+* Return value : Response length.
+*******************************************************************************/
+static uint16_t uds_read_did(const uint8_t * p_req, uint16_t len)
+{
+    const uds_did_t *   p_did;
+    uint16_t            resp_len = 1;
+    uint16_t            did;
+    uint16_t            i;
+    int8_t              idx;
+
+    if ((len < 3) || (0 == (len & 1)))
+    {
+        return uds_negative(UDS_SID_READ_DID, UDS_NRC_BAD_LENGTH);
+    }
+
+    uds_resp[0] = UDS_SID_READ_DID + UDS_POSITIVE_RESPONSE;
+
+    for (i = 1; i < len; i += 2)
+    {
+        did = ((uint16_t)p_req[i] << 8) | p_req[i + 1];
+        idx = uds_find_did(did);
+
+        if (idx < 0)
+        {
+            return uds_negative(UDS_SID_READ_DID, UDS_NRC_OUT_OF_RANGE);
+        }
+
+        p_did = &uds_did_tbl[idx];
+        if ((resp_len + 2 + p_did->len) > UDS_BUF_SIZE)
+        {
+            return uds_negative(UDS_SID_READ_DID, UDS_NRC_BAD_LENGTH);
+        }
+
+        uds_resp[resp_len++] = (uint8_t)(did >> 8);
+        uds_resp[resp_len++] = (uint8_t)did;
+        p_did->read(&uds_resp[resp_len]);
+        resp_len += p_did->len;
+    }
+
+    return resp_len;
+} /* End of function uds_read_did(). */
+
+
+/*******************************************************************************
+* Function name: uds_read_periodic
+* Description  : 0x2A ReadDataByPeriodicIdentifier. Request: SID, mode, 
+*                [periodic DID ...]. Mode 1-3 adds the DIDs at that rate, or
+*                changes their rate. Mode 4 stops the listed DIDs, or all if
+*                none are listed. Response: SID + 0x40.
+* Arguments    : p_req, len -
+*                   Request.
+* Return value : Response length.
+*******************************************************************************/
+static uint16_t uds_read_periodic(const uint8_t * p_req, uint16_t len)
+{
+    uds_periodic_t  sched[UDS_MAX_PERIODIC];
+    uint8_t         nr_sched;
+    uint16_t        period_ms;
+    uint16_t        i;
+    uint8_t         j;
+    int8_t          idx;
+
+    if (len < 2)
+    {
+        return uds_negative(UDS_SID_READ_PERIODIC, UDS_NRC_BAD_LENGTH);
+    }
+
+    switch (p_req[1])
+    {
+        case UDS_RATE_SLOW:     period_ms = UDS_PERIOD_SLOW_MS;     break;
+        case UDS_RATE_MEDIUM:   period_ms = UDS_PERIOD_MEDIUM_MS;   break;
+        case UDS_RATE_FAST:     period_ms = UDS_PERIOD_FAST_MS;     break;
+        case UDS_RATE_STOP:     period_ms = 0;                      break;
+        default:
+            return uds_negative(UDS_SID_READ_PERIODIC, UDS_NRC_OUT_OF_RANGE);
+    }
+
+    if ((period_ms != 0) && (len < 3))
+    {
+        return uds_negative(UDS_SID_READ_PERIODIC, UDS_NRC_BAD_LENGTH);
+    }
+
+    /* Work on a copy, then swap it in with the tick masked. */
+    memcpy(sched, uds_periodic, sizeof(sched));
+    nr_sched = uds_nr_periodic;
+
+    if ((0 == period_ms) && (2 == len))
+    {
+        nr_sched = 0;
+    }
+
+    for (i = 2; i < len; i++)
+    {
+        idx = uds_find_did(UDS_DID_PERIODIC_BASE | p_req[i]);
+        if (idx < 0)
+        {
+            return uds_negative(UDS_SID_READ_PERIODIC, UDS_NRC_OUT_OF_RANGE);
+        }
+
+        /* Drop it if already scheduled. */
+        for (j = 0; j < nr_sched; j++)
+        {
+            if (sched[j].did_tbl_idx == (uint8_t)idx)
+            {
+                sched[j] = sched[--nr_sched];
+                break;
+            }
+        }
+
+        if (period_ms != 0)
+        {
+            if (nr_sched >= UDS_MAX_PERIODIC)
+            {
+                return uds_negative(UDS_SID_READ_PERIODIC, UDS_NRC_OUT_OF_RANGE);
+            }
+            sched[nr_sched].did_tbl_idx = (uint8_t)idx;
+            sched[nr_sched].period_ms = period_ms;
+            sched[nr_sched].left_ms = 1;
+            nr_sched++;
+        }
+    }
+
+    IEN(CMT3, CMI3) = 0;
+    memcpy(uds_periodic, sched, sizeof(sched));
+    uds_nr_periodic = nr_sched;
+    uds_periodic_pending = 0;
+    uds_periodic_next = 0;
+    IEN(CMT3, CMI3) = 1;
+
+    uds_resp[0] = UDS_SID_READ_PERIODIC + UDS_POSITIVE_RESPONSE;
+    return 1;
+} /* End of function uds_read_periodic(). */
+
+
+/*******************************************************************************
+* Function name: uds_negative
+* Description  : Build a negative response.
+* Arguments    : sid -
+*                   Service of the request.
+*                nrc -
+*                   Negative response code.
+* Return value : Response length.
+*******************************************************************************/
+static uint16_t uds_negative(uint8_t sid, uint8_t nrc)
+{
+    uds_resp[0] = UDS_NEGATIVE_RESPONSE;
+    uds_resp[1] = sid;
+    uds_resp[2] = nrc;
+
+    return 3;
+} /* End of function uds_negative(). */
+
+
+/*******************************************************************************
+* Function name: uds_find_did
+* Description  : Look up a data identifier.
+* Argument     : did -
+*                   Data identifier.
+* Return value : Index in uds_did_tbl, -1 if not supported.
+*******************************************************************************/
+static int8_t uds_find_did(uint16_t did)
+{
+    uint8_t i;
+
+    for (i = 0; i < UDS_NR_DIDS; i++)
+    {
+        if (uds_did_tbl[i].did == did)
+        {
+            return (int8_t)i;
+        }
+    }
+
+    return -1;
+} /* End of function uds_find_did(). */
+
+
+/*******************************************************************************
+* DID read functions. Each writes exactly the length given in uds_did_tbl.
+* They run in main loop and tick context, so only cached values and plain 
+* register reads are used here, no I2C transfers.
+*******************************************************************************/
+static void uds_read_adc(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)(adc_raw >> 8);
+    p_dest[1] = (uint8_t)adc_raw;
+    p_dest[2] = (uint8_t)adc_result;
+}
+
+static void uds_read_inputs(uint8_t * p_dest)
+{
+    p_dest[0] = g_input_image;
+}
+
+static void uds_read_temperature(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)((int16_t)temperature >> 8);
+    p_dest[1] = (uint8_t)temperature;
+}
+
+static void uds_read_accel(uint8_t * p_dest)
+{
+    int16_t xyz[3];
+    uint8_t i;
+
+    accel_get_xyz(xyz);
+    for (i = 0; i < 3; i++)
+    {
+        p_dest[2 * i] = (uint8_t)(xyz[i] >> 8);
+        p_dest[2 * i + 1] = (uint8_t)xyz[i];
+    }
+}
+
+static void uds_read_can_errors(uint8_t * p_dest)
+{
+    get_can_err_info(CH_0, p_dest);
+}
+
+static void uds_read_bus_stats(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)(can_nr_rx_frames >> 8);
+    p_dest[1] = (uint8_t)can_nr_rx_frames;
+    p_dest[2] = (uint8_t)(can_nr_tx_frames >> 8);
+    p_dest[3] = (uint8_t)can_nr_tx_frames;
+    p_dest[4] = (uint8_t)(can_rx_nr_overflow >> 8);
+    p_dest[5] = (uint8_t)can_rx_nr_overflow;
+}
+
+static void uds_read_boot_time(uint8_t * p_dest)
+{
+    uint32_t t_us = boot_time_to_first_frame_us();
+
+    p_dest[0] = (uint8_t)(t_us >> 24);
+    p_dest[1] = (uint8_t)(t_us >> 16);
+    p_dest[2] = (uint8_t)(t_us >> 8);
+    p_dest[3] = (uint8_t)t_us;
+}
+
+#endif /* USE_CAN_POLL == 0 */
+
+
+
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_status_mux.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Multiplexed status frame. data[7] selects which signal group
+*                 data[0..5] carries, so one CAN ID and one mailbox deliver 
+*                 more signals than fit in 8 bytes:
+*                   0 legacy: ADC level, engine, fuel, traction, temp, accident
+*                   1 accelerometer X, Y, Z
+*                   2 temperature now, min, max (0.1 degC)
+*                   3 ADC raw now, min, max
+*                   4 TEC, REC, bus status, error count, Rx overruns
+*                 Group 0 goes out every other frame, at half the former rate.
+*                 Receivers that only know the original layout must drop 
+*                 frames with data[7] 1..4. Nodes without the multiplexor 
+*                 send 0x77 in data[7]; values outside 1..4 are taken as the
+*                 original layout. Multi-byte values are 16 bit, big endian.
+*                 data[6] is reserved.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define STATUS_MUX_BYTE         7
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Transmit order. */
+static const uint8_t status_mux_schedule[] =
+{
+    STATUS_MUX_LEGACY, STATUS_MUX_ACCEL,
+    STATUS_MUX_LEGACY, STATUS_MUX_TEMPERATURE,
+    STATUS_MUX_LEGACY, STATUS_MUX_ADC,
+    STATUS_MUX_LEGACY, STATUS_MUX_ERRORS
+};
+#define STATUS_MUX_SCHEDULE_LEN (sizeof(status_mux_schedule) / sizeof(status_mux_schedule[0]))
+
+static uint8_t      status_mux_slot;
+static can_frame_t  status_mux_frame;
+
+/* Own extremes since reset. */
+static int16_t      temp_min, temp_max;
+static uint8_t      temp_valid;
+static uint16_t     adc_min = 0xFFFF, adc_max;
+
+/* Last values received from the other node, per group. */
+typedef struct
+{
+    int16_t     accel[3];
+    int16_t     temp[3];
+    uint16_t    adc[3];
+    uint8_t     err[4];
+    uint16_t    rx_overruns;
+    uint8_t     groups_seen;        /* Bit per multiplexor value. */
+} status_mux_rx_t;
+
+status_mux_rx_t     g_status_mux_rx;
+
+/* Data sources in other files. */
+extern int          temperature;
+extern uint16_t     adc_raw;
+extern uint32_t     can_rx_nr_overflow;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void     put_be16(uint8_t * p_dest, uint16_t value);
+static uint16_t get_be16(const uint8_t * p_src);
+
+
+/*******************************************************************************
+* Function name: status_mux_next
+* Description  : Build the next status frame of the schedule.
+* Arguments    : p_legacy -
+*                    The status frame in the original layout; ID and group 0.
+* Return value : Frame to send. Valid until the next call.
+*******************************************************************************/
+const can_frame_t * status_mux_next(const can_frame_t * p_legacy)
+{
+    uint8_t     mux;
+    int16_t     xyz[3];
+    uint8_t     i;
+
+    mux = status_mux_schedule[status_mux_slot];
+    if (++status_mux_slot >= STATUS_MUX_SCHEDULE_LEN)
+    {
+        status_mux_slot = 0;
+    }
+
+    status_mux_frame = *p_legacy;
+    status_mux_frame.dlc = 8;
+    status_mux_frame.data[6] = 0;
+    status_mux_frame.data[STATUS_MUX_BYTE] = mux;
+
+    /* ADC extremes follow every sample the main loop took. */
+    if (adc_raw < adc_min)
+    {
+        adc_min = adc_raw;
+    }
+    if (adc_raw > adc_max)
+    {
+        adc_max = adc_raw;
+    }
+
+    switch (mux)
+    {
+        case STATUS_MUX_ACCEL:
+            accel_get_xyz(xyz);
+            for (i = 0; i < 3; i++)
+            {
+                put_be16(&status_mux_frame.data[2 * i], (uint16_t)xyz[i]);
+            }
+        break;
+
+        case STATUS_MUX_TEMPERATURE:
+            put_be16(&status_mux_frame.data[0], (uint16_t)temperature);
+            put_be16(&status_mux_frame.data[2], (uint16_t)(temp_valid ? temp_min : temperature));
+            put_be16(&status_mux_frame.data[4], (uint16_t)(temp_valid ? temp_max : temperature));
+        break;
+
+        case STATUS_MUX_ADC:
+            put_be16(&status_mux_frame.data[0], adc_raw);
+            put_be16(&status_mux_frame.data[2], adc_min);
+            put_be16(&status_mux_frame.data[4], adc_max);
+        break;
+
+        case STATUS_MUX_ERRORS:
+            get_can_err_info(CH_0, &status_mux_frame.data[0]);
+            put_be16(&status_mux_frame.data[4], (uint16_t)can_rx_nr_overflow);
+        break;
+
+        default:
+        break;
+    }
+
+    return &status_mux_frame;
+} /* End of function status_mux_next(). */
+
+
+/*******************************************************************************
+* Function name: status_mux_receive
+* Description  : Store a received multiplexed status frame in g_status_mux_rx.
+*                Group 0 is handled by the main loop.
+* Arguments    : p_frame -
+*                    Received frame, 8 bytes.
+* Return value : none
+*******************************************************************************/
+void status_mux_receive(const can_frame_t * p_frame)
+{
+    uint8_t     mux = p_frame->data[STATUS_MUX_BYTE];
+    uint8_t     i;
+
+    switch (mux)
+    {
+        case STATUS_MUX_ACCEL:
+            for (i = 0; i < 3; i++)
+            {
+                g_status_mux_rx.accel[i] = (int16_t)get_be16(&p_frame->data[2 * i]);
+            }
+        break;
+
+        case STATUS_MUX_TEMPERATURE:
+            for (i = 0; i < 3; i++)
+            {
+                g_status_mux_rx.temp[i] = (int16_t)get_be16(&p_frame->data[2 * i]);
+            }
+        break;
+
+        case STATUS_MUX_ADC:
+            for (i = 0; i < 3; i++)
+            {
+                g_status_mux_rx.adc[i] = get_be16(&p_frame->data[2 * i]);
+            }
+        break;
+
+        case STATUS_MUX_ERRORS:
+            memcpy(g_status_mux_rx.err, p_frame->data, 4);
+            g_status_mux_rx.rx_overruns = get_be16(&p_frame->data[4]);
+        break;
+
+        default:
+            /* Original layout, handled by the main loop. */
+            return;
+    }
+
+    g_status_mux_rx.groups_seen |= (uint8_t)(1 << mux);
+} /* End of function status_mux_receive(). */
+
+
+/*******************************************************************************
+* Function name: status_mux_note_temperature
+* Description  : Track temperature extremes. Called on each sensor reading.
+* Arguments    : temp -
+*                    Temperature, 0.1 degC.
+* Return value : none
+*******************************************************************************/
+void status_mux_note_temperature(int16_t temp)
+{
+    if (!temp_valid)
+    {
+        temp_min = temp;
+        temp_max = temp;
+        temp_valid = 1;
+    }
+    else if (temp < temp_min)
+    {
+        temp_min = temp;
+    }
+    else if (temp > temp_max)
+    {
+        temp_max = temp;
+    }
+} /* End of function status_mux_note_temperature(). */
+
+
+static void put_be16(uint8_t * p_dest, uint16_t value)
+{
+    p_dest[0] = (uint8_t)(value >> 8);
+    p_dest[1] = (uint8_t)value;
+}
+
+static uint16_t get_be16(const uint8_t * p_src)
+{
+    return (uint16_t)((p_src[0] << 8) | p_src[1]);
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_accel_stream.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Compressed accelerometer stream on ACCEL_STREAM_ID. Every 
+*                 sample is buffered and sent, packed as many per frame as fit:
+*                 Keyframe:   data[0] = 0x80 | seq, data[1..6] = X, Y, Z 
+*                             (signed 16 bit, big endian). DLC 7.
+*                 Delta frame: data[0] = seq, data[1] = width << 4 | count,
+*                             data[2..] = count samples of X, Y, Z deltas to 
+*                             the previous sample, zigzag coded, width bits 
+*                             each, MSB first. DLC 2 + bytes used.
+*                 seq counts frames mod 128. A keyframe goes out every 
+*                 ACCEL_KEY_INTERVAL frames, so a receiver that joins late or 
+*                 loses a frame (seq gap) resyncs on the next one. 
+*                 The encoder picks the widest delta of the samples it packs; 
+*                 a quiet signal at width 2 gives 8 samples per frame against 
+*                 one raw. The decoder is in CAN Host Tools.cpp.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define ACCEL_RING_SIZE         32      /* Samples. Power of 2. */
+#define ACCEL_KEY_INTERVAL      32      /* Frames between keyframes. */
+#define ACCEL_KEY_FLAG          0x80
+#define ACCEL_SEQ_MASK          0x7F
+#define ACCEL_MAX_WIDTH         15      /* Wider deltas need a keyframe. */
+#define ACCEL_MAX_COUNT         15
+#define ACCEL_PAYLOAD_BITS      48      /* data[2..7]. */
+
+#define ACCEL_BENCH_SAMPLES     256
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef struct
+{
+    int16_t     prev[3];                /* Last sample sent. */
+    uint8_t     seq;
+    uint8_t     frames_to_key;          /* 0: next frame is a keyframe. */
+} accel_enc_t;
+
+/* Filled by the accelerometer callback, drained by the main loop. */
+static int16_t          accel_ring[ACCEL_RING_SIZE][3];
+static volatile uint8_t accel_ring_head;
+static volatile uint8_t accel_ring_tail;
+uint32_t                accel_nr_dropped = 0;
+
+static accel_enc_t      accel_enc;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint8_t  accel_codec_encode(accel_enc_t * p_enc, const int16_t (* p_xyz)[3], 
+                                   uint8_t nr_avail, can_frame_t * p_frame);
+static uint16_t zigzag16(int16_t value);
+static uint8_t  bit_width16(uint16_t value);
+
+
+/*******************************************************************************
+* Function name: accel_stream_put
+* Description  : Queue one sample. Drops it when the ring is full.
+* Arguments    : p_xyz -
+*                    X, Y, Z.
+* Return value : none
+*******************************************************************************/
+void accel_stream_put(const int16_t * p_xyz)
+{
+    int16_t * p_slot;
+
+    if ((uint8_t)(accel_ring_head - accel_ring_tail) >= ACCEL_RING_SIZE)
+    {
+        accel_nr_dropped++;
+        return;
+    }
+
+    p_slot = accel_ring[accel_ring_head & (ACCEL_RING_SIZE - 1)];
+    p_slot[0] = p_xyz[0];
+    p_slot[1] = p_xyz[1];
+    p_slot[2] = p_xyz[2];
+    accel_ring_head++;
+} /* End of function accel_stream_put(). */
+
+
+/*******************************************************************************
+* Function name: accel_stream_poll
+* Description  : Pack waiting samples into one frame if the stream mailbox is 
+*                free. Called from the main loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void accel_stream_poll(void)
+{
+    int16_t     samples[ACCEL_MAX_COUNT][3];
+    can_frame_t frame;
+    uint8_t     nr_avail;
+    uint8_t     i;
+    uint8_t     tail;
+
+    /* Previous frame still pending? */
+    if (CAN0.MCTL[CANBOX_ACCEL_STREAM].BIT.TX.TRMREQ && 
+        (0 == CAN0.MCTL[CANBOX_ACCEL_STREAM].BIT.TX.SENTDATA))
+    {
+        return;
+    }
+
+    nr_avail = (uint8_t)(accel_ring_head - accel_ring_tail);
+    if (0 == nr_avail)
+    {
+        return;
+    }
+    if (nr_avail > ACCEL_MAX_COUNT)
+    {
+        nr_avail = ACCEL_MAX_COUNT;
+    }
+
+    /* Straighten out the ring wrap for the encoder. */
+    tail = accel_ring_tail;
+    for (i = 0; i < nr_avail; i++)
+    {
+        memcpy(samples[i], accel_ring[(uint8_t)(tail + i) & (ACCEL_RING_SIZE - 1)], sizeof(samples[i]));
+    }
+
+    frame.id = ACCEL_STREAM_ID;
+    accel_ring_tail = (uint8_t)(tail + accel_codec_encode(&accel_enc, samples, nr_avail, &frame));
+
+    app_id_t::tx_set(CH_0, CANBOX_ACCEL_STREAM, &frame, DATA_FRAME);
+} /* End of function accel_stream_poll(). */
+
+
+/*******************************************************************************
+* Function name: accel_codec_encode
+* Description  : Encode the next frame of the stream.
+* Arguments    : p_enc -
+*                    Encoder state.
+*                p_xyz -
+*                    Samples waiting, oldest first.
+*                nr_avail -
+*                    Number of samples waiting, 1-ACCEL_MAX_COUNT.
+*                p_frame -
+*                    Gets data and dlc.
+* Return value : Number of samples encoded.
+*******************************************************************************/
+static uint8_t accel_codec_encode(accel_enc_t * p_enc, const int16_t (* p_xyz)[3], 
+                                  uint8_t nr_avail, can_frame_t * p_frame)
+{
+    uint16_t    zz[ACCEL_MAX_COUNT][3];
+    const int16_t * p_prev;
+    uint8_t     width = 0;
+    uint8_t     w;
+    uint8_t     count;
+    uint8_t     axis;
+    uint8_t     i;
+    uint32_t    acc = 0;
+    uint8_t     acc_bits = 0;
+    uint8_t     out = 2;
+
+    /* Take samples while the widest delta so far still fits them all. */
+    count = 0;
+    if (p_enc->frames_to_key != 0)
+    {
+        p_prev = p_enc->prev;
+        while (count < nr_avail)
+        {
+            w = width;
+            for (axis = 0; axis < 3; axis++)
+            {
+                zz[count][axis] = zigzag16((int16_t)(p_xyz[count][axis] - p_prev[axis]));
+                if (bit_width16(zz[count][axis]) > w)
+                {
+                    w = bit_width16(zz[count][axis]);
+                }
+            }
+            if ((w > ACCEL_MAX_WIDTH) || 
+                ((uint16_t)3 * w * (count + 1) > ACCEL_PAYLOAD_BITS))
+            {
+                break;
+            }
+            width = w;
+            p_prev = p_xyz[count];
+            count++;
+        }
+    }
+
+    /* Keyframe: due, or the first delta does not fit. */
+    if (0 == count)
+    {
+        p_frame->data[0] = ACCEL_KEY_FLAG | p_enc->seq;
+        for (axis = 0; axis < 3; axis++)
+        {
+            p_frame->data[1 + 2 * axis] = (uint8_t)((uint16_t)p_xyz[0][axis] >> 8);
+            p_frame->data[2 + 2 * axis] = (uint8_t)p_xyz[0][axis];
+            p_enc->prev[axis] = p_xyz[0][axis];
+        }
+        p_frame->dlc = 7;
+        p_enc->seq = (p_enc->seq + 1) & ACCEL_SEQ_MASK;
+        p_enc->frames_to_key = ACCEL_KEY_INTERVAL - 1;
+        return 1;
+    }
+
+    p_frame->data[0] = p_enc->seq;
+    p_frame->data[1] = (uint8_t)((width << 4) | count);
+
+    /* Pack MSB first. At most 15 + 7 bits are held. */
+    for (i = 0; i < count; i++)
+    {
+        for (axis = 0; axis < 3; axis++)
+        {
+            acc = (acc << width) | zz[i][axis];
+            acc_bits += width;
+            while (acc_bits >= 8)
+            {
+                acc_bits -= 8;
+                p_frame->data[out++] = (uint8_t)(acc >> acc_bits);
+            }
+        }
+    }
+    if (acc_bits != 0)
+    {
+        p_frame->data[out++] = (uint8_t)(acc << (8 - acc_bits));
+    }
+    p_frame->dlc = out;
+
+    for (axis = 0; axis < 3; axis++)
+    {
+        p_enc->prev[axis] = p_xyz[count - 1][axis];
+    }
+    p_enc->seq = (p_enc->seq + 1) & ACCEL_SEQ_MASK;
+    p_enc->frames_to_key--;
+
+    return count;
+} /* End of function accel_codec_encode(). */
+
+
+/* Map signed to unsigned so small magnitudes of either sign have few bits. */
+static uint16_t zigzag16(int16_t value)
+{
+    return (uint16_t)(((uint16_t)value << 1) ^ (uint16_t)(value >> 15));
+}
+
+static uint8_t bit_width16(uint16_t value)
+{
+    uint8_t width = 0;
+
+    while (value != 0)
+    {
+        value >>= 1;
+        width++;
+    }
+    return width;
+}
+
+
+#if DEMO_ACCEL_CODEC_BENCH
+/*******************************************************************************
+* Function name: accel_codec_benchmark
+* Description  : Encode a synthetic accelerometer trace (slow tilt, sensor 
+*                noise, one shock) and report cost and compression on the 
+*                debug port. Cost is in PCLK cycles per sample from the bench 
+*                timer; ICLK runs at twice that.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void accel_codec_benchmark(void)
+{
+    static int16_t  trace[ACCEL_BENCH_SAMPLES][3];
+    accel_enc_t     enc = {{0, 0, 0}, 0, 0};
+    can_frame_t     frame;
+    uint32_t        lcg = 12345;
+    uint32_t        nr_bytes = 0;
+    uint16_t        nr_frames = 0;
+    uint16_t        t_start;
+    uint16_t        t_total = 0;
+    uint16_t        i;
+    uint8_t         n;
+
+    for (i = 0; i < ACCEL_BENCH_SAMPLES; i++)
+    {
+        lcg = lcg * 1103515245UL + 12345;
+        trace[i][0] = (int16_t)((i & 0x7F) - 64 + ((lcg >> 16) & 3));   /* Tilt. */
+        trace[i][1] = (int16_t)(20 + ((lcg >> 20) & 3));
+        trace[i][2] = (int16_t)(256 + ((lcg >> 24) & 1));               /* 1 g. */
+        if ((i >= 128) && (i < 132))
+        {
+            trace[i][1] += 400;                                         /* Shock. */
+        }
+    }
+
+    bench_timer_init();
+
+    i = 0;
+    while (i < ACCEL_BENCH_SAMPLES)
+    {
+        n = (ACCEL_BENCH_SAMPLES - i > ACCEL_MAX_COUNT) ? ACCEL_MAX_COUNT : (uint8_t)(ACCEL_BENCH_SAMPLES - i);
+
+        t_start = bench_timer_read();
+        n = accel_codec_encode(&enc, &trace[i], n, &frame);
+        t_total += (uint16_t)(bench_timer_read() - t_start);
+
+        nr_bytes += frame.dlc;
+        nr_frames++;
+        i += n;
+    }
+
+    printf("\naccel codec: %u samples, %u frames, %lu bytes (raw %u), %u.%02u samples/frame",
+           ACCEL_BENCH_SAMPLES, nr_frames, nr_bytes, ACCEL_BENCH_SAMPLES * 6, 
+           ACCEL_BENCH_SAMPLES / nr_frames, (ACCEL_BENCH_SAMPLES * 100 / nr_frames) % 100);
+    printf("\naccel codec: %lu PCLK cycles/sample", 
+           (uint32_t)t_total * 8 / ACCEL_BENCH_SAMPLES);
+} /* End of function accel_codec_benchmark(). */
+#endif /* DEMO_ACCEL_CODEC_BENCH */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : accel_cal_store.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Accelerometer calibration record in data flash block DB0:
+*                 zero offsets, self-test readings and result, with a format 
+*                 version and CRC-16 (CCITT). Lets accelerometer_init skip the
+*                 boot averaging and self-test. 
+*                 Erased data flash reads back undefined on this part, so a 
+*                 record is only trusted on magic, version and CRC.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "r_flash_api_rx_if.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define ACCEL_CAL_MAGIC         0xACCA
+#define ACCEL_CAL_VERSION       1       /* Bump when the record changes. */
+#define ACCEL_CAL_BLOCK         BLOCK_DB0
+#define ACCEL_CAL_ADDR          0x00100000UL    /* Start of DB0. */
+#define ACCEL_CAL_DF_ALL        0xFFFF  /* Access mask, all data flash blocks. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Even size, the data flash programs 2 bytes at a time. */
+typedef struct
+{
+    uint16_t    magic;
+    uint8_t     version;
+    uint8_t     selftest_ok;
+    int16_t     zero[3];
+    int16_t     selftest[3];
+    uint16_t    crc;                    /* Over all of the above. */
+} accel_cal_rec_t;
+
+/* Record waiting for accel_cal_poll. Set from the accelerometer callback. */
+static accel_cal_rec_t      accel_cal_next;
+static volatile uint8_t     accel_cal_pending;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint16_t crc16_ccitt(const uint8_t * p_data, uint16_t len);
+static bool     cal_flash_read(accel_cal_rec_t * p_rec);
+static bool     cal_flash_write(const accel_cal_rec_t * p_rec);
+
+
+/*******************************************************************************
+* Function name: accel_cal_load
+* Description  : Read the calibration record.
+* Arguments    : p_zero -
+*                    Gets X, Y, Z zero readings.
+*                p_selftest -
+*                    Gets X, Y, Z normalized self-test readings.
+*                p_selftest_ok -
+*                    Gets the self-test result.
+* Return value : true if a valid record of this version was found.
+*******************************************************************************/
+bool accel_cal_load(int16_t * p_zero, int16_t * p_selftest, bool * p_selftest_ok)
+{
+    accel_cal_rec_t rec;
+
+    if (!cal_flash_read(&rec) ||
+        (rec.magic != ACCEL_CAL_MAGIC) ||
+        (rec.version != ACCEL_CAL_VERSION) ||
+        (rec.crc != crc16_ccitt((const uint8_t *)&rec, offsetof(accel_cal_rec_t, crc))))
+    {
+        return false;
+    }
+
+    memcpy(p_zero, rec.zero, sizeof(rec.zero));
+    memcpy(p_selftest, rec.selftest, sizeof(rec.selftest));
+    *p_selftest_ok = (rec.selftest_ok != 0);
+    return true;
+} /* End of function accel_cal_load(). */
+
+
+/*******************************************************************************
+* Function name: accel_cal_save
+* Description  : Queue a calibration for writing by accel_cal_poll. Does not
+*                touch the flash, so it is safe from the accelerometer callback.
+* Arguments    : p_zero -
+*                    X, Y, Z zero readings.
+*                p_selftest -
+*                    X, Y, Z normalized self-test readings.
+*                selftest_ok -
+*                    Self-test result.
+* Return value : none
+*******************************************************************************/
+void accel_cal_save(const int16_t * p_zero, const int16_t * p_selftest, bool selftest_ok)
+{
+    accel_cal_next.magic = ACCEL_CAL_MAGIC;
+    accel_cal_next.version = ACCEL_CAL_VERSION;
+    accel_cal_next.selftest_ok = selftest_ok ? 1 : 0;
+    memcpy(accel_cal_next.zero, p_zero, sizeof(accel_cal_next.zero));
+    memcpy(accel_cal_next.selftest, p_selftest, sizeof(accel_cal_next.selftest));
+    accel_cal_next.crc = crc16_ccitt((const uint8_t *)&accel_cal_next, offsetof(accel_cal_rec_t, crc));
+    accel_cal_pending = 1;
+} /* End of function accel_cal_save(). */
+
+
+/*******************************************************************************
+* Function name: accel_cal_poll
+* Description  : Write a queued calibration to data flash. Called from the 
+*                main loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void accel_cal_poll(void)
+{
+    accel_cal_rec_t rec;
+
+    if (0 == accel_cal_pending)
+    {
+        return;
+    }
+
+    /* The callback may queue a newer record while this copies. */
+    do
+    {
+        accel_cal_pending = 0;
+        rec = accel_cal_next;
+    } while (accel_cal_pending);
+
+    if (!cal_flash_write(&rec))
+    {
+        /* Next boot calibrates the slow way. */
+        printf("\naccel calibration not saved");
+    }
+} /* End of function accel_cal_poll(). */
+
+
+static uint16_t crc16_ccitt(const uint8_t * p_data, uint16_t len)
+{
+    uint16_t    crc = 0xFFFF;
+    uint8_t     bit;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*p_data++ << 8);
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+
+static bool cal_flash_read(accel_cal_rec_t * p_rec)
+{
+    R_FlashDataAreaAccess(ACCEL_CAL_DF_ALL, 0);
+    memcpy(p_rec, (const void *)ACCEL_CAL_ADDR, sizeof(*p_rec));
+    return true;
+}
+
+static bool cal_flash_write(const accel_cal_rec_t * p_rec)
+{
+    bool ok;
+
+    R_FlashDataAreaAccess(ACCEL_CAL_DF_ALL, ACCEL_CAL_DF_ALL);
+    ok = (FLASH_SUCCESS == R_FlashErase(ACCEL_CAL_BLOCK)) &&
+         (FLASH_SUCCESS == R_FlashWrite(ACCEL_CAL_ADDR, (uint32_t)p_rec, sizeof(*p_rec)));
+    R_FlashDataAreaAccess(ACCEL_CAL_DF_ALL, 0);
+    return ok;
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : boot_seq.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Boot profile and init sequencer. can_api_demo stamps each 
+*                 boot phase with sys_time_us. The sensor I2C setup, which 
+*                 does not depend on CAN, runs as steps while the startup 
+*                 burst frames are on the bus instead of after the burst.
+*                 After the first boot the phase times and the time to first
+*                 frame go to the debug port; the latter is also UDS DID 
+*                 0xF206. Times count from sys_tick_init.
+*                 The RIIC must be initialized before can_api_demo. The later
+*                 sensor init calls in the startup code then return at once.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <machine.h>
+#include "platform.h"
+#include "r_riic_rx600.h"
+#include "thermal_sensor_demo.h"
+#include "accelerometer_demo.h"
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+typedef void (* boot_step_fn_t)(void);
+
+static void boot_accel_init(void);
+static void boot_thermal_init(void);
+static void boot_adc_init(void);
+
+/* Init work that does not depend on CAN, in order. */
+static const boot_step_fn_t boot_steps[] =
+{
+    inputs_init,
+    rtc_timebase_init,
+    boot_accel_init,
+    boot_thermal_init,
+    boot_adc_init
+};
+#define BOOT_NR_STEPS   (sizeof(boot_steps) / sizeof(boot_steps[0]))
+
+static const char * const boot_phase_names[BOOT_NR_PHASES] =
+{
+    "tick started",
+    "CAN created",
+    "CAN port set",
+    "CAN operate",
+    "first frame",
+    "accel ready",
+    "thermal ready",
+    "ADC ready",
+    "burst done",
+    "boot done"
+};
+
+/* Phase times, us. Kept from the first boot only. */
+static uint32_t     boot_time_us[BOOT_NR_PHASES];
+static uint8_t      boot_next_step;
+static bool         boot_complete = false;
+
+
+/*******************************************************************************
+* Function name: boot_mark
+* Description  : Record the time a boot phase ended. No effect after the first
+*                boot, as can_api_demo runs its start up again on every call.
+* Arguments    : phase -
+*                    Phase that ended.
+* Return value : none
+*******************************************************************************/
+void boot_mark(boot_phase_t phase)
+{
+    if (!boot_complete)
+    {
+        boot_time_us[phase] = sys_time_us();
+    }
+} /* End of function boot_mark(). */
+
+
+/*******************************************************************************
+* Function name: boot_run_step
+* Description  : Run the next init step, if any. Called while a frame is being 
+*                sent so the step overlaps the CAN transmission.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void boot_run_step(void)
+{
+    if (boot_complete || (boot_next_step >= BOOT_NR_STEPS))
+    {
+        return;
+    }
+
+    boot_steps[boot_next_step++]();
+} /* End of function boot_run_step(). */
+
+
+/*******************************************************************************
+* Function name: boot_finish
+* Description  : Run the steps that found no frame to overlap, then report the
+*                boot profile on the debug port. Once only.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void boot_finish(void)
+{
+    uint8_t     phase;
+
+    if (boot_complete)
+    {
+        return;
+    }
+
+    while (boot_next_step < BOOT_NR_STEPS)
+    {
+        boot_steps[boot_next_step++]();
+    }
+    boot_mark(BOOT_DONE);
+    boot_complete = true;
+
+    printf("\nboot profile, us since tick start (delta):");
+    for (phase = 0; phase < BOOT_NR_PHASES; phase++)
+    {
+        printf("\n  %-14s %8lu (%lu)", boot_phase_names[phase], boot_time_us[phase],
+               boot_time_us[phase] - boot_time_us[(phase > 0) ? phase - 1 : 0]);
+    }
+    printf("\ntime to first frame %lu us", boot_time_to_first_frame_us());
+} /* End of function boot_finish(). */
+
+
+/*******************************************************************************
+* Function name: boot_time_to_first_frame_us
+* Description  : Time from tick start until the first frame was on the bus.
+* Argument     : none
+* Return value : us.
+*******************************************************************************/
+uint32_t boot_time_to_first_frame_us(void)
+{
+    return boot_time_us[BOOT_FIRST_FRAME] - boot_time_us[BOOT_TICK_STARTED];
+} /* End of function boot_time_to_first_frame_us(). */
+
+
+/* Steps. The phase marks the step end; steps may run out of phase order. */
+static void boot_accel_init(void)
+{
+    accelerometer_init();
+    boot_mark(BOOT_ACCEL_READY);
+}
+
+static void boot_thermal_init(void)
+{
+    g_thermal_sensor_good = (RIIC_OK == thermal_sensor_init());
+    boot_mark(BOOT_THERMAL_READY);
+}
+
+static void boot_adc_init(void)
+{
+    adc_scan_init();
+    boot_mark(BOOT_ADC_READY);
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : adc_scan.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Battery level from AN002 without CPU work per sample. The 
+*                 S12AD scans continuously, adding 4 conversions per scan in
+*                 hardware; each scan end moves the 14-bit sum into a ring by
+*                 DMAC0 in repeat mode. The only interrupt is the DMAC end of
+*                 transfer count, about once a second, to restart it.
+*                 adc_scan_read averages the ring (64 conversions), takes the 
+*                 median of the last 3 averages against spikes, and smooths 
+*                 with a first order IIR.
+*                 battery_low_update gives the receiver a LOW/OK state with 
+*                 hysteresis on the transmitted 0-9 level.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define ADC_BATTERY_CH          2       /* AN002, P42. */
+#define ADC_RING_LEN            16      /* Scans kept. */
+#define ADC_DMA_REPEATS         1023    /* Ring passes per DMAC restart. Max 1023. */
+#define ADC_IIR_SHIFT           3       /* y += (x - y) / 8 per read. */
+
+/* S12AD. */
+#define ADCSR_ADST              0x80
+#define ADCSR_ADCS_CONT         0x40    /* Continuous scan. */
+#define ADCSR_ADIE              0x10    /* S12ADI0 at scan end, to the DMAC. */
+#define ADCSR_CKS_PCLK_8        0x00
+#define ADADC_4_TIMES           0x03
+
+/* DMAC0. */
+#define DMTMD_REPEAT_DST_16_IRQ 0x4101  /* Repeat, destination is the repeat 
+                                           area, 16 bit, interrupt trigger. */
+#define DMAMD_DST_INC           0x0080  /* Fixed source, incrementing dest. */
+#define DMINT_DTIE              0x10
+
+/* Receiver hysteresis on the 0-9 level. */
+#define BATTERY_LOW_ENTER       2       /* At or below: LOW. */
+#define BATTERY_LOW_LEAVE       4       /* At or above: OK again. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static volatile uint16_t    adc_ring[ADC_RING_LEN];
+static uint16_t             adc_block[3];       /* Last ring averages. */
+static uint8_t              adc_block_idx;
+static uint32_t             adc_iir;            /* Filter state << ADC_IIR_SHIFT. */
+static bool                 adc_iir_valid = false;
+static bool                 battery_low = false;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c);
+
+
+/*******************************************************************************
+* Function name: adc_scan_init
+* Description  : Start the continuous AN002 scan and the DMAC ring transfer. 
+*                Takes over the S12AD from the single shot S12ADC_read.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void adc_scan_init(void)
+{
+    /* Protection off, release S12AD and DMAC from module stop, protection on. */
+    SYSTEM.PRCR.WORD = 0xA502;
+    MSTP(S12AD) = 0;
+    MSTP(DMAC) = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    /* P42 as analog input. */
+    PORT4.PDR.BIT.B2 = 0;
+    PORT4.PMR.BIT.B2 = 0;
+    MPC.PWPR.BIT.B0WI = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.P42PFS.BYTE = 0x80;             /* ASEL. */
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI = 1;
+
+    S12AD.ADCSR.BYTE = 0;
+    S12AD.ADANS0.WORD = 1 << ADC_BATTERY_CH;
+    S12AD.ADADS0.WORD = 1 << ADC_BATTERY_CH;
+    S12AD.ADADC.BYTE = ADADC_4_TIMES;
+
+    /* Each scan end moves ADDR2 to the next ring slot. */
+    DMAC0.DMCNT.BIT.DTE = 0;
+    DMAC0.DMTMD.WORD = DMTMD_REPEAT_DST_16_IRQ;
+    DMAC0.DMAMD.WORD = DMAMD_DST_INC;
+    DMAC0.DMSAR = (void *)&S12AD.ADDR2;
+    DMAC0.DMDAR = (void *)adc_ring;
+    DMAC0.DMCRA = ((uint32_t)ADC_RING_LEN << 16) | ADC_RING_LEN;
+    DMAC0.DMCRB = ADC_DMA_REPEATS;
+    DMAC0.DMINT.BYTE = DMINT_DTIE;
+    ICU.DMRSR0 = VECT_S12AD_S12ADI0;
+
+    IPR(DMAC, DMAC0I) = 1;
+    IEN(DMAC, DMAC0I) = 1;
+    IEN(S12AD, S12ADI0) = 1;            /* Needed for the DMAC to see the request. */
+
+    DMAC.DMAST.BIT.DMST = 1;
+    DMAC0.DMCNT.BIT.DTE = 1;
+
+    S12AD.ADCSR.BYTE = ADCSR_ADCS_CONT | ADCSR_ADIE | ADCSR_CKS_PCLK_8;
+    S12AD.ADCSR.BYTE |= ADCSR_ADST;
+} /* End of function adc_scan_init(). */
+
+
+/*******************************************************************************
+* Function name: adc_scan_read
+* Description  : Filtered battery reading. Call regularly; the filter steps 
+*                once per call.
+* Argument     : none
+* Return value : 16-bit full scale, 0-65520. Shift right by 4 for 12 bits.
+*******************************************************************************/
+uint16_t adc_scan_read(void)
+{
+    uint32_t    sum = 0;
+    uint16_t    avg;
+    uint8_t     i;
+
+    /* 16 scans of 4 conversions: 64 x 12 bit, scaled to 16 bit. */
+    for (i = 0; i < ADC_RING_LEN; i++)
+    {
+        sum += adc_ring[i];
+    }
+    avg = (uint16_t)(sum >> 2);
+
+    if (!adc_iir_valid)
+    {
+        adc_block[0] = adc_block[1] = adc_block[2] = avg;
+        adc_iir = (uint32_t)avg << ADC_IIR_SHIFT;
+        adc_iir_valid = true;
+    }
+
+    adc_block[adc_block_idx] = avg;
+    if (++adc_block_idx >= 3)
+    {
+        adc_block_idx = 0;
+    }
+
+    avg = median3(adc_block[0], adc_block[1], adc_block[2]);
+    adc_iir += avg - (adc_iir >> ADC_IIR_SHIFT);
+
+    return (uint16_t)(adc_iir >> ADC_IIR_SHIFT);
+} /* End of function adc_scan_read(). */
+
+
+/*******************************************************************************
+* Function name: battery_low_update
+* Description  : Battery state from a received 0-9 level, with hysteresis so 
+*                a level that wavers at the threshold does not flip it.
+* Arguments    : level -
+*                    Received battery level.
+* Return value : true while the battery is low.
+*******************************************************************************/
+bool battery_low_update(uint8_t level)
+{
+    if (level <= BATTERY_LOW_ENTER)
+    {
+        battery_low = true;
+    }
+    else if (level >= BATTERY_LOW_LEAVE)
+    {
+        battery_low = false;
+    }
+    return battery_low;
+} /* End of function battery_low_update(). */
+
+
+/*****************************************************************************
+* Function name:    adc_dma_isr
+* Description  :    DMAC0 transfer count done. Restart the ring transfer.
+* Arguments    :    N/A
+* Return value :    N/A
+*****************************************************************************/
+#pragma interrupt adc_dma_isr(vect=VECT_DMAC_DMAC0I, enable)
+void adc_dma_isr(void)
+{
+    DMAC0.DMSTS.BYTE = 0;
+    DMAC0.DMCRB = ADC_DMA_REPEATS;
+    DMAC0.DMCNT.BIT.DTE = 1;
+} /* end adc_dma_isr() */
+
+
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+{
+    if (a > b)
+    {
+        uint16_t t = a; a = b; b = t;
+    }
+    /* a <= b */
+    if (c <= a)
+    {
+        return a;
+    }
+    return (c < b) ? c : b;
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : inputs.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Debounced engine, fuel and traction inputs (PA6, PA7, PC1).
+*                 The pins are sampled by the 1 ms tick; a pin must hold a new
+*                 level for INPUT_DEBOUNCE_MS samples before the input image 
+*                 changes, so contact bounce is ignored. A change sends an 
+*                 event frame from the tick at once, instead of waiting for 
+*                 the next status frame:
+*                   data[0]   input image, bits INPUT_xxx
+*                   data[1]   bits changed since the last event
+*                   data[2-5] g_tick_ms at the change, big endian
+*                   data[6]   event count, mod 256
+*                 These pins have no IRQ function, so the tick samples them
+*                 instead of pin change interrupts. Input to bus latency is
+*                 the debounce time plus at most 1 ms.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define INPUT_DEBOUNCE_MS       5
+#define INPUT_NR                3
+
+/*******************************************************************************
+Exported global variables
+*******************************************************************************/
+/* Debounced input levels, bits INPUT_xxx. */
+volatile uint8_t g_input_image = 0;
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static uint8_t      input_count[INPUT_NR];  /* Samples at a new level, per input. */
+static uint8_t      input_changed;          /* Not yet reported by an event. */
+static uint32_t     input_change_ms;
+static uint8_t      input_nr_events;
+static bool         input_ready = false;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint8_t  inputs_sample(void);
+static void     inputs_send_event(void);
+
+
+/*******************************************************************************
+* Function name: inputs_init
+* Description  : Pins to input and take their present levels as the image.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void inputs_init(void)
+{
+    PORTA.PDR.BIT.B6 = 0;
+    PORTA.PDR.BIT.B7 = 0;
+    PORTC.PDR.BIT.B1 = 0;
+
+    g_input_image = inputs_sample();
+    input_ready = true;
+} /* End of function inputs_init(). */
+
+
+/*******************************************************************************
+* Function name: inputs_tick
+* Description  : Debounce step and event frame. Called from the 1 ms tick.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void inputs_tick(void)
+{
+    uint8_t     raw;
+    uint8_t     bit;
+    uint8_t     i;
+
+    if (!input_ready)
+    {
+        return;
+    }
+
+    raw = inputs_sample();
+
+    for (i = 0, bit = 1; i < INPUT_NR; i++, bit <<= 1)
+    {
+        if ((raw ^ g_input_image) & bit)
+        {
+            if (++input_count[i] >= INPUT_DEBOUNCE_MS)
+            {
+                g_input_image ^= bit;
+                input_changed |= bit;
+                input_change_ms = g_tick_ms;
+                input_count[i] = 0;
+            }
+        }
+        else
+        {
+            /* Bounced back. */
+            input_count[i] = 0;
+        }
+    }
+
+    if (input_changed)
+    {
+        inputs_send_event();
+    }
+} /* End of function inputs_tick(). */
+
+
+static uint8_t inputs_sample(void)
+{
+    return (uint8_t)((PORTA.PIDR.BIT.B6 ? INPUT_ENGINE : 0) |
+                     (PORTA.PIDR.BIT.B7 ? INPUT_FUEL : 0) |
+                     (PORTC.PIDR.BIT.B1 ? INPUT_TRACTION : 0));
+}
+
+
+/* Send the event, or keep the changes for the next tick if the last event 
+is still waiting for the bus. */
+static void inputs_send_event(void)
+{
+    can_frame_t frame;
+
+    if (CAN0.MCTL[CANBOX_INPUT_EVENT].BIT.TX.TRMREQ && 
+        (0 == CAN0.MCTL[CANBOX_INPUT_EVENT].BIT.TX.SENTDATA))
+    {
+        return;
+    }
+
+    frame.id = INPUT_EVENT_ID;
+    frame.dlc = 7;
+    frame.data[0] = g_input_image;
+    frame.data[1] = input_changed;
+    frame.data[2] = (uint8_t)(input_change_ms >> 24);
+    frame.data[3] = (uint8_t)(input_change_ms >> 16);
+    frame.data[4] = (uint8_t)(input_change_ms >> 8);
+    frame.data[5] = (uint8_t)input_change_ms;
+    frame.data[6] = ++input_nr_events;
+
+    /* Throttled: the changes are sent with the next event. */
+    if (R_CAN_OK == app_id_t::tx_set_limited(CH_0, CANBOX_INPUT_EVENT, &frame, DATA_FRAME))
+    {
+        input_changed = 0;
+    }
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : rtc_timebase.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Timebase from the RTC 1 s periodic interrupt. The interrupt
+*                 reads the calendar once, updates the BCD time structure and
+*                 renders the LCD date and time strings, so RTC_display only 
+*                 redraws when the second changed.
+*                 rtc_timestamp_us gives a monotonic 64-bit timestamp for 
+*                 frames and logs: whole seconds counted by the interrupt, 
+*                 plus the microseconds since it from sys_time_us. It reads 
+*                 no RTC registers. Setting the calendar does not move it.
+*                 Expects the RTC to be running, as set up by the startup code.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define RTC_RCR1_PES_1S         0xE0    /* Periodic interrupt every second. */
+#define RTC_RCR1_PIE            0x04
+#define RTC_INT_LVL             1       /* Below the tick, which it reads. */
+
+/*******************************************************************************
+Exported global variables
+*******************************************************************************/
+/* LCD strings, rendered by the RTC interrupt. */
+char                    g_rtc_date_text[13] = "D:";
+char                    g_rtc_time_text[13] = "T:";
+volatile uint8_t        g_rtc_text_changed = 0;
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Seconds since rtc_timebase_init and the sys_time_us of the last one. */
+static volatile uint32_t    rtc_seconds;
+static volatile uint32_t    rtc_second_us;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void rtc_read_and_render(void);
+static char * put_bcd(char * p_dest, uint8_t bcd);
+
+
+/*******************************************************************************
+* Function name: rtc_timebase_init
+* Description  : Render the present time and start the 1 s interrupt.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void rtc_timebase_init(void)
+{
+    IEN(RTC, PRD) = 0;
+
+    rtc_seconds = 0;
+    rtc_second_us = sys_time_us();
+    rtc_read_and_render();
+
+    RTC.RCR1.BYTE = RTC_RCR1_PES_1S | RTC_RCR1_PIE;
+    while ((RTC.RCR1.BYTE & RTC_RCR1_PIE) == 0)
+    {
+        /* Wait for the RTC clock domain to take it. */
+    }
+
+    IR(RTC, PRD) = 0;
+    IPR(RTC, PRD) = RTC_INT_LVL;
+    IEN(RTC, PRD) = 1;
+} /* End of function rtc_timebase_init(). */
+
+
+/*******************************************************************************
+* Function name: rtc_timestamp_us
+* Description  : Monotonic time since rtc_timebase_init.
+* Argument     : none
+* Return value : Microseconds.
+*******************************************************************************/
+uint64_t rtc_timestamp_us(void)
+{
+    uint32_t    seconds;
+    uint32_t    since_us;
+
+    /* Read again if the second turned over in between. */
+    do
+    {
+        seconds = rtc_seconds;
+        since_us = sys_time_us() - rtc_second_us;
+    } while (seconds != rtc_seconds);
+
+    /* The two clocks drift apart a little. Never run into the next second. */
+    if (since_us > 999999UL)
+    {
+        since_us = 999999UL;
+    }
+
+    return ((uint64_t)seconds * 1000000UL) + since_us;
+} /* End of function rtc_timestamp_us(). */
+
+
+/*****************************************************************************
+* Function name:    rtc_prd_isr
+* Description  :    RTC periodic interrupt, once a second.
+* Arguments    :    N/A
+* Return value :    N/A
+*****************************************************************************/
+#pragma interrupt rtc_prd_isr(vect=VECT_RTC_PRD, enable)
+void rtc_prd_isr(void)
+{
+    rtc_second_us = sys_time_us();
+    rtc_seconds++;
+    rtc_read_and_render();
+} /* end rtc_prd_isr() */
+
+
+/* Calendar into the BCD time structure, and the LCD strings from it:
+D:yyyy-mm-dd and T:hh:mm:ss. */
+static void rtc_read_and_render(void)
+{
+    char * p;
+
+    time.second = RTC.RSECCNT.BYTE;
+    time.minute = RTC.RMINCNT.BYTE;
+    time.hour = RTC.RHRCNT.BYTE;
+    time.dayweek = RTC.RWKCNT.BYTE;
+    time.day = RTC.RDAYCNT.BYTE;
+    time.month = RTC.RMONCNT.BYTE;
+    time.year = 0x2000 | RTC.RYRCNT.WORD;
+
+    p = put_bcd(&g_rtc_date_text[2], (uint8_t)(time.year >> 8));
+    p = put_bcd(p, (uint8_t)time.year);
+    *p++ = '-';
+    p = put_bcd(p, time.month);
+    *p++ = '-';
+    p = put_bcd(p, time.day);
+    *p = '\0';
+
+    p = put_bcd(&g_rtc_time_text[2], time.hour);
+    *p++ = ':';
+    p = put_bcd(p, time.minute);
+    *p++ = ':';
+    p = put_bcd(p, time.second);
+    *p = '\0';
+
+    g_rtc_text_changed = 1;
+}
+
+static char * put_bcd(char * p_dest, uint8_t bcd)
+{
+    *p_dest++ = (char)('0' + (bcd >> 4));
+    *p_dest++ = (char)('0' + (bcd & 0x0F));
+    return p_dest;
+}
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_tsync.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Two step time sync over CAN. The master (TIME_SYNC_MASTER) 
+*                 sends a SYNC frame every TSYNC_PERIOD_MS, takes its own 
+*                 time when the Tx ISR sees it sent, and sends that time in a
+*                 FOLLOW_UP frame. Followers take their time when the Rx ISR
+*                 sees the SYNC. Both ends stamp the same end-of-frame event
+*                 from an ISR, so the bus delay cancels out and what is left 
+*                 is ISR latency jitter, a few microseconds.
+*                 Followers keep the offset of the last pair and the drift 
+*                 between pairs, and map their rtc_timestamp_us to master time
+*                 with tsync_to_master_us. The error of the previous estimate
+*                 against each new pair is kept as a quality measure.
+*                 SYNC:      data[0] = 0x10, data[1] = sequence. 
+*                 FOLLOW_UP: data[0] = 0x18, data[1] = sequence, data[2-7] = 
+*                            master time of the SYNC, us, big endian.
+*                 Needs the CAN interrupts (USE_CAN_POLL 0).
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if (USE_CAN_POLL == 0)
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define TSYNC_PERIOD_MS         1000
+#define TSYNC_TIMEOUT_MS        (3 * TSYNC_PERIOD_MS)   /* Then not synced. */
+#define TSYNC_TYPE_SYNC         0x10
+#define TSYNC_TYPE_FOLLOW_UP    0x18
+#define TSYNC_DRIFT_SHIFT       2       /* Drift estimate IIR, 1/4 per sync. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Master. */
+static uint8_t              tsync_seq;
+static uint16_t             tsync_left_ms;
+static volatile uint8_t     tsync_sync_in_flight;
+
+/* Follower. Written by the Rx ISR. */
+static uint8_t              tsync_rx_seq;
+static uint64_t             tsync_rx_local_us;      /* Local time of that SYNC. */
+static bool                 tsync_rx_valid = false;
+
+static int64_t              tsync_offset_us;        /* Master - local, at ref. */
+static uint64_t             tsync_ref_local_us;
+static int32_t              tsync_drift_ppm_q8;     /* Master rate - 1, ppm * 256. */
+static int32_t              tsync_last_error_us;
+static uint16_t             tsync_age_ms = 0xFFFF;
+static uint8_t              tsync_nr_pairs;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void tsync_send(uint8_t type, uint64_t t_us);
+static void tsync_follow_up(const can_frame_t * p_frame);
+
+
+/*******************************************************************************
+* Function name: tsync_init
+* Description  : Set up the time sync mailboxes. Call in halt mode. The 
+*                startup code calls it each pass; the period and the drift
+*                estimate are set up on the first call only and run on.
+* Argument     : none
+* Return value : R_CAN_OK or the error of the mailbox setup.
+*******************************************************************************/
+uint32_t tsync_init(void)
+{
+    uint32_t    api_status;
+    static bool init_done = false;
+
+    if (!init_done)
+    {
+        tsync_rx_valid = false;
+        tsync_nr_pairs = 0;
+        tsync_age_ms = 0xFFFF;
+        tsync_left_ms = TSYNC_PERIOD_MS;
+        init_done = true;
+    }
+
+    /* The channel was created again, which drops a SYNC still in the 
+    mailbox. No Tx interrupt comes for it, so do not wait for one. */
+    tsync_sync_in_flight = 0;
+
+    /* Exact match, whatever the group mask holds. */
+    api_status = app_id_t::rx_set(CH_0, CANBOX_TSYNC_RX, TSYNC_ID, DATA_FRAME);
+    CAN0.MKIVLR |= (1UL << CANBOX_TSYNC_RX);
+
+    return api_status;
+} /* End of function tsync_init(). */
+
+
+/*******************************************************************************
+* Function name: tsync_tick
+* Description  : Master: send SYNC when due. Follower: age the last sync.
+*                Called from the 1 ms tick.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void tsync_tick(void)
+{
+    if (tsync_age_ms < 0xFFFF)
+    {
+        tsync_age_ms++;
+    }
+
+    #if TIME_SYNC_MASTER
+    if (--tsync_left_ms != 0)
+    {
+        return;
+    }
+    tsync_left_ms = TSYNC_PERIOD_MS;
+
+    /* Previous round not finished? Skip this one. */
+    if (tsync_sync_in_flight)
+    {
+        return;
+    }
+
+    tsync_seq++;
+    tsync_sync_in_flight = 1;
+    tsync_send(TSYNC_TYPE_SYNC, 0);
+    #endif
+} /* End of function tsync_tick(). */
+
+
+/*******************************************************************************
+* Function name: tsync_tx_done
+* Description  : Master: the SYNC went out at t_tx_us; send the FOLLOW_UP. 
+*                Called from the Tx ISR.
+* Arguments    : t_tx_us -
+*                    Local time the Tx ISR saw the frame sent.
+* Return value : none
+*******************************************************************************/
+void tsync_tx_done(uint64_t t_tx_us)
+{
+    if (tsync_sync_in_flight)
+    {
+        tsync_sync_in_flight = 0;
+        tsync_send(TSYNC_TYPE_FOLLOW_UP, t_tx_us);
+    }
+} /* End of function tsync_tx_done(). */
+
+
+/*******************************************************************************
+* Function name: tsync_rx_frame
+* Description  : Follower: keep the receive time of a SYNC, or update the 
+*                estimate from a FOLLOW_UP. Called from the Rx ISR.
+* Arguments    : p_frame -
+*                    Received frame.
+*                t_rx_us -
+*                    Local time the Rx ISR saw it.
+* Return value : none
+*******************************************************************************/
+void tsync_rx_frame(const can_frame_t * p_frame, uint64_t t_rx_us)
+{
+    if (p_frame->dlc < 2)
+    {
+        return;
+    }
+
+    if (TSYNC_TYPE_SYNC == p_frame->data[0])
+    {
+        tsync_rx_seq = p_frame->data[1];
+        tsync_rx_local_us = t_rx_us;
+        tsync_rx_valid = true;
+    }
+    else if ((TSYNC_TYPE_FOLLOW_UP == p_frame->data[0]) && (8 == p_frame->dlc) &&
+             tsync_rx_valid && (p_frame->data[1] == tsync_rx_seq))
+    {
+        tsync_rx_valid = false;
+        tsync_follow_up(p_frame);
+    }
+} /* End of function tsync_rx_frame(). */
+
+
+/*******************************************************************************
+* Function name: tsync_to_master_us
+* Description  : Map a local rtc_timestamp_us to master time. On the master, 
+*                or before the first sync, local time is returned.
+* Arguments    : local_us -
+*                    Local time.
+* Return value : Master time, us.
+*******************************************************************************/
+uint64_t tsync_to_master_us(uint64_t local_us)
+{
+    int64_t     since_us;
+    int64_t     offset_us;
+    uint64_t    ref_us;
+    int32_t     drift;
+
+    #if TIME_SYNC_MASTER
+    return local_us;
+    #else
+    if (0 == tsync_nr_pairs)
+    {
+        return local_us;
+    }
+
+    /* The Rx ISR may update the estimate; it runs at the tick level. */
+    IEN(CMT3, CMI3) = 0;
+    IEN(CAN0, RXM0) = 0;
+    offset_us = tsync_offset_us;
+    ref_us = tsync_ref_local_us;
+    drift = tsync_drift_ppm_q8;
+    IEN(CAN0, RXM0) = 1;
+    IEN(CMT3, CMI3) = 1;
+
+    since_us = (int64_t)(local_us - ref_us);
+    return local_us + offset_us + (since_us * drift) / (1000000LL * 256);
+    #endif
+} /* End of function tsync_to_master_us(). */
+
+
+/*******************************************************************************
+* Function name: tsync_now_us
+* Description  : Master time now. For log and frame timestamps that are to be 
+*                merged across nodes.
+* Argument     : none
+* Return value : us.
+*******************************************************************************/
+uint64_t tsync_now_us(void)
+{
+    return tsync_to_master_us(rtc_timestamp_us());
+} /* End of function tsync_now_us(). */
+
+
+/*******************************************************************************
+* Function name: tsync_get_status
+* Description  : Sync state for diagnostics.
+* Arguments    : p_dest -
+*                    5 bytes: synced (0/1), last error us (int16, saturated),
+*                    drift ppm (int16). Big endian.
+* Return value : none
+*******************************************************************************/
+void tsync_get_status(uint8_t * p_dest)
+{
+    int32_t err = tsync_last_error_us;
+    int32_t ppm = tsync_drift_ppm_q8 / 256;
+
+    err = (err > 32767) ? 32767 : ((err < -32768) ? -32768 : err);
+    ppm = (ppm > 32767) ? 32767 : ((ppm < -32768) ? -32768 : ppm);
+
+    #if TIME_SYNC_MASTER
+    p_dest[0] = 1;
+    #else
+    p_dest[0] = ((tsync_nr_pairs != 0) && (tsync_age_ms < TSYNC_TIMEOUT_MS)) ? 1 : 0;
+    #endif
+    p_dest[1] = (uint8_t)((uint16_t)err >> 8);
+    p_dest[2] = (uint8_t)err;
+    p_dest[3] = (uint8_t)((uint16_t)ppm >> 8);
+    p_dest[4] = (uint8_t)ppm;
+} /* End of function tsync_get_status(). */
+
+
+static void tsync_send(uint8_t type, uint64_t t_us)
+{
+    can_frame_t frame;
+    uint8_t     i;
+
+    frame.id = TSYNC_ID;
+    frame.data[0] = type;
+    frame.data[1] = tsync_seq;
+    if (TSYNC_TYPE_SYNC == type)
+    {
+        frame.dlc = 2;
+    }
+    else
+    {
+        frame.dlc = 8;
+        for (i = 0; i < 6; i++)
+        {
+            frame.data[2 + i] = (uint8_t)(t_us >> (8 * (5 - i)));
+        }
+    }
+
+    app_id_t::tx_set(CH_0, CANBOX_TSYNC_TX, &frame, DATA_FRAME);
+}
+
+
+/* New pair: master time of the SYNC from the FOLLOW_UP, local from the Rx ISR.
+Measure how far the old estimate was off, then update offset and drift. */
+static void tsync_follow_up(const can_frame_t * p_frame)
+{
+    uint64_t    master_us = 0;
+    uint64_t    local_us = tsync_rx_local_us;
+    int64_t     d_local;
+    int64_t     d_master;
+    int32_t     drift;
+    uint8_t     i;
+
+    for (i = 0; i < 6; i++)
+    {
+        master_us = (master_us << 8) | p_frame->data[2 + i];
+    }
+
+    if (tsync_nr_pairs != 0)
+    {
+        d_local = (int64_t)(local_us - tsync_ref_local_us);
+        d_master = (int64_t)(master_us - (tsync_ref_local_us + tsync_offset_us));
+
+        tsync_last_error_us = (int32_t)((int64_t)master_us - 
+                              (int64_t)(local_us + tsync_offset_us + 
+                              (d_local * tsync_drift_ppm_q8) / (1000000LL * 256)));
+
+        /* Rate of this interval. Skip it if the master restarted. */
+        if ((d_local > 0) && (d_master > 0) && (tsync_age_ms < TSYNC_TIMEOUT_MS))
+        {
+            drift = (int32_t)(((d_master - d_local) * 1000000LL * 256) / d_local);
+            tsync_drift_ppm_q8 += (drift - tsync_drift_ppm_q8) >> TSYNC_DRIFT_SHIFT;
+        }
+    }
+
+    tsync_offset_us = (int64_t)(master_us - local_us);
+    tsync_ref_local_us = local_us;
+    tsync_age_ms = 0;
+    if (tsync_nr_pairs < 0xFF)
+    {
+        tsync_nr_pairs++;
+    }
+}
+
+#endif /* USE_CAN_POLL == 0 */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : isr_probe.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Execution time and latency probes for the interrupt handlers
+*                 and the main loop stages. PROBE_ENTER/PROBE_EXIT read the 
+*                 bench timer (CMT1, PCLK/8, 1/6 us per tick) at entry and 
+*                 exit. It wraps every 10.9 ms, which a main loop stage with
+*                 printf and LCD output can exceed, so the loop stages read
+*                 sys_time_us instead and are kept in us, up to 65535. 
+*                 PROBE_VALUE records a latency measured by the caller:
+*                   PROBE_LAT_SYS_TICK  CMT3 count at tick ISR entry, i.e. 
+*                                       time since the compare match.
+*                   PROBE_LAT_CAN_RX    CAN timestamp counter against the
+*                                       frame's timestamp, in bit times 
+*                                       converted to bench ticks. 2 us 
+*                                       resolution, counted from the end of
+*                                       the frame.
+*                 Each probe keeps count, min, max, mean and a log2 
+*                 histogram, bucket n holding 2^n to 2^(n+1)-1 ticks, since
+*                 boot. Every PROBE_REPORT_MS the main loop prints them on the
+*                 debug port and sends one summary frame per probe on 
+*                 PROBE_REPORT_ID:
+*                   data[0]   probe id
+*                   data[1]   highest histogram bucket hit
+*                   data[2-3] min, ticks (loop stages: us), big endian
+*                   data[4-5] mean
+*                   data[6-7] max
+*                 Build with ISR_PROBES defined to 1. Without it the probe
+*                 macros expand to nothing.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if ISR_PROBES
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define PROBE_HIST_BUCKETS      16
+#define PROBE_REPORT_MS         5000
+#define PROBE_TICKS_PER_US      (PCLK_HZ / 8 / 1000000)
+#define PROBE_IN_US(id)         ((PROBE_LOOP_STATUS == (id)) || (PROBE_LOOP_APP == (id)))
+
+/*******************************************************************************
+Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t    count;
+    uint64_t    sum;                    /* Loop stages fill 32 bits of us in 71 min. */
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    hist[PROBE_HIST_BUCKETS];
+} probe_stat_t;
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Each probe is only written from its own context, which does not nest with
+itself, so the writers need no locking. The reader checks count for a 
+concurrent update instead. */
+static volatile probe_stat_t    probe_stats[PROBE_NR];
+static uint32_t                 probe_t0[PROBE_NR];
+
+static uint32_t     probe_report_ms;
+static uint8_t      probe_report_next = PROBE_NR;   /* PROBE_NR = idle. */
+
+static const char * const probe_names[PROBE_NR] =
+{
+    "CAN Tx ISR",
+    "CAN Rx ISR",
+    "CAN error ISR",
+    "tick ISR",
+    "CMT0 callback",
+    "loop status",
+    "loop app",
+    "lat CAN Rx",
+    "lat tick"
+};
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void     probe_snapshot(probe_id_t id, probe_stat_t * p_stat);
+static uint8_t  probe_top_bucket(const probe_stat_t * p_stat);
+static void     probe_print(void);
+static bool     probe_send(probe_id_t id);
+
+
+/*******************************************************************************
+* Function name: probe_enter
+* Description  : Start an execution time measurement.
+* Argument     : id -
+*                    Probe.
+* Return value : none
+*******************************************************************************/
+void probe_enter(probe_id_t id)
+{
+    probe_t0[id] = PROBE_IN_US(id) ? sys_time_us() : bench_timer_read();
+} /* End of function probe_enter(). */
+
+
+/*******************************************************************************
+* Function name: probe_exit
+* Description  : End the measurement started by probe_enter and record it.
+* Argument     : id -
+*                    Probe.
+* Return value : none
+*******************************************************************************/
+void probe_exit(probe_id_t id)
+{
+    uint32_t    us;
+
+    if (PROBE_IN_US(id))
+    {
+        us = sys_time_us() - probe_t0[id];
+        probe_value(id, (uint16_t)((us > 0xFFFF) ? 0xFFFF : us));
+    }
+    else
+    {
+        probe_value(id, (uint16_t)(bench_timer_read() - (uint16_t)probe_t0[id]));
+    }
+} /* End of function probe_exit(). */
+
+
+/*******************************************************************************
+* Function name: probe_value
+* Description  : Record one measurement.
+* Arguments    : id -
+*                    Probe.
+*                ticks -
+*                    Duration in bench timer ticks, or us for the loop stages.
+* Return value : none
+*******************************************************************************/
+void probe_value(probe_id_t id, uint16_t ticks)
+{
+    volatile probe_stat_t * p_stat = &probe_stats[id];
+    uint8_t     bucket = 0;
+    uint16_t    v;
+
+    for (v = ticks >> 1; v != 0; v >>= 1)
+    {
+        bucket++;
+    }
+
+    if ((0 == p_stat->count) || (ticks < p_stat->min))
+    {
+        p_stat->min = ticks;
+    }
+    if (ticks > p_stat->max)
+    {
+        p_stat->max = ticks;
+    }
+    if (p_stat->hist[bucket] < 0xFFFF)
+    {
+        p_stat->hist[bucket]++;
+    }
+    p_stat->sum += ticks;
+
+    /* Last, the reader retries when it sees this change. */
+    p_stat->count++;
+} /* End of function probe_value(). */
+
+
+/*******************************************************************************
+* Function name: probe_poll
+* Description  : Start a report every PROBE_REPORT_MS, and send its frames
+*                one per call as the mailbox frees. Called from the main loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void probe_poll(void)
+{
+    if (probe_report_next < PROBE_NR)
+    {
+        if (probe_send((probe_id_t)probe_report_next))
+        {
+            probe_report_next++;
+        }
+        return;
+    }
+
+    if ((uint32_t)(g_tick_ms - probe_report_ms) >= PROBE_REPORT_MS)
+    {
+        probe_report_ms = g_tick_ms;
+        probe_print();
+        probe_report_next = 0;
+    }
+} /* End of function probe_poll(). */
+
+
+/* Consistent copy of one probe's statistics. */
+static void probe_snapshot(probe_id_t id, probe_stat_t * p_stat)
+{
+    uint32_t    count;
+
+    do
+    {
+        count = probe_stats[id].count;
+        memcpy(p_stat, (const void *)&probe_stats[id], sizeof(*p_stat));
+    } while (count != probe_stats[id].count);
+}
+
+
+static uint8_t probe_top_bucket(const probe_stat_t * p_stat)
+{
+    uint8_t     bucket;
+
+    for (bucket = PROBE_HIST_BUCKETS - 1; bucket > 0; bucket--)
+    {
+        if (p_stat->hist[bucket] != 0)
+        {
+            break;
+        }
+    }
+    return bucket;
+}
+
+
+/*******************************************************************************
+* Function name: probe_print
+* Description  : All probes and their histograms to the debug port, in us.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+static void probe_print(void)
+{
+    probe_stat_t    stat;
+    uint8_t         id;
+    uint8_t         bucket;
+    uint32_t        per_us;
+    uint32_t        mean;
+
+    printf("\nprobes, us: count min mean max | log2 histogram, ticks (loop: us)");
+    for (id = 0; id < PROBE_NR; id++)
+    {
+        probe_snapshot((probe_id_t)id, &stat);
+        if (0 == stat.count)
+        {
+            continue;
+        }
+
+        per_us = PROBE_IN_US(id) ? 1 : PROBE_TICKS_PER_US;
+        mean = (uint32_t)(stat.sum / stat.count);
+        printf("\n  %-14s %7lu %5lu.%lu %5lu.%lu %5lu.%lu |", probe_names[id], stat.count,
+               stat.min / per_us, (stat.min % per_us) * 10 / per_us,
+               mean / per_us, (mean % per_us) * 10 / per_us,
+               stat.max / per_us, (stat.max % per_us) * 10 / per_us);
+        for (bucket = 0; bucket <= probe_top_bucket(&stat); bucket++)
+        {
+            printf(" %u", stat.hist[bucket]);
+        }
+    }
+} /* End of function probe_print(). */
+
+
+/*******************************************************************************
+* Function name: probe_send
+* Description  : Summary frame of one probe. Probes with no samples are 
+*                skipped.
+* Argument     : id -
+*                    Probe.
+* Return value : false if the mailbox is still busy; try again.
+*******************************************************************************/
+static bool probe_send(probe_id_t id)
+{
+    probe_stat_t    stat;
+    can_frame_t     frame;
+    uint16_t        mean;
+
+    if (CAN0.MCTL[CANBOX_PROBE_REPORT].BIT.TX.TRMREQ && 
+        (0 == CAN0.MCTL[CANBOX_PROBE_REPORT].BIT.TX.SENTDATA))
+    {
+        return false;
+    }
+
+    probe_snapshot(id, &stat);
+    if (0 == stat.count)
+    {
+        return true;
+    }
+    mean = (uint16_t)(stat.sum / stat.count);
+
+    frame.id = PROBE_REPORT_ID;
+    frame.dlc = 8;
+    frame.data[0] = (uint8_t)id;
+    frame.data[1] = probe_top_bucket(&stat);
+    frame.data[2] = (uint8_t)(stat.min >> 8);
+    frame.data[3] = (uint8_t)stat.min;
+    frame.data[4] = (uint8_t)(mean >> 8);
+    frame.data[5] = (uint8_t)mean;
+    frame.data[6] = (uint8_t)(stat.max >> 8);
+    frame.data[7] = (uint8_t)stat.max;
+
+    app_id_t::tx_set(CH_0, CANBOX_PROBE_REPORT, &frame, DATA_FRAME);
+    return true;
+} /* End of function probe_send(). */
+
+#endif /* ISR_PROBES */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_frame_pool.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Static pool of FRAME_POOL_SIZE frames with reference counts,
+*                 for frames held by more than one owner at a time, e.g. a
+*                 gateway queue and a logger. No heap: free frames are linked
+*                 by index, and a handle is the index.
+*                 frame_pool_alloc returns a frame with one reference. Each
+*                 extra holder calls frame_pool_ref, and every holder calls 
+*                 frame_pool_release when done; the last release frees it.
+*                 Allocation failures and the most frames ever in use are 
+*                 counted, UDS DID 0xF208, so FRAME_POOL_SIZE can be set from
+*                 a run under real load.
+*                 The RX has no compare-and-swap, only XCHG, which cannot 
+*                 pop a linked list safely. The list and counts are therefore
+*                 updated with interrupts masked for a few instructions, 
+*                 which is safe from both the main loop and the ISRs.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define PSW_I               0x00010000UL    /* PSW interrupt enable. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static can_frame_t  frame_pool[FRAME_POOL_SIZE];
+static uint8_t      frame_pool_refs[FRAME_POOL_SIZE];
+static frame_h_t    frame_pool_next[FRAME_POOL_SIZE];   /* Free list links. */
+static frame_h_t    frame_pool_free = FRAME_NONE;
+static bool         frame_pool_ready = false;
+
+static uint8_t      frame_pool_in_use;
+static uint8_t      frame_pool_high_water;
+static uint16_t     frame_pool_nr_exhausted;
+
+/* Mask interrupts for a short critical section. Returns the PSW to restore.
+Also used by the gateway queues. */
+uint32_t int_mask_save(void)
+{
+    uint32_t    psw = get_psw();
+
+    clrpsw_i();
+    return psw;
+}
+
+
+void int_mask_restore(uint32_t psw)
+{
+    if (psw & PSW_I)
+    {
+        setpsw_i();
+    }
+}
+
+
+/*******************************************************************************
+* Function name: frame_pool_alloc
+* Description  : Take a frame from the pool. The caller holds one reference.
+*                The frame contents are left as the last user left them.
+* Argument     : none
+* Return value : Handle, FRAME_NONE if the pool is empty.
+*******************************************************************************/
+frame_h_t frame_pool_alloc(void)
+{
+    frame_h_t   h;
+    uint32_t    psw;
+
+    psw = int_mask_save();
+
+    if (!frame_pool_ready)
+    {
+        /* First use. Link all frames into the free list. */
+        for (h = 0; h < FRAME_POOL_SIZE; h++)
+        {
+            frame_pool_next[h] = (h + 1 < FRAME_POOL_SIZE) ? h + 1 : FRAME_NONE;
+        }
+        frame_pool_free = 0;
+        frame_pool_ready = true;
+    }
+
+    h = frame_pool_free;
+    if (h != FRAME_NONE)
+    {
+        frame_pool_free = frame_pool_next[h];
+        frame_pool_refs[h] = 1;
+        if (++frame_pool_in_use > frame_pool_high_water)
+        {
+            frame_pool_high_water = frame_pool_in_use;
+        }
+    }
+    else
+    {
+        frame_pool_nr_exhausted++;
+    }
+
+    int_mask_restore(psw);
+    return h;
+} /* End of function frame_pool_alloc(). */
+
+
+/*******************************************************************************
+* Function name: frame_pool_frame
+* Description  : The frame of a handle. Valid while the caller holds a 
+*                reference.
+* Argument     : h -
+*                    Handle.
+* Return value : Frame.
+*******************************************************************************/
+can_frame_t * frame_pool_frame(frame_h_t h)
+{
+    return &frame_pool[h];
+} /* End of function frame_pool_frame(). */
+
+
+/*******************************************************************************
+* Function name: frame_pool_ref
+* Description  : Add a reference for another holder. The caller must already
+*                hold one.
+* Argument     : h -
+*                    Handle.
+* Return value : none
+*******************************************************************************/
+void frame_pool_ref(frame_h_t h)
+{
+    uint32_t    psw;
+
+    psw = int_mask_save();
+    frame_pool_refs[h]++;
+    int_mask_restore(psw);
+} /* End of function frame_pool_ref(). */
+
+
+/*******************************************************************************
+* Function name: frame_pool_release
+* Description  : Drop one reference. The last one returns the frame to the 
+*                pool.
+* Argument     : h -
+*                    Handle. FRAME_NONE is ignored.
+* Return value : none
+*******************************************************************************/
+void frame_pool_release(frame_h_t h)
+{
+    uint32_t    psw;
+
+    if (h >= FRAME_POOL_SIZE)
+    {
+        return;
+    }
+
+    psw = int_mask_save();
+    if ((frame_pool_refs[h] > 0) && (0 == --frame_pool_refs[h]))
+    {
+        frame_pool_next[h] = frame_pool_free;
+        frame_pool_free = h;
+        frame_pool_in_use--;
+    }
+    int_mask_restore(psw);
+} /* End of function frame_pool_release(). */
+
+
+/*******************************************************************************
+* Function name: frame_pool_get_status
+* Description  : UDS DID 0xF208. Pool size, frames in use, most ever in use,
+*                failed allocations (big endian).
+* Argument     : p_dest -
+*                    Gets 5 bytes.
+* Return value : none
+*******************************************************************************/
+void frame_pool_get_status(uint8_t * p_dest)
+{
+    p_dest[0] = FRAME_POOL_SIZE;
+    p_dest[1] = frame_pool_in_use;
+    p_dest[2] = frame_pool_high_water;
+    p_dest[3] = (uint8_t)(frame_pool_nr_exhausted >> 8);
+    p_dest[4] = (uint8_t)frame_pool_nr_exhausted;
+} /* End of function frame_pool_get_status(). */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_gateway.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Gateway between the CAN channels. Routes in gw_routes give
+*                 a source channel, ID and mask, a destination channel, an 
+*                 optional new ID and an optional payload transform. 
+*                 gateway_init compiles them into one lookup table per source
+*                 channel, indexed by the 11-bit ID, holding a bit per 
+*                 matching route, and sets the receive filter of each source
+*                 to the widest match of its routes.
+*                 The Rx ISR of the source reads the frame straight into a 
+*                 frame pool buffer (can_frame_pool.c), looks it up and puts
+*                 it on the Tx queue of each destination; a frame routed
+*                 unchanged to several channels is shared by reference. The 
+*                 Tx ISR of the destination loads the next queued frame as
+*                 soon as its mailbox is free, so the main loop is not 
+*                 involved.
+*                 One Tx mailbox per destination keeps the frames in order.
+*                 Forwarding latency is from the Rx ISR to the frame loaded
+*                 into the Tx mailbox, in bench timer ticks. gateway_poll 
+*                 counts frames per second; UDS DID 0xF209 reads the figures.
+*                 At 500 kbps a fully loaded bus carries roughly 4000 frames/s
+*                 of 8 bytes, which is the rate to check for on each side.
+*                 Standard IDs only. Channels other than CAN0 are used for
+*                 the gateway alone and are set up here.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <string.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if (USE_CAN_POLL == 0) && DEMO_GATEWAY
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define GW_ID_SPACE         0x800       /* 11-bit IDs. */
+#define GW_ID_KEEP          0xFFFF      /* Route does not rewrite the ID. */
+#define GW_QUEUE_SIZE       8           /* Per destination. Power of 2. */
+#define GW_RATE_MS          1000
+#define GW_TICKS_PER_US     (PCLK_HZ / 8 / 1000000)
+
+/*******************************************************************************
+Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint8_t     src_ch;
+    uint16_t    id;
+    uint16_t    mask;           /* Bits of id that must match. */
+    uint8_t     dst_ch;
+    uint16_t    new_id;         /* Replaces the masked bits, or GW_ID_KEEP. */
+    void        (* transform)(can_frame_t * p_frame);   /* Or NULL. */
+} gw_route_t;
+
+typedef struct
+{
+    frame_h_t   frame[GW_QUEUE_SIZE];
+    uint16_t    t_rx[GW_QUEUE_SIZE];    /* Bench timer at receive. */
+    uint8_t     head;
+    uint8_t     tail;
+    bool        tx_busy;                /* Mailbox loaded, not yet sent. */
+} gw_txq_t;
+
+/*******************************************************************************
+Local Function Prototypes
+*******************************************************************************/
+static void     gw_swap16(can_frame_t * p_frame);
+static uint32_t gw_channel_init(uint32_t ch_nr);
+static void     gw_enqueue(uint8_t dst_ch, frame_h_t h, uint16_t t_rx);
+static void     gw_kick(uint8_t dst_ch);
+static void     gw_rx_isr(uint32_t ch_nr);
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Routes, in the order applied. At most 8, one bit each in the lookup. */
+static const gw_route_t gw_routes[] =
+{
+    /* src   id     mask   dst   new id      transform */
+    {CH_0, 0x400, 0x7F0, CH_1, GW_ID_KEEP, NULL},       /* 0x400-0x40F as is. */
+    {CH_1, 0x200, 0x7F0, CH_0, 0x300,      gw_swap16},  /* 0x20x to 0x30x, byte order swapped. */
+    {CH_1, 0x210, 0x7FF, CH_0, GW_ID_KEEP, NULL},
+    {CH_1, 0x210, 0x7FF, CH_2, GW_ID_KEEP, NULL}        /* Shared with the route above. */
+};
+#define GW_NR_ROUTES    ((uint8_t)(sizeof(gw_routes) / sizeof(gw_routes[0])))
+
+static uint8_t      gw_lookup[MAX_CHANNELS][GW_ID_SPACE];
+static gw_txq_t     gw_txq[MAX_CHANNELS];
+
+static uint32_t     gw_nr_forwarded;
+static uint16_t     gw_nr_dropped;
+static uint16_t     gw_lat_max;
+static uint32_t     gw_lat_sum;
+static uint32_t     gw_lat_count;
+
+static uint32_t     gw_rate_ms;
+static uint32_t     gw_rate_prev;
+static uint16_t     gw_rate;                /* Frames/s, last second. */
+static uint16_t     gw_rate_peak;
+
+
+/* Example transform: 16-bit values to the other byte order. */
+static void gw_swap16(can_frame_t * p_frame)
+{
+    uint8_t     i;
+    uint8_t     b;
+
+    for (i = 0; i + 1 < p_frame->dlc; i += 2)
+    {
+        b = p_frame->data[i];
+        p_frame->data[i] = p_frame->data[i + 1];
+        p_frame->data[i + 1] = b;
+    }
+}
+
+
+/*******************************************************************************
+* Function name: gateway_init
+* Description  : Compile the routes into the lookup tables and set up the
+*                gateway mailboxes. Called with CAN0 in halt mode; the other
+*                channels used by a route are created and started here, on
+*                the first call only. The startup code runs each pass and
+*                creates CAN0 again, so later calls set up the CAN0 filter
+*                and let go of the frame the CAN0 Tx mailbox held.
+* Argument     : none
+* Return value : R_CAN_OK, or the OR of the API errors.
+*******************************************************************************/
+uint32_t gateway_init(void)
+{
+    uint32_t    api_status = R_CAN_OK;
+    uint16_t    id;
+    static uint16_t filter_mask[MAX_CHANNELS];
+    static uint16_t filter_id[MAX_CHANNELS];
+    static bool used[MAX_CHANNELS] = {false};
+    static bool source[MAX_CHANNELS] = {false};
+    static bool init_done = false;
+    uint8_t     r;
+    uint8_t     ch;
+    uint32_t    psw;
+
+    if (init_done)
+    {
+        /* Create emptied the mailbox; no Tx interrupt comes for that frame.
+        The queue goes on with the next one, see gateway_poll. */
+        psw = int_mask_save();
+        if (gw_txq[CH_0].tx_busy)
+        {
+            gw_txq[CH_0].tx_busy = false;
+            gw_nr_dropped++;
+        }
+        int_mask_restore(psw);
+        if (source[CH_0])
+        {
+            api_status |= can_std_id::rx_set(CH_0, CANBOX_GW_RX, filter_id[CH_0] & filter_mask[CH_0], DATA_FRAME);
+            R_CAN_RxSetMask(CH_0, CANBOX_GW_RX, filter_mask[CH_0]);
+        }
+        return api_status;
+    }
+
+    /* Route bit per ID. The receive filter keeps the ID bits that every 
+    route of the source agrees on. */
+    for (r = 0; r < GW_NR_ROUTES; r++)
+    {
+        ch = gw_routes[r].src_ch;
+        if (!source[ch])
+        {
+            source[ch] = true;
+            used[ch] = true;
+            filter_id[ch] = gw_routes[r].id;
+            filter_mask[ch] = gw_routes[r].mask;
+        }
+        filter_mask[ch] &= gw_routes[r].mask & ~(gw_routes[r].id ^ filter_id[ch]);
+
+        for (id = 0; id < GW_ID_SPACE; id++)
+        {
+            if (0 == ((id ^ gw_routes[r].id) & gw_routes[r].mask))
+            {
+                gw_lookup[ch][id] |= (uint8_t)(1 << r);
+            }
+        }
+        used[gw_routes[r].dst_ch] = true;
+    }
+
+    bench_timer_init();
+
+    for (ch = CH_0; ch < MAX_CHANNELS; ch++)
+    {
+        if (!used[ch])
+        {
+            continue;
+        }
+
+        if (ch != CH_0)
+        {
+            api_status |= gw_channel_init(ch);
+        }
+        if (source[ch])
+        {
+            api_status |= can_std_id::rx_set(ch, CANBOX_GW_RX, filter_id[ch] & filter_mask[ch], DATA_FRAME);
+            R_CAN_RxSetMask(ch, CANBOX_GW_RX, filter_mask[ch]);
+        }
+    }
+
+    for (ch = CH_1; ch < MAX_CHANNELS; ch++)
+    {
+        if (used[ch])
+        {
+            api_status |= R_CAN_Control(ch, OPERATE_CANMODE);
+        }
+    }
+
+    init_done = true;
+    return api_status;
+} /* End of function gateway_init(). */
+
+
+/* Bring up a gateway-only channel, left in halt mode for its filter. The 
+driver enables its mailbox interrupts as they are set. */
+static uint32_t gw_channel_init(uint32_t ch_nr)
+{
+    uint32_t    api_status;
+
+    api_status = R_CAN_Create(ch_nr);
+    api_status |= can_timing_set(ch_nr, CAN_BITRATE);
+    api_status |= R_CAN_PortSet(ch_nr, ENABLE);
+    api_status |= R_CAN_Control(ch_nr, HALT_CANMODE);
+    return api_status;
+}
+
+
+/*******************************************************************************
+* Function name: gateway_rx
+* Description  : Route a received frame. Called from the Rx ISR of the source
+*                channel with NEWDATA set; reading clears it.
+* Arguments    : ch_nr -
+*                    Source channel.
+*                mbox_nr -
+*                    Gateway Rx mailbox.
+* Return value : none
+*******************************************************************************/
+void gateway_rx(uint32_t ch_nr, uint32_t mbox_nr)
+{
+    uint16_t        t_rx = bench_timer_read();
+    frame_h_t       h;
+    frame_h_t       h_out;
+    can_frame_t *   p_frame;
+    uint8_t         routes;
+    uint8_t         r;
+
+    h = frame_pool_alloc();
+    if (FRAME_NONE == h)
+    {
+        /* Pool empty. Drop it so the mailbox is free again. */
+        can_frame_t scratch;
+
+        R_CAN_RxRead(ch_nr, mbox_nr, &scratch);
+        gw_nr_dropped++;
+        return;
+    }
+
+    p_frame = frame_pool_frame(h);
+    R_CAN_RxRead(ch_nr, mbox_nr, p_frame);
+    routes = gw_lookup[ch_nr][p_frame->id & (GW_ID_SPACE - 1)];
+
+    for (r = 0; routes != 0; r++, routes >>= 1)
+    {
+        if (0 == (routes & 1))
+        {
+            continue;
+        }
+
+        if ((GW_ID_KEEP == gw_routes[r].new_id) && (NULL == gw_routes[r].transform))
+        {
+            /* Unchanged. Share the received frame. */
+            frame_pool_ref(h);
+            gw_enqueue(gw_routes[r].dst_ch, h, t_rx);
+            continue;
+        }
+
+        /* Changed. This destination gets its own copy. */
+        h_out = frame_pool_alloc();
+        if (FRAME_NONE == h_out)
+        {
+            gw_nr_dropped++;
+            continue;
+        }
+        *frame_pool_frame(h_out) = *p_frame;
+        if (gw_routes[r].new_id != GW_ID_KEEP)
+        {
+            frame_pool_frame(h_out)->id = (p_frame->id & ~gw_routes[r].mask) | gw_routes[r].new_id;
+        }
+        if (gw_routes[r].transform != NULL)
+        {
+            gw_routes[r].transform(frame_pool_frame(h_out));
+        }
+        gw_enqueue(gw_routes[r].dst_ch, h_out, t_rx);
+    }
+
+    /* The queues hold their own references. */
+    frame_pool_release(h);
+} /* End of function gateway_rx(). */
+
+
+/* Queue a frame, taking over the caller's reference, and start it if the 
+mailbox is idle. */
+static void gw_enqueue(uint8_t dst_ch, frame_h_t h, uint16_t t_rx)
+{
+    gw_txq_t *  p_q = &gw_txq[dst_ch];
+    uint32_t    psw;
+
+    psw = int_mask_save();
+    if ((uint8_t)(p_q->head - p_q->tail) < GW_QUEUE_SIZE)
+    {
+        p_q->frame[p_q->head & (GW_QUEUE_SIZE - 1)] = h;
+        p_q->t_rx[p_q->head & (GW_QUEUE_SIZE - 1)] = t_rx;
+        p_q->head++;
+        h = FRAME_NONE;
+    }
+    else
+    {
+        gw_nr_dropped++;
+    }
+    int_mask_restore(psw);
+
+    frame_pool_release(h);
+    gw_kick(dst_ch);
+}
+
+
+/* Load the oldest queued frame if the mailbox is idle. TxSet copies it to 
+the mailbox, so the buffer is released at once. Only taking the frame off
+the queue and the figures are done with interrupts masked; tx_busy keeps 
+the mailbox to this caller meanwhile. */
+static void gw_kick(uint8_t dst_ch)
+{
+    gw_txq_t *  p_q = &gw_txq[dst_ch];
+    frame_h_t   h = FRAME_NONE;
+    uint16_t    t_rx = 0;
+    uint16_t    lat;
+    uint32_t    psw;
+
+    psw = int_mask_save();
+    if (!p_q->tx_busy && (p_q->head != p_q->tail))
+    {
+        h = p_q->frame[p_q->tail & (GW_QUEUE_SIZE - 1)];
+        t_rx = p_q->t_rx[p_q->tail & (GW_QUEUE_SIZE - 1)];
+        p_q->tail++;
+        p_q->tx_busy = true;
+    }
+    int_mask_restore(psw);
+
+    if (FRAME_NONE == h)
+    {
+        return;
+    }
+
+    can_std_id::tx_set(dst_ch, CANBOX_GW_TX, frame_pool_frame(h), DATA_FRAME);
+    lat = (uint16_t)(bench_timer_read() - t_rx);
+
+    psw = int_mask_save();
+    gw_nr_forwarded++;
+    gw_lat_sum += lat;
+    gw_lat_count++;
+    if (lat > gw_lat_max)
+    {
+        gw_lat_max = lat;
+    }
+    int_mask_restore(psw);
+
+    frame_pool_release(h);
+}
+
+
+/*******************************************************************************
+* Function name: gateway_tx_done
+* Description  : Gateway mailbox of a channel sent its frame. Called from the
+*                Tx ISR of that channel.
+* Argument     : ch_nr -
+*                    Destination channel.
+* Return value : none
+*******************************************************************************/
+void gateway_tx_done(uint32_t ch_nr)
+{
+    gw_txq[ch_nr].tx_busy = false;
+    gw_kick((uint8_t)ch_nr);
+} /* End of function gateway_tx_done(). */
+
+
+/*******************************************************************************
+* Function name: gateway_poll
+* Description  : Forwarding rate over the last second, and its peak. Also 
+*                starts the CAN0 queue again after gateway_init. Called from 
+*                the main loop.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void gateway_poll(void)
+{
+    uint32_t    nr = gw_nr_forwarded;
+
+    /* Frames left queued for CAN0 when it was created again. */
+    gw_kick(CH_0);
+
+    if ((uint32_t)(g_tick_ms - gw_rate_ms) < GW_RATE_MS)
+    {
+        return;
+    }
+    gw_rate_ms = g_tick_ms;
+
+    gw_rate = (uint16_t)(nr - gw_rate_prev);
+    gw_rate_prev = nr;
+    if (gw_rate > gw_rate_peak)
+    {
+        gw_rate_peak = gw_rate;
+    }
+} /* End of function gateway_poll(). */
+
+
+/*******************************************************************************
+* Function name: gateway_get_status
+* Description  : UDS DID 0xF209, big endian: frames/s, peak frames/s, frames 
+*                dropped, mean and max forwarding latency in us.
+* Argument     : p_dest -
+*                    Gets 10 bytes.
+* Return value : none
+*******************************************************************************/
+void gateway_get_status(uint8_t * p_dest)
+{
+    uint16_t    lat_mean;
+    uint16_t    lat_max;
+    uint32_t    psw;
+
+    psw = int_mask_save();
+    lat_mean = (uint16_t)(gw_lat_count ? (gw_lat_sum / gw_lat_count) / GW_TICKS_PER_US : 0);
+    lat_max = gw_lat_max / GW_TICKS_PER_US;
+    int_mask_restore(psw);
+
+    p_dest[0] = (uint8_t)(gw_rate >> 8);
+    p_dest[1] = (uint8_t)gw_rate;
+    p_dest[2] = (uint8_t)(gw_rate_peak >> 8);
+    p_dest[3] = (uint8_t)gw_rate_peak;
+    p_dest[4] = (uint8_t)(gw_nr_dropped >> 8);
+    p_dest[5] = (uint8_t)gw_nr_dropped;
+    p_dest[6] = (uint8_t)(lat_mean >> 8);
+    p_dest[7] = (uint8_t)lat_mean;
+    p_dest[8] = (uint8_t)(lat_max >> 8);
+    p_dest[9] = (uint8_t)lat_max;
+} /* End of function gateway_get_status(). */
+
+
+/* Rx and Tx interrupts of the gateway-only channels. CAN0 is served by
+CAN0_RXM0_ISR and CAN0_TXM0_ISR. */
+static void gw_rx_isr(uint32_t ch_nr)
+{
+    while (R_CAN_OK == R_CAN_RxPoll(ch_nr, CANBOX_GW_RX))
+    {
+        gateway_rx(ch_nr, CANBOX_GW_RX);
+    }
+}
+
+
+#pragma interrupt CAN1_RXM1_ISR(vect=VECT_CAN1_RXM1, enable)
+void CAN1_RXM1_ISR(void)
+{
+    gw_rx_isr(CH_1);
+} /* end CAN1_RXM1_ISR() */
+
+
+#pragma interrupt CAN1_TXM1_ISR(vect=VECT_CAN1_TXM1, enable)
+void CAN1_TXM1_ISR(void)
+{
+    if (R_CAN_OK == R_CAN_TxCheck(CH_1, CANBOX_GW_TX))
+    {
+        gateway_tx_done(CH_1);
+    }
+} /* end CAN1_TXM1_ISR() */
+
+
+#pragma interrupt CAN2_RXM2_ISR(vect=VECT_CAN2_RXM2, enable)
+void CAN2_RXM2_ISR(void)
+{
+    gw_rx_isr(CH_2);
+} /* end CAN2_RXM2_ISR() */
+
+
+#pragma interrupt CAN2_TXM2_ISR(vect=VECT_CAN2_TXM2, enable)
+void CAN2_TXM2_ISR(void)
+{
+    if (R_CAN_OK == R_CAN_TxCheck(CH_2, CANBOX_GW_TX))
+    {
+        gateway_tx_done(CH_2);
+    }
+} /* end CAN2_TXM2_ISR() */
+
+#endif /* (USE_CAN_POLL == 0) && DEMO_GATEWAY */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_tx_limit.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Token bucket limits on transmit, so a fault in one path 
+*                 cannot flood the bus and hold off higher priority traffic.
+*                   Per ID      Frames per second and burst, for the IDs in
+*                               tx_limit_ids. Other IDs have no ID limit.
+*                   Per channel Bus load ceiling: TX_LIMIT_BUS_LOAD_PCT of
+*                               the bit rate the channel runs at, detected
+*                               or set, counted in worst case stuffed 
+*                               frame bits.
+*                 Every frame sent through tx_set uses up channel budget,
+*                 so protocol traffic (ISO-TP, time sync, gateway) is never
+*                 held back but does leave less for the rest. Application 
+*                 frames go through tx_set_limited and are refused, and 
+*                 counted, when either bucket is empty.
+*                 Buckets are refilled from g_tick_ms when used, so nothing
+*                 runs while the node is quiet.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define TX_LIMIT_BUS_LOAD_PCT   40
+#define TX_LIMIT_BUS_BURST_MS   100         /* Budget that may be saved up. */
+#define TX_LIMIT_BITS_PER_MS(ch)    (can_timing_bitrate(ch) / 1000 * TX_LIMIT_BUS_LOAD_PCT / 100)
+#define TX_LIMIT_LOAD_WINDOW_MS 1000
+
+/*******************************************************************************
+Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t    id;
+    uint32_t    mask;
+    uint16_t    per_s;                      /* Frames per second. */
+    uint8_t     burst;                      /* Frames back to back. */
+} tx_limit_id_t;
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static const tx_limit_id_t tx_limit_ids[] =
+{
+    /* id                   mask        per s  burst */
+    {app_id_t::DEMO_ID,     0x1FFFFFFF, 50,    5},      /* Status, main loop. */
+    {0x700,                 0x1FFFFFFC, 2,     3},      /* Bus state changes. */
+    {INPUT_EVENT_ID,        0x1FFFFFFF, 100,   10}
+};
+#define TX_LIMIT_NR_IDS     ((uint8_t)(sizeof(tx_limit_ids) / sizeof(tx_limit_ids[0])))
+
+/* Tokens in 1/1000 frame, and bits. Bit budgets go negative when tx_set
+sends beyond them. */
+static uint32_t     tx_limit_id_tokens[TX_LIMIT_NR_IDS];
+static uint32_t     tx_limit_id_ms[TX_LIMIT_NR_IDS];
+static bool         tx_limit_id_started[TX_LIMIT_NR_IDS];
+static int32_t      tx_limit_bus_tokens[MAX_CHANNELS];
+static uint32_t     tx_limit_bus_ms[MAX_CHANNELS];
+static bool         tx_limit_bus_started[MAX_CHANNELS];
+
+/* Own load, bits sent in the current window and percent in the last. */
+static uint32_t     tx_limit_load_bits[MAX_CHANNELS];
+static uint32_t     tx_limit_load_ms[MAX_CHANNELS];
+static uint8_t      tx_limit_load_pct[MAX_CHANNELS];
+
+static uint16_t     tx_limit_nr_id_throttled;
+static uint16_t     tx_limit_nr_bus_throttled;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint16_t tx_limit_frame_bits(uint8_t dlc, uint8_t ide);
+static int8_t   tx_limit_find(uint32_t id);
+static void     tx_limit_refill(uint32_t ch_nr, int8_t idx);
+static bool     tx_limit_check(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide, bool take);
+
+
+/* Worst case bus time of a frame, with stuff bits and the interframe space:
+the stuffed part SOF to CRC, then CRC delimiter, ACK slot, ACK delimiter and 
+EOF (10) and the interframe space (3), which the bus load budget counts. */
+static uint16_t tx_limit_frame_bits(uint8_t dlc, uint8_t ide)
+{
+    uint16_t    stuffed = (uint16_t)((ide ? 54 : 34) + 8 * dlc);
+
+    return (uint16_t)(stuffed + (stuffed - 1) / 4 + 10 + 3);
+}
+
+
+static int8_t tx_limit_find(uint32_t id)
+{
+    int8_t      i;
+
+    for (i = 0; i < TX_LIMIT_NR_IDS; i++)
+    {
+        if (0 == ((id ^ tx_limit_ids[i].id) & tx_limit_ids[i].mask))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/* Add the tokens earned since the last use. Interrupts masked. */
+static void tx_limit_refill(uint32_t ch_nr, int8_t idx)
+{
+    uint32_t    now = g_tick_ms;
+    uint32_t    elapsed;
+    int32_t     bus_max = (int32_t)TX_LIMIT_BITS_PER_MS(ch_nr) * TX_LIMIT_BUS_BURST_MS;
+    uint32_t    id_max;
+
+    if (!tx_limit_bus_started[ch_nr])
+    {
+        tx_limit_bus_started[ch_nr] = true;
+        tx_limit_bus_tokens[ch_nr] = bus_max;
+        tx_limit_bus_ms[ch_nr] = now;
+        tx_limit_load_ms[ch_nr] = now;
+    }
+
+    elapsed = now - tx_limit_bus_ms[ch_nr];
+    tx_limit_bus_ms[ch_nr] = now;
+    if (elapsed > TX_LIMIT_BUS_BURST_MS)
+    {
+        elapsed = TX_LIMIT_BUS_BURST_MS;
+    }
+    tx_limit_bus_tokens[ch_nr] += (int32_t)(elapsed * TX_LIMIT_BITS_PER_MS(ch_nr));
+    if (tx_limit_bus_tokens[ch_nr] > bus_max)
+    {
+        tx_limit_bus_tokens[ch_nr] = bus_max;
+    }
+
+    elapsed = now - tx_limit_load_ms[ch_nr];
+    if (elapsed >= TX_LIMIT_LOAD_WINDOW_MS)
+    {
+        tx_limit_load_pct[ch_nr] = (uint8_t)((tx_limit_load_bits[ch_nr] * 100) / 
+                                             ((can_timing_bitrate(ch_nr) / 1000) * elapsed));
+        tx_limit_load_bits[ch_nr] = 0;
+        tx_limit_load_ms[ch_nr] = now;
+    }
+
+    if (idx < 0)
+    {
+        return;
+    }
+
+    id_max = (uint32_t)tx_limit_ids[idx].burst * 1000;
+    if (!tx_limit_id_started[idx])
+    {
+        tx_limit_id_started[idx] = true;
+        tx_limit_id_tokens[idx] = id_max;
+        tx_limit_id_ms[idx] = now;
+    }
+
+    elapsed = now - tx_limit_id_ms[idx];
+    tx_limit_id_ms[idx] = now;
+    if (elapsed > 60000)
+    {
+        elapsed = 60000;
+    }
+    tx_limit_id_tokens[idx] += elapsed * tx_limit_ids[idx].per_s;
+    if (tx_limit_id_tokens[idx] > id_max)
+    {
+        tx_limit_id_tokens[idx] = id_max;
+    }
+}
+
+
+static bool tx_limit_check(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide, bool take)
+{
+    uint16_t    bits = tx_limit_frame_bits(dlc, ide);
+    int8_t      idx = tx_limit_find(id);
+    bool        ok = true;
+    uint32_t    psw;
+
+    if (ch_nr >= MAX_CHANNELS)
+    {
+        return false;
+    }
+
+    psw = int_mask_save();
+    tx_limit_refill(ch_nr, idx);
+
+    if ((idx >= 0) && (tx_limit_id_tokens[idx] < 1000))
+    {
+        ok = false;
+        if (take)
+        {
+            tx_limit_nr_id_throttled++;
+        }
+    }
+    else if (tx_limit_bus_tokens[ch_nr] < (int32_t)bits)
+    {
+        ok = false;
+        if (take)
+        {
+            tx_limit_nr_bus_throttled++;
+        }
+    }
+    else if (take)
+    {
+        if (idx >= 0)
+        {
+            tx_limit_id_tokens[idx] -= 1000;
+        }
+        tx_limit_bus_tokens[ch_nr] -= bits;
+        tx_limit_load_bits[ch_nr] += bits;
+    }
+    else
+    {
+        /* Check only. */
+    }
+
+    int_mask_restore(psw);
+    return ok;
+}
+
+
+/*******************************************************************************
+* Function name: tx_limit_ready
+* Description  : Would tx_set_limited send this frame now? Uses no tokens.
+* Arguments    : ch_nr -
+*                    Channel.
+*                id -
+*                    Frame ID.
+*                dlc -
+*                    Data length.
+*                ide -
+*                    1 extended ID.
+* Return value : true if both buckets have room.
+*******************************************************************************/
+bool tx_limit_ready(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide)
+{
+    return tx_limit_check(ch_nr, id, dlc, ide, false);
+} /* End of function tx_limit_ready(). */
+
+
+/*******************************************************************************
+* Function name: tx_limit_take
+* Description  : Use the tokens for one frame, or count it as throttled.
+* Arguments    : As tx_limit_ready.
+* Return value : true if the frame may be sent.
+*******************************************************************************/
+bool tx_limit_take(uint32_t ch_nr, uint32_t id, uint8_t dlc, uint8_t ide)
+{
+    return tx_limit_check(ch_nr, id, dlc, ide, true);
+} /* End of function tx_limit_take(). */
+
+
+/*******************************************************************************
+* Function name: tx_limit_charge
+* Description  : Count a frame sent without a limit against the bus load 
+*                budget of its channel. The budget may go negative.
+* Arguments    : ch_nr -
+*                    Channel.
+*                dlc -
+*                    Data length.
+*                ide -
+*                    1 extended ID.
+* Return value : none
+*******************************************************************************/
+void tx_limit_charge(uint32_t ch_nr, uint8_t dlc, uint8_t ide)
+{
+    uint16_t    bits = tx_limit_frame_bits(dlc, ide);
+    uint32_t    psw;
+
+    if (ch_nr >= MAX_CHANNELS)
+    {
+        return;
+    }
+
+    psw = int_mask_save();
+    tx_limit_refill(ch_nr, -1);
+    if (tx_limit_bus_tokens[ch_nr] > -(int32_t)TX_LIMIT_BITS_PER_MS(ch_nr) * TX_LIMIT_BUS_BURST_MS)
+    {
+        tx_limit_bus_tokens[ch_nr] -= bits;
+    }
+    tx_limit_load_bits[ch_nr] += bits;
+    int_mask_restore(psw);
+} /* End of function tx_limit_charge(). */
+
+
+/*******************************************************************************
+* Function name: tx_limit_get_status
+* Description  : UDS DID 0xF20A. Frames throttled by an ID limit and by the
+*                bus load ceiling (big endian), and the load this node put on
+*                CAN0 over the last second, percent.
+* Argument     : p_dest -
+*                    Gets 5 bytes.
+* Return value : none
+*******************************************************************************/
+void tx_limit_get_status(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)(tx_limit_nr_id_throttled >> 8);
+    p_dest[1] = (uint8_t)tx_limit_nr_id_throttled;
+    p_dest[2] = (uint8_t)(tx_limit_nr_bus_throttled >> 8);
+    p_dest[3] = (uint8_t)tx_limit_nr_bus_throttled;
+    p_dest[4] = tx_limit_load_pct[CH_0];
+} /* End of function tx_limit_get_status(). */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_latest_tx.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Latest-value transmit on CAN0 for signals where only the 
+*                 newest value matters. latest_tx_set replaces a frame of the
+*                 same ID that is still waiting in the mailbox, instead of
+*                 waiting for it to win arbitration first: the old request is
+*                 aborted, then the mailbox is loaded with the new frame. A 
+*                 mailbox may not be written while its request is pending,
+*                 so abort and reload is how the frame is updated in place.
+*                 A frame on the bus at that moment finishes first.
+*                 Each frame set this way has a deadline. The 1 ms tick 
+*                 aborts it if it is still waiting when the deadline passes,
+*                 so no stale value goes out late. The queue never grows past
+*                 the one mailbox.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if (USE_CAN_POLL == 0)
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define LATEST_NR_MBOX          32
+#define LATEST_ABORT_TMO        10000   /* Polls for a frame on the bus to end. */
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static uint32_t             latest_mbox_mask;       /* Mailboxes with a deadline. */
+static uint16_t             latest_deadline_ms[LATEST_NR_MBOX];
+static uint32_t             latest_id[LATEST_NR_MBOX];  /* Other users may share the mailbox. */
+static volatile uint32_t    latest_set_ms[LATEST_NR_MBOX];
+
+static uint16_t             latest_nr_replaced;
+static volatile uint16_t    latest_nr_stale;
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static bool     latest_pending(uint32_t mbox_nr);
+static uint32_t latest_mbox_id(uint32_t mbox_nr);
+
+
+static bool latest_pending(uint32_t mbox_nr)
+{
+    return (CAN0.MCTL[mbox_nr].BIT.TX.TRMREQ && 
+            (0 == CAN0.MCTL[mbox_nr].BIT.TX.SENTDATA));
+}
+
+
+/* ID of the frame loaded in a mailbox, in the frame's ID type. */
+static uint32_t latest_mbox_id(uint32_t mbox_nr)
+{
+    if (CAN0.MB[mbox_nr].ID.BIT.IDE)
+    {
+        return ((uint32_t)CAN0.MB[mbox_nr].ID.BIT.SID << 18) | CAN0.MB[mbox_nr].ID.BIT.EID;
+    }
+    return CAN0.MB[mbox_nr].ID.BIT.SID;
+}
+
+
+/*******************************************************************************
+* Function name: latest_tx_ready
+* Description  : Can latest_tx_set load this ID now without waiting: the 
+*                mailbox is free, or holds a waiting frame of the same ID.
+* Arguments    : mbox_nr -
+*                    Tx mailbox.
+*                id -
+*                    Frame ID.
+* Return value : true if it can.
+*******************************************************************************/
+bool latest_tx_ready(uint32_t mbox_nr, uint32_t id)
+{
+    return (!latest_pending(mbox_nr) || (latest_mbox_id(mbox_nr) == id));
+} /* End of function latest_tx_ready(). */
+
+
+/*******************************************************************************
+* Function name: latest_tx_set
+* Description  : Send a frame, replacing a frame of the same ID still waiting 
+*                in the mailbox. Goes through the transmit rate limits.
+* Arguments    : mbox_nr -
+*                    Tx mailbox.
+*                p_frame -
+*                    Frame.
+*                deadline_ms -
+*                    Abort it if not sent within this. 0 = no deadline.
+* Return value : R_CAN_OK, TX_THROTTLED, R_CAN_NOT_OK if the mailbox holds
+*                another ID, or the API error.
+*******************************************************************************/
+uint32_t latest_tx_set(uint32_t mbox_nr, const can_frame_t * p_frame, uint16_t deadline_ms)
+{
+    const bool      ext = (p_frame->id > can_std_id::ID_MASK_NONE);
+    const uint8_t   ide = ext ? (uint8_t)can_ext_id::IDE : (uint8_t)app_id_t::IDE;
+
+    if (!latest_tx_ready(mbox_nr, p_frame->id))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    /* Tokens first: if the limits say no, the waiting frame stays. The take
+    is atomic, so ISR senders cannot drain the budget between check and 
+    take. */
+    if (!tx_limit_take(CH_0, p_frame->id, p_frame->dlc, ide))
+    {
+        return TX_THROTTLED;
+    }
+
+    return latest_tx_set_taken(mbox_nr, p_frame, deadline_ms);
+} /* End of function latest_tx_set(). */
+
+
+/*******************************************************************************
+* Function name: latest_tx_set_taken
+* Description  : latest_tx_set with the tokens already taken with 
+*                tx_limit_take, for a caller that builds the frame only once
+*                it may be sent.
+* Arguments    : As latest_tx_set.
+* Return value : R_CAN_OK, R_CAN_NOT_OK if the mailbox holds another ID, or 
+*                the API error.
+*******************************************************************************/
+uint32_t latest_tx_set_taken(uint32_t mbox_nr, const can_frame_t * p_frame, uint16_t deadline_ms)
+{
+    const bool      ext = (p_frame->id > can_std_id::ID_MASK_NONE);
+    uint32_t        tmo = LATEST_ABORT_TMO;
+    uint32_t        api_status;
+    bool            aborted = false;
+
+    if (!latest_tx_ready(mbox_nr, p_frame->id))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    if (latest_pending(mbox_nr))
+    {
+        /* Withdraw the request. If the frame is on the bus it completes. */
+        CAN0.MCTL[mbox_nr].BYTE = 0;
+        while (CAN0.MCTL[mbox_nr].BIT.TX.TRMACTIVE && (--tmo > 0))
+        {
+        }
+        aborted = (0 != CAN0.MCTL[mbox_nr].BIT.TX.TRMABT);
+    }
+
+    latest_deadline_ms[mbox_nr] = deadline_ms;
+    latest_id[mbox_nr] = p_frame->id;
+    latest_set_ms[mbox_nr] = g_tick_ms;
+    if (deadline_ms != 0)
+    {
+        latest_mbox_mask |= 1UL << mbox_nr;
+    }
+    else
+    {
+        latest_mbox_mask &= ~(1UL << mbox_nr);
+    }
+
+    if (ext)
+    {
+        api_status = can_ext_id::tx_set_taken(CH_0, mbox_nr, p_frame, DATA_FRAME);
+    }
+    else
+    {
+        api_status = app_id_t::tx_set_taken(CH_0, mbox_nr, p_frame, DATA_FRAME);
+    }
+
+    /* Replaced only if the new value is in the mailbox. */
+    if (aborted && (R_CAN_OK == api_status))
+    {
+        latest_nr_replaced++;
+    }
+    return api_status;
+} /* End of function latest_tx_set_taken(). */
+
+
+/*******************************************************************************
+* Function name: latest_tx_tick
+* Description  : Abort frames waiting past their deadline. Called from the 
+*                1 ms tick.
+* Argument     : none
+* Return value : none
+*******************************************************************************/
+void latest_tx_tick(void)
+{
+    uint32_t    mask = latest_mbox_mask;
+    uint32_t    mbox_nr;
+
+    for (mbox_nr = 0; mask != 0; mbox_nr++, mask >>= 1)
+    {
+        if ((mask & 1) && latest_pending(mbox_nr) &&
+            ((uint32_t)(g_tick_ms - latest_set_ms[mbox_nr]) >= latest_deadline_ms[mbox_nr]) &&
+            (latest_mbox_id(mbox_nr) == latest_id[mbox_nr]))
+        {
+            /* Abort request. A frame already on the bus still completes. */
+            CAN0.MCTL[mbox_nr].BYTE = 0;
+            latest_nr_stale++;
+        }
+    }
+} /* End of function latest_tx_tick(). */
+
+
+/*******************************************************************************
+* Function name: latest_tx_get_status
+* Description  : UDS DID 0xF20B. Frames replaced by a newer value and frames 
+*                aborted at their deadline, big endian.
+* Argument     : p_dest -
+*                    Gets 4 bytes.
+* Return value : none
+*******************************************************************************/
+void latest_tx_get_status(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)(latest_nr_replaced >> 8);
+    p_dest[1] = (uint8_t)latest_nr_replaced;
+    p_dest[2] = (uint8_t)(latest_nr_stale >> 8);
+    p_dest[3] = (uint8_t)latest_nr_stale;
+} /* End of function latest_tx_get_status(). */
+
+#endif /* USE_CAN_POLL == 0 */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_monitor.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Passive bus analyzer on CAN0, DEMO_BUS_MONITOR. CAN0 runs
+*                 in FIFO mailbox mode with both receive FIFO acceptance 
+*                 filters open, one for standard and one for extended IDs,
+*                 so every data frame lands in the 4 deep FIFO in bus order.
+*                 The FIFO interrupt timestamps each frame from the CAN 
+*                 timestamp counter, corrected to sys_time_us, and puts it 
+*                 in the capture ring; the main loop takes them from there 
+*                 into a 64 entry hash table keyed by ID:
+*                   count, mean period, period jitter (max - min), last
+*                   payload and DLC, and the number of DLC changes.
+*                 Once a second the table goes to the debug port and totals
+*                 to the LCD.
+*                 At 500 kbps a frame takes at least 94 us, so the FIFO 
+*                 gives the interrupt about 0.4 ms. Frames lost in the FIFO
+*                 or the ring, and IDs that did not fit the table, are 
+*                 counted. Remote frames are not captured: the FIFO filters
+*                 compare the RTR bit.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include <machine.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if DEMO_BUS_MONITOR
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define MON_RING_SIZE       64          /* Power of 2. */
+#define MON_TABLE_SIZE      64          /* Power of 2. */
+#define MON_KEY_EMPTY       0xFFFFFFFF
+#define MON_KEY_XID         0x80000000  /* Key bit for extended IDs. */
+#define MON_REPORT_MS       1000
+
+#define MON_FIFO_MBOX       28          /* Receive FIFO output. */
+#define RFCR_RFE            0x01
+#define RFCR_RFMLF          0x10        /* FIFO overflowed. */
+#define RFCR_RFEST          0x80        /* FIFO empty. */
+#define MIER_RFIFO_IE       (1UL << 28)
+#define FIDCR_IDE           0x80000000
+#define TCR_LISTEN_ONLY     0x03        /* TSTE, TSTM = listen only. */
+
+/*******************************************************************************
+Typedefs
+*******************************************************************************/
+typedef struct
+{
+    uint32_t        t_us;
+    uint32_t        key;
+    uint8_t         dlc;
+    uint8_t         data[8];
+} mon_capture_t;
+
+typedef struct
+{
+    uint32_t        key;
+    uint32_t        count;
+    uint32_t        last_us;
+    uint64_t        period_sum_us;
+    uint32_t        period_min_us;
+    uint32_t        period_max_us;
+    uint16_t        dlc_changes;
+    uint8_t         dlc;
+    uint8_t         data[8];
+} mon_id_stat_t;
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+static mon_capture_t        mon_ring[MON_RING_SIZE];
+static volatile uint8_t     mon_head;           /* Written by the ISR only. */
+static volatile uint8_t     mon_tail;
+static volatile uint32_t    mon_nr_ring_lost;
+static volatile uint32_t    mon_nr_fifo_lost;
+
+static mon_id_stat_t        mon_table[MON_TABLE_SIZE];
+static uint8_t              mon_nr_ids;
+static uint32_t             mon_nr_table_full;
+static uint32_t             mon_nr_frames;
+static uint32_t             mon_us_per_bit_q8;  /* Per timestamp count, 1/256 us. */
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static bool             monitor_fifo_init(void);
+static mon_id_stat_t *  monitor_lookup(uint32_t key);
+static void             monitor_count(const mon_capture_t * p_cap);
+static void             monitor_report(uint32_t nr_frames_s);
+
+
+/*******************************************************************************
+* Function name: monitor_run
+* Description  : Open the receive FIFO to all frames and run the analyzer.
+*                Called instead of the demo once CAN0 is in listen only mode.
+* Argument     : none
+* Return value : Does not return.
+*******************************************************************************/
+void monitor_run(void)
+{
+    uint32_t    report_ms;
+    uint32_t    nr_frames_prev = 0;
+
+    for (report_ms = 0; report_ms < MON_TABLE_SIZE; report_ms++)
+    {
+        mon_table[report_ms].key = MON_KEY_EMPTY;
+    }
+
+    /* As detected or set; the timestamp counter runs at the bit rate. */
+    mon_us_per_bit_q8 = (1000000UL << 8) / can_timing_bitrate(CH_0);
+
+    if (!monitor_fifo_init())
+    {
+        /* Never join the bus as an active node. Stay in halt mode. */
+        R_CAN_Control(CH_0, HALT_CANMODE);
+        printf("\nBus monitor: CAN0 not in listen only mode, stopped");
+        lcd_display(LCD_LINE1, "Mon: no LISTEN");
+        while (1)
+        {
+            nop();
+        }
+    }
+    lcd_display(LCD_LINE1, "Bus monitor");
+    report_ms = g_tick_ms;
+
+    while (1)
+    {
+        while (mon_tail != mon_head)
+        {
+            monitor_count(&mon_ring[mon_tail & (MON_RING_SIZE - 1)]);
+            mon_tail++;
+        }
+
+        if ((uint32_t)(g_tick_ms - report_ms) >= MON_REPORT_MS)
+        {
+            report_ms += MON_REPORT_MS;
+            monitor_report(mon_nr_frames - nr_frames_prev);
+            nr_frames_prev = mon_nr_frames;
+        }
+    }
+} /* End of function monitor_run(). */
+
+
+/* FIFO mailbox mode can only be selected in reset mode, the filters set in 
+halt mode and the FIFO enabled in operation. Reset mode also clears TCR, so
+listen only is set again in halt mode, and checked. False if the node would
+not be passive. */
+static bool monitor_fifo_init(void)
+{
+    R_CAN_Control(CH_0, RESET_CANMODE);
+    CAN0.CTLR.BIT.MBM = 1;
+    CAN0.CTLR.BIT.IDFM = CTLR_IDFM_MIXED;
+
+    R_CAN_Control(CH_0, HALT_CANMODE);
+    CAN0.FIDCR0.LONG = 0;                       /* Standard data frames. */
+    CAN0.FIDCR1.LONG = FIDCR_IDE;               /* Extended data frames. */
+    CAN0.MKR[6].LONG = 0;                       /* No ID bits compared. */
+    CAN0.MKR[7].LONG = 0;
+    CAN0.MKIVLR &= ~(0xFUL << MON_FIFO_MBOX);
+    CAN0.MIER = MIER_RFIFO_IE;                  /* Interrupt per frame. */
+
+    CAN0.TCR.BYTE = TCR_LISTEN_ONLY;
+    if (TCR_LISTEN_ONLY != CAN0.TCR.BYTE)
+    {
+        return false;
+    }
+
+    IPR(CAN0, RXF0) = CAN0_INT_LVL;
+    IEN(CAN0, RXF0) = 1;
+
+    R_CAN_Control(CH_0, OPERATE_CANMODE);
+    CAN0.RFCR.BYTE = RFCR_RFE;
+    return true;
+}
+
+
+/*******************************************************************************
+* Function name: monitor_fifo_isr
+* Description  : Empty the receive FIFO into the capture ring. The reception
+*                time is the CAN timestamp of the frame, taken back from the 
+*                time now by the timestamp counter's distance to it.
+* Arguments    : N/A
+* Return value : N/A
+*******************************************************************************/
+#pragma interrupt monitor_fifo_isr(vect=VECT_CAN0_RXF0, enable)
+void monitor_fifo_isr(void)
+{
+    uint32_t        now_us = sys_time_us();
+    uint16_t        now_ts = CAN0.TSR;
+    mon_capture_t * p_cap;
+    uint8_t         i;
+
+    while (0 == (CAN0.RFCR.BYTE & RFCR_RFEST))
+    {
+        if ((uint8_t)(mon_head - mon_tail) < MON_RING_SIZE)
+        {
+            p_cap = &mon_ring[mon_head & (MON_RING_SIZE - 1)];
+            p_cap->t_us = now_us - (((uint32_t)(uint16_t)(now_ts - CAN0.MB[MON_FIFO_MBOX].TS) * 
+                                     mon_us_per_bit_q8) >> 8);
+            if (CAN0.MB[MON_FIFO_MBOX].ID.BIT.IDE)
+            {
+                p_cap->key = MON_KEY_XID | ((uint32_t)CAN0.MB[MON_FIFO_MBOX].ID.BIT.SID << 18) |
+                             CAN0.MB[MON_FIFO_MBOX].ID.BIT.EID;
+            }
+            else
+            {
+                p_cap->key = CAN0.MB[MON_FIFO_MBOX].ID.BIT.SID;
+            }
+            p_cap->dlc = (uint8_t)(CAN0.MB[MON_FIFO_MBOX].DLC & 0x0F);
+            for (i = 0; (i < p_cap->dlc) && (i < 8); i++)
+            {
+                p_cap->data[i] = CAN0.MB[MON_FIFO_MBOX].DATA[i];
+            }
+            mon_head++;
+        }
+        else
+        {
+            mon_nr_ring_lost++;
+        }
+
+        /* Next FIFO entry. */
+        CAN0.RFPCR = 0xFF;
+    }
+
+    if (CAN0.RFCR.BYTE & RFCR_RFMLF)
+    {
+        mon_nr_fifo_lost++;
+        CAN0.RFCR.BYTE = RFCR_RFE;
+    }
+} /* end monitor_fifo_isr() */
+
+
+/* Entry of a key, claimed if new. NULL when the table is full. */
+static mon_id_stat_t * monitor_lookup(uint32_t key)
+{
+    uint8_t     idx = (uint8_t)((key * 2654435761UL) >> 26) & (MON_TABLE_SIZE - 1);
+    uint8_t     n;
+
+    for (n = 0; n < MON_TABLE_SIZE; n++, idx = (idx + 1) & (MON_TABLE_SIZE - 1))
+    {
+        if (mon_table[idx].key == key)
+        {
+            return &mon_table[idx];
+        }
+        if (MON_KEY_EMPTY == mon_table[idx].key)
+        {
+            mon_table[idx].key = key;
+            mon_table[idx].period_min_us = 0xFFFFFFFF;
+            mon_nr_ids++;
+            return &mon_table[idx];
+        }
+    }
+    return NULL;
+}
+
+
+static void monitor_count(const mon_capture_t * p_cap)
+{
+    mon_id_stat_t * p_stat = monitor_lookup(p_cap->key);
+    uint32_t        period;
+    uint8_t         i;
+
+    mon_nr_frames++;
+    if (NULL == p_stat)
+    {
+        mon_nr_table_full++;
+        return;
+    }
+
+    if (p_stat->count > 0)
+    {
+        period = p_cap->t_us - p_stat->last_us;
+        p_stat->period_sum_us += period;
+        if (period < p_stat->period_min_us)
+        {
+            p_stat->period_min_us = period;
+        }
+        if (period > p_stat->period_max_us)
+        {
+            p_stat->period_max_us = period;
+        }
+        if (p_cap->dlc != p_stat->dlc)
+        {
+            p_stat->dlc_changes++;
+        }
+    }
+
+    p_stat->count++;
+    p_stat->last_us = p_cap->t_us;
+    p_stat->dlc = p_cap->dlc;
+
+    /* DLC 9-15 is legal on the bus and still means 8 bytes. */
+    for (i = 0; (i < p_cap->dlc) && (i < 8); i++)
+    {
+        p_stat->data[i] = p_cap->data[i];
+    }
+}
+
+
+/*******************************************************************************
+* Function name: monitor_report
+* Description  : ID table to the debug port, totals to the LCD.
+* Argument     : nr_frames_s -
+*                    Frames in the last second.
+* Return value : none
+*******************************************************************************/
+static void monitor_report(uint32_t nr_frames_s)
+{
+    mon_id_stat_t * p_stat;
+    char            line[13];
+    uint8_t         idx;
+    uint8_t         i;
+
+    printf("\n%lu frames/s, %u IDs, lost fifo %lu ring %lu, table full %lu", nr_frames_s, 
+           mon_nr_ids, mon_nr_fifo_lost, mon_nr_ring_lost, mon_nr_table_full);
+    printf("\n      id     count  period_us jitter_us dlc chg data");
+    for (idx = 0; idx < MON_TABLE_SIZE; idx++)
+    {
+        p_stat = &mon_table[idx];
+        if (MON_KEY_EMPTY == p_stat->key)
+        {
+            continue;
+        }
+
+        printf((p_stat->key & MON_KEY_XID) ? "\n%8lX" : "\n     %03lX", p_stat->key & ~MON_KEY_XID);
+        printf(" %9lu", p_stat->count);
+        if (p_stat->count > 1)
+        {
+            printf(" %10lu %9lu", (uint32_t)(p_stat->period_sum_us / (p_stat->count - 1)),
+                   p_stat->period_max_us - p_stat->period_min_us);
+        }
+        else
+        {
+            printf(" %10s %9s", "-", "-");
+        }
+        printf(" %3u %3u", p_stat->dlc, p_stat->dlc_changes);
+        for (i = 0; (i < p_stat->dlc) && (i < 8); i++)
+        {
+            printf(" %02X", p_stat->data[i]);
+        }
+    }
+
+    sprintf(line, "%lu fr/s", nr_frames_s);
+    lcd_display(LCD_LINE2, line);
+    sprintf(line, "%u IDs", mon_nr_ids);
+    lcd_display(LCD_LINE3, line);
+    sprintf(line, "lost %lu", mon_nr_fifo_lost + mon_nr_ring_lost);
+    lcd_display(LCD_LINE4, line);
+} /* End of function monitor_report(). */
+
+#endif /* DEMO_BUS_MONITOR */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_autobaud.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Bit rate detection at startup, DEMO_AUTOBAUD. After 
+*                 R_CAN_Create the channel listens, in listen only mode so
+*                 it never drives the bus, with each candidate bit timing in
+*                 turn:
+*                     500, 250, 125, 1000 kbps, from can_timing_calc
+*                 A candidate is taken when AUTOBAUD_MIN_FRAMES frames arrive
+*                 and the error code register stays clear. At a wrong rate 
+*                 the first frame on the bus gives stuff, form or CRC errors,
+*                 so the next candidate is tried at once; a quiet bus gives 
+*                 nothing and the window of AUTOBAUD_WINDOW_MS runs out. The
+*                 candidates repeat until AUTOBAUD_MAX_MS, then the channel
+*                 stays at the configured rate.
+*                 Standard and extended frames both count: the channel runs
+*                 in mixed ID mode while detecting, with CANBOX_RX for the 
+*                 one and CANBOX_AUTOBAUD_XID for the other, and goes back
+*                 to its own ID mode after.
+*                 The channel is back in normal mode on return. The timing 
+*                 goes in with can_timing_apply, so can_timing_restore puts
+*                 it back after R_CAN_Create, on bus-off recovery and on the
+*                 later passes of the startup code, which detects once. Rate, 
+*                 detection time and candidates tried go to the debug port
+*                 and UDS DID F20C. The rate-dependent budgets (tx limits,
+*                 monitor timestamps, probes) follow can_timing_bitrate. 
+*                 The host tools' autobaud-sim command is a separate model 
+*                 of this loop, with the constants copied; it does not run
+*                 this code.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+#if DEMO_AUTOBAUD
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+/* Must match autobaud-sim in the host tools. */
+#define AUTOBAUD_WINDOW_MS      200     /* Per candidate, on a quiet bus. */
+#define AUTOBAUD_MAX_MS         2000
+#define AUTOBAUD_MIN_FRAMES     2
+#define AUTOBAUD_NR_CANDIDATES  (sizeof(autobaud_tbl) / sizeof(autobaud_tbl[0]))
+
+/* Stuff, form, ACK, CRC, bit 1, bit 0, ACK delimiter error. */
+#define ECSR_ERRORS             0x7F
+
+#define AB_REG(ch, reg)         (*((CH_0 == (ch)) ? &CAN0.reg : \
+                                   (CH_1 == (ch)) ? &CAN1.reg : &CAN2.reg))
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* kbps, most likely first. */
+static const uint16_t autobaud_tbl[] = {500, 250, 125, 1000};
+
+static uint16_t autobaud_kbps;
+static uint16_t autobaud_ms;
+static uint8_t  autobaud_nr_tried;
+
+/*******************************************************************************
+Local Function Prototypes
+*******************************************************************************/
+static bool autobaud_try(uint32_t ch_nr, const can_timing_t * p_timing, uint32_t window_us);
+
+
+static void autobaud_rx_int(uint32_t ch_nr, uint8_t enable)
+{
+    if (CH_0 == ch_nr)
+    {
+        IEN(CAN0, RXM0) = enable;
+    }
+    else if (CH_1 == ch_nr)
+    {
+        IEN(CAN1, RXM1) = enable;
+    }
+    else
+    {
+        IEN(CAN2, RXM2) = enable;
+    }
+}
+
+
+/*******************************************************************************
+* Function name: autobaud_detect
+* Description  : Find the bit rate of the bus, listening only. Call after 
+*                R_CAN_Create and before the mailboxes are set up; CANBOX_RX
+*                and CANBOX_AUTOBAUD_XID are used to receive, and are closed
+*                on return.
+* Argument     : ch_nr -
+*                    Channel, created.
+* Return value : Rate in kbps, 0 if none found and the configured rate is kept.
+*******************************************************************************/
+uint32_t autobaud_detect(uint32_t ch_nr)
+{
+    const uint32_t  start_us = sys_time_us();
+    uint32_t        elapsed_us = 0;
+    uint32_t        window_us;
+    can_timing_t    timing;
+    uint8_t         idx = 0;
+    uint8_t         idfm;
+
+    autobaud_kbps = 0;
+    autobaud_nr_tried = 0;
+
+    /* Receive in the loop below, not in the Rx ISR. */
+    autobaud_rx_int(ch_nr, 0);
+    R_CAN_PortSet(ch_nr, ENABLE);
+
+    /* Both ID formats while detecting. IDFM is written in reset mode only. */
+    R_CAN_Control(ch_nr, RESET_CANMODE);
+    idfm = (uint8_t)CAN_CTLR(ch_nr).BIT.IDFM;
+    CAN_CTLR(ch_nr).BIT.IDFM = CTLR_IDFM_MIXED;
+    R_CAN_Control(ch_nr, HALT_CANMODE);
+
+    while (elapsed_us < AUTOBAUD_MAX_MS * 1000UL)
+    {
+        window_us = AUTOBAUD_MAX_MS * 1000UL - elapsed_us;
+        if (window_us > AUTOBAUD_WINDOW_MS * 1000UL)
+        {
+            window_us = AUTOBAUD_WINDOW_MS * 1000UL;
+        }
+
+        autobaud_nr_tried++;
+        if ((R_CAN_OK == can_timing_calc(autobaud_tbl[idx] * 1000UL, CAN_SAMPLE_POINT, 
+                                         CAN_OSC_TOL_PPM, &timing)) &&
+            autobaud_try(ch_nr, &timing, window_us))
+        {
+            autobaud_kbps = autobaud_tbl[idx];
+            break;
+        }
+
+        idx = (uint8_t)((idx + 1) % AUTOBAUD_NR_CANDIDATES);
+        elapsed_us = sys_time_us() - start_us;
+    }
+
+    autobaud_ms = (uint16_t)((sys_time_us() - start_us) / 1000);
+
+    /* Close both mailboxes and put the ID mode back. The bit timing stays 
+    through reset mode. */
+    R_CAN_Control(ch_nr, HALT_CANMODE);
+    AB_REG(ch_nr, MCTL[CANBOX_RX].BYTE) = 0;
+    AB_REG(ch_nr, MCTL[CANBOX_AUTOBAUD_XID].BYTE) = 0;
+    R_CAN_Control(ch_nr, RESET_CANMODE);
+    CAN_CTLR(ch_nr).BIT.IDFM = idfm;
+    R_CAN_Control(ch_nr, HALT_CANMODE);
+
+    /* The found rate is applied already. Then join the bus. */
+    if (0 == autobaud_kbps)
+    {
+        can_timing_set(ch_nr, CAN_BITRATE);
+    }
+    R_CAN_PortSet(ch_nr, CANPORT_RETURN_TO_NORMAL);
+    autobaud_rx_int(ch_nr, 1);
+
+    if (autobaud_kbps)
+    {
+        printf("\nautobaud: %u kbps after %u ms, %u candidates", autobaud_kbps, 
+               autobaud_ms, autobaud_nr_tried);
+    }
+    else
+    {
+        printf("\nautobaud: no traffic in %u ms, configured rate", autobaud_ms);
+    }
+    return autobaud_kbps;
+} /* End of function autobaud_detect(). */
+
+
+/*******************************************************************************
+* Function name: autobaud_try
+* Description  : Listen with one bit timing.
+* Argument     : ch_nr -
+*                    Channel.
+*                p_timing -
+*                    Candidate bit timing.
+*                window_us -
+*                    Longest time to wait for frames.
+* Return value : true if AUTOBAUD_MIN_FRAMES frames came without an error.
+*******************************************************************************/
+static bool autobaud_try(uint32_t ch_nr, const can_timing_t * p_timing, uint32_t window_us)
+{
+    const uint32_t  start_us = sys_time_us();
+    can_frame_t     frame;
+    uint8_t         nr_frames = 0;
+
+    /* Returns in halt mode. */
+    can_timing_apply(ch_nr, p_timing);
+
+    /* Any data frame, standard in CANBOX_RX and extended in the other. They
+    share one mask register; no ID bits compared. */
+    CAN_MB_ID(ch_nr, CANBOX_RX)->BIT.IDE = 0;
+    R_CAN_RxSet(ch_nr, CANBOX_RX, 0, DATA_FRAME);
+    CAN_MB_ID(ch_nr, CANBOX_AUTOBAUD_XID)->BIT.IDE = 1;
+    R_CAN_RxSetXid(ch_nr, CANBOX_AUTOBAUD_XID, 0, DATA_FRAME);
+    AB_REG(ch_nr, MKR[CANBOX_RX / 4].LONG) = 0;
+    AB_REG(ch_nr, MKIVLR) &= ~((1UL << CANBOX_RX) | (1UL << CANBOX_AUTOBAUD_XID));
+
+    /* Ends in operate mode. */
+    R_CAN_PortSet(ch_nr, CANPORT_TEST_LISTEN_ONLY);
+    AB_REG(ch_nr, ECSR.BYTE) = 0;
+
+    while ((sys_time_us() - start_us) < window_us)
+    {
+        if (AB_REG(ch_nr, ECSR.BYTE) & ECSR_ERRORS)
+        {
+            return false;
+        }
+        if (R_CAN_OK == R_CAN_RxPoll(ch_nr, CANBOX_RX))
+        {
+            R_CAN_RxRead(ch_nr, CANBOX_RX, &frame);
+            nr_frames++;
+        }
+        if (R_CAN_OK == R_CAN_RxPoll(ch_nr, CANBOX_AUTOBAUD_XID))
+        {
+            R_CAN_RxRead(ch_nr, CANBOX_AUTOBAUD_XID, &frame);
+            nr_frames++;
+        }
+        if (nr_frames >= AUTOBAUD_MIN_FRAMES)
+        {
+            return true;
+        }
+    }
+    return false;
+} /* End of function autobaud_try(). */
+
+
+/*******************************************************************************
+* Function name: autobaud_get_status
+* Description  : UDS DID F20C: rate in kbps (0 = not detected), detection 
+*                time in ms, candidates tried.
+* Argument     : p_dest -
+*                    5 bytes.
+* Return value : none
+*******************************************************************************/
+void autobaud_get_status(uint8_t * p_dest)
+{
+    p_dest[0] = (uint8_t)(autobaud_kbps >> 8);
+    p_dest[1] = (uint8_t)autobaud_kbps;
+    p_dest[2] = (uint8_t)(autobaud_ms >> 8);
+    p_dest[3] = (uint8_t)autobaud_ms;
+    p_dest[4] = autobaud_nr_tried;
+} /* End of function autobaud_get_status(). */
+
+#endif /* DEMO_AUTOBAUD */
+
+
+/**************************************************************************************************************/
+
+
+/*******************************************************************************
+* File Name     : can_bit_timing.c
+* Version       : 1.0
+* H/W Platform  : YRDKRX63N
+* Description   : Bit timing from PCLK for any bit rate up to 1 Mbps, in 
+*                 place of the 500 kbps of the driver config. 
+*                 can_timing_calc searches 25 down to 8 Tq per bit for an 
+*                 exact prescaler, and takes the split closest to the 
+*                 requested sample point within the RX63N limits:
+*                     TSEG1 4..16, TSEG2 2..8, SJW 1..4, TSEG1 > TSEG2 >= SJW
+*                 On a tie the one with more Tq wins, for finer resync. 
+*                 TSEG1 holds the propagation segment, CAN_PROP_DELAY_NS 
+*                 rounded up to Tq, and phase buffer 1. A candidate is only 
+*                 taken if it allows the clock tolerance asked for, ISO
+*                 11898-1:
+*                     df <= SJW / (20 x NBT)
+*                     df <= min(PS1, PS2) / (2 x (13 x NBT - PS2))
+*                 At 48 MHz, 1 Mbps and 87.5% this is BRP 3, 16 Tq, TSEG1 13,
+*                 TSEG2 2, SJW 2, 4854 ppm with the default propagation.
+*                 The bit timing register can only be written in CAN reset
+*                 mode, so can_timing_apply goes through reset into halt 
+*                 mode; mailboxes are set up after it. The last timing of 
+*                 each channel is kept for can_timing_restore after 
+*                 R_CAN_Create, which writes the driver config again.
+*******************************************************************************/
+/*******************************************************************************
+* History : DD.MM.YYYY     Version     Description
+*         : 19.10.2026     1.00        First release
+*******************************************************************************/
+
+/*******************************************************************************
+Includes   <System Includes> , "Project Includes"
+*******************************************************************************/
+#include <stdio.h>
+#include "platform.h"
+#include "config_r_can_rapi.h"
+#include "can_api_demo.h"
+
+/*******************************************************************************
+Macro definitions
+*******************************************************************************/
+#define TIMING_TQ_MIN           8
+#define TIMING_TQ_MAX           25
+#define TIMING_TSEG1_MIN        4
+#define TIMING_TSEG1_MAX        16
+#define TIMING_TSEG2_MIN        2
+#define TIMING_TSEG2_MAX        8
+#define TIMING_SJW_MAX          4
+#define TIMING_BRP_MAX          1024
+
+/* CAN_PROP_DELAY_NS in PCLK cycles, rounded up; Tq are whole multiples. */
+#define TIMING_PROP_CYCLES      ((CAN_PROP_DELAY_NS * (PCLK_HZ / 1000000UL) + 999) / 1000)
+
+/* CCLKS = 0: fCAN from PCLK. */
+#define TIMING_BCR(p)           ((uint32_t)((p)->tseg1 - 1) << 28 | \
+                                 (uint32_t)((p)->brp - 1) << 16 | \
+                                 (uint32_t)((p)->sjw - 1) << 12 | \
+                                 (uint32_t)((p)->tseg2 - 1) << 8)
+
+#define TIMING_BCR_REG(ch)      (*((CH_0 == (ch)) ? &CAN0.BCR.LONG : \
+                                   (CH_1 == (ch)) ? &CAN1.BCR.LONG : &CAN2.BCR.LONG))
+
+/*******************************************************************************
+Local global variables
+*******************************************************************************/
+/* Last timing applied per channel, brp 0 = driver config. */
+static can_timing_t timing_cur[MAX_CHANNELS];
+
+
+/*******************************************************************************
+* Function name: can_timing_calc
+* Description  : Bit timing for a bit rate and sample point from PCLK.
+* Arguments    : bitrate -
+*                    bps, up to 1000000.
+*                sample_point -
+*                    Per mille, 500..950.
+*                osc_tol_ppm -
+*                    Clock tolerance of each node the timing must allow.
+*                p_timing -
+*                    Gets the timing.
+* Return value : R_CAN_OK, or R_CAN_NOT_OK if no timing fits.
+*******************************************************************************/
+uint32_t can_timing_calc(uint32_t bitrate, uint16_t sample_point, uint16_t osc_tol_ppm,
+                         can_timing_t * p_timing)
+{
+    can_timing_t    t;
+    uint32_t        brp;
+    uint32_t        prop;
+    uint32_t        ps1;
+    uint32_t        tol1;
+    uint32_t        tol2;
+    uint16_t        err;
+    uint16_t        best_err = 0xFFFF;
+    uint8_t         tq;
+
+    if ((0 == bitrate) || (bitrate > 1000000UL) || (sample_point < 500) || (sample_point > 950))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    for (tq = TIMING_TQ_MAX; tq >= TIMING_TQ_MIN; tq--)
+    {
+        if (0 != (PCLK_HZ % (bitrate * tq)))
+        {
+            continue;
+        }
+        brp = PCLK_HZ / (bitrate * tq);
+        if (brp > TIMING_BRP_MAX)
+        {
+            continue;
+        }
+
+        /* Sample point closest to the one asked for, within the limits. */
+        t.tseg2 = (uint8_t)((tq * (1000U - sample_point) + 500U) / 1000U);
+        if (t.tseg2 < TIMING_TSEG2_MIN)
+        {
+            t.tseg2 = TIMING_TSEG2_MIN;
+        }
+        if ((tq - 1 - t.tseg2) > TIMING_TSEG1_MAX)
+        {
+            t.tseg2 = (uint8_t)(tq - 1 - TIMING_TSEG1_MAX);
+        }
+        t.tseg1 = (uint8_t)(tq - 1 - t.tseg2);
+        if ((t.tseg2 > TIMING_TSEG2_MAX) || (t.tseg1 < TIMING_TSEG1_MIN) || (t.tseg1 <= t.tseg2))
+        {
+            continue;
+        }
+        t.sjw = (t.tseg2 < TIMING_SJW_MAX) ? t.tseg2 : TIMING_SJW_MAX;
+
+        /* Phase buffer 1 is what the propagation segment leaves of TSEG1.
+        A Tq is brp PCLK cycles. */
+        prop = (TIMING_PROP_CYCLES + brp - 1) / brp;
+        if (prop >= t.tseg1)
+        {
+            continue;
+        }
+        ps1 = t.tseg1 - prop;
+
+        tol1 = 1000000UL * t.sjw / (20U * tq);
+        tol2 = 1000000UL * ((ps1 < t.tseg2) ? ps1 : t.tseg2) / (2U * (13U * tq - t.tseg2));
+        t.osc_tol_ppm = (uint16_t)((tol1 < tol2) ? tol1 : tol2);
+        if (t.osc_tol_ppm < osc_tol_ppm)
+        {
+            continue;
+        }
+
+        t.sample_point = (uint16_t)(1000U * (1 + t.tseg1) / tq);
+        err = (t.sample_point > sample_point) ? (t.sample_point - sample_point) :
+                                                (sample_point - t.sample_point);
+        if (err < best_err)
+        {
+            best_err = err;
+            t.bitrate = bitrate;
+            t.brp = (uint16_t)brp;
+            t.tq_per_bit = tq;
+            *p_timing = t;
+        }
+    }
+
+    return (0xFFFF == best_err) ? R_CAN_NOT_OK : R_CAN_OK;
+} /* End of function can_timing_calc(). */
+
+
+/*******************************************************************************
+* Function name: can_timing_apply
+* Description  : Write a bit timing. Through CAN reset mode, which the bit 
+*                timing register needs, into halt mode.
+* Arguments    : ch_nr -
+*                    Channel.
+*                p_timing -
+*                    From can_timing_calc.
+* Return value : CAN API code. The channel is left in halt mode.
+*******************************************************************************/
+uint32_t can_timing_apply(uint32_t ch_nr, const can_timing_t * p_timing)
+{
+    uint32_t    api_status;
+
+    if (ch_nr >= MAX_CHANNELS)
+    {
+        return R_CAN_BAD_CH_NR;
+    }
+
+    api_status = R_CAN_Control(ch_nr, RESET_CANMODE);
+    TIMING_BCR_REG(ch_nr) = TIMING_BCR(p_timing);
+    api_status |= R_CAN_Control(ch_nr, HALT_CANMODE);
+
+    if (&timing_cur[ch_nr] != p_timing)
+    {
+        timing_cur[ch_nr] = *p_timing;
+    }
+    return api_status;
+} /* End of function can_timing_apply(). */
+
+
+/*******************************************************************************
+* Function name: can_timing_set
+* Description  : Run a channel at a bit rate, with CAN_SAMPLE_POINT and 
+*                CAN_OSC_TOL_PPM. Call after R_CAN_Create, before the 
+*                mailboxes are set up.
+* Arguments    : ch_nr -
+*                    Channel.
+*                bitrate -
+*                    bps.
+* Return value : CAN API code; R_CAN_NOT_OK and the timing unchanged if 
+*                there is no timing for the rate.
+*******************************************************************************/
+uint32_t can_timing_set(uint32_t ch_nr, uint32_t bitrate)
+{
+    can_timing_t    timing;
+    uint32_t        api_status;
+    bool            changed;
+
+    if ((ch_nr >= MAX_CHANNELS) ||
+        (R_CAN_OK != can_timing_calc(bitrate, CAN_SAMPLE_POINT, CAN_OSC_TOL_PPM, &timing)))
+    {
+        return R_CAN_NOT_OK;
+    }
+
+    /* Startup runs on every demo pass; report a new timing only. */
+    changed = ((timing.bitrate != timing_cur[ch_nr].bitrate) || (timing.brp != timing_cur[ch_nr].brp) ||
+               (timing.tseg1 != timing_cur[ch_nr].tseg1) || (timing.tseg2 != timing_cur[ch_nr].tseg2) ||
+               (timing.sjw != timing_cur[ch_nr].sjw));
+
+    api_status = can_timing_apply(ch_nr, &timing);
+    api_status |= R_CAN_Control(ch_nr, OPERATE_CANMODE);
+
+    if (changed)
+    {
+        printf("\nCH%lu %lu bps: BRP %u, %u Tq, TSEG1 %u TSEG2 %u SJW %u, sample %u.%u%%, %u ppm", 
+               ch_nr, bitrate, timing.brp, timing.tq_per_bit, timing.tseg1, timing.tseg2, timing.sjw,
+               timing.sample_point / 10, timing.sample_point % 10, timing.osc_tol_ppm);
+    }
+    return api_status;
+} /* End of function can_timing_set(). */
+
+
+/*******************************************************************************
+* Function name: can_timing_restore
+* Description  : Put the last timing back after R_CAN_Create. Nothing to do 
+*                if the channel runs on the driver config.
+* Argument     : ch_nr -
+*                    Channel.
+* Return value : CAN API code.
+*******************************************************************************/
+uint32_t can_timing_restore(uint32_t ch_nr)
+{
+    uint32_t    api_status;
+
+    if ((ch_nr >= MAX_CHANNELS) || (0 == timing_cur[ch_nr].brp))
+    {
+        return R_CAN_OK;
+    }
+
+    api_status = can_timing_apply(ch_nr, &timing_cur[ch_nr]);
+    api_status |= R_CAN_Control(ch_nr, OPERATE_CANMODE);
+    return api_status;
+} /* End of function can_timing_restore(). */
+
+
+/*******************************************************************************
+* Function name: can_timing_bitrate
+* Description  : Bit rate a channel runs at: the last timing applied, set or
+*                detected, else the configured CAN_BITRATE. For budgets and
+*                timestamp scaling that depend on the rate.
+* Argument     : ch_nr -
+*                    Channel.
+* Return value : bps.
+*******************************************************************************/
+uint32_t can_timing_bitrate(uint32_t ch_nr)
+{
+    if ((ch_nr >= MAX_CHANNELS) || (0 == timing_cur[ch_nr].brp))
+    {
+        return CAN_BITRATE;
+    }
+    return timing_cur[ch_nr].bitrate;
+} /* End of function can_timing_bitrate(). */
+
+
+/*******************************************************************************
+* Function name: can_timing_get_status
+* Description  : UDS DID F20D, timing of the demo channel: bit rate (4), 
+*                BRP (2), Tq per bit, TSEG1, TSEG2, SJW, sample point per 
+*                mille (2), clock tolerance ppm (2). Zero on the driver 
+*                config.
+* Argument     : p_dest -
+*                    14 bytes.
+* Return value : none
+*******************************************************************************/
+void can_timing_get_status(uint8_t * p_dest)
+{
+    const can_timing_t * p_t = &timing_cur[g_can_channel];
+
+    p_dest[0] = (uint8_t)(p_t->bitrate >> 24);
+    p_dest[1] = (uint8_t)(p_t->bitrate >> 16);
+    p_dest[2] = (uint8_t)(p_t->bitrate >> 8);
+    p_dest[3] = (uint8_t)p_t->bitrate;
+    p_dest[4] = (uint8_t)(p_t->brp >> 8);
+    p_dest[5] = (uint8_t)p_t->brp;
+    p_dest[6] = p_t->tq_per_bit;
+    p_dest[7] = p_t->tseg1;
+    p_dest[8] = p_t->tseg2;
+    p_dest[9] = p_t->sjw;
+    p_dest[10] = (uint8_t)(p_t->sample_point >> 8);
+    p_dest[11] = (uint8_t)p_t->sample_point;
+    p_dest[12] = (uint8_t)(p_t->osc_tol_ppm >> 8);
+    p_dest[13] = (uint8_t)p_t->osc_tol_ppm;
+} /* End of function can_timing_get_status(). */